@@ -0,0 +1,752 @@
+#include "engine.h"
+#include "mesh.h"
+#include "sprites.h"
+#include "lighting.h"
+
+// Synthetic workloads for the engine. Runs headless (offscreen images, works on lavapipe) unless --swapchain is
+// given, and writes the results as JSON. Two result files can be compared to flag regressions:
+//
+//     build/bench --out base.json
+//     build/bench --out new.json
+//     build/bench --compare base.json new.json --threshold 5
+//
+// With --mesh file.mesh (cooked by meshcook) the mesh is drawn too, and its load time shows up in the startup.
+
+#define BENCH_MAX_WORKLOADS 16
+#define BENCH_MAX_METRICS 256
+#define BENCH_WARMUP_FRAMES 16
+#define BENCH_METRICS_BATCH 1000
+
+typedef enum WorkloadKind
+{
+    WORKLOAD_FRAMES,    // draw frames with the given DrawParams and time them
+    WORKLOAD_PIPELINES, // create N pipelines and time them
+    WORKLOAD_SPRITES,   // draw frames of N sprites, time the batching too
+    WORKLOAD_METRICS,   // record N samples into a metrics histogram, the cost of the frame loop instrumentation
+} WorkloadKind;
+
+// which vertex shader the frame workloads draw with
+typedef enum BenchScene
+{
+    SCENE_GRID,     // tiny triangles in a grid, no overlap (bench.vert)
+    SCENE_OVERDRAW, // full screen triangles stacked back to front (overdraw.vert)
+    SCENE_MESH,     // the engine's own pipelines, drawing the --mesh file
+    SCENE_COUNT,
+} BenchScene;
+
+typedef struct BenchPipelines BenchPipelines;
+struct BenchPipelines {
+    VkShaderModule vert_module;
+    VkPipeline pipeline;
+    VkPipeline depth_prepass_pipeline;
+    VkPipeline equal_pipeline;
+};
+
+typedef struct Workload Workload;
+struct Workload {
+    const char* name;
+    WorkloadKind kind;
+    u32 n;
+    DrawParams draw; // only for WORKLOAD_FRAMES
+    BenchScene scene;
+    bool depth_prepass;
+};
+
+typedef struct WorkloadResult WorkloadResult;
+struct WorkloadResult {
+    const char* name;
+    u32 n;
+    u32 samples;
+    f64 per_s; // frames/s, or pipelines/s
+    f64 cpu_ms;
+    f64 record_ms; // the part of cpu_ms spent recording commands
+    f64 p50_ms;
+    f64 p99_ms;
+    f64 quads_per_ms; // only for WORKLOAD_SPRITES: draw_sprite and end_sprites, on the CPU
+};
+
+typedef struct BenchMetric BenchMetric;
+struct BenchMetric {
+    char key[128];
+    f64 value;
+};
+
+typedef struct BenchMetrics BenchMetrics;
+struct BenchMetrics {
+    BenchMetric items[BENCH_MAX_METRICS];
+    u32 count;
+};
+
+void summarize(WorkloadResult* result, f64* samples_ms, f64 cpu_ms_total, f64 total_ms)
+{
+    qsort(samples_ms, result->samples, sizeof(f64), compare_f64);
+    result->p50_ms = percentile(samples_ms, result->samples, 50.0);
+    result->p99_ms = percentile(samples_ms, result->samples, 99.0);
+    result->cpu_ms = cpu_ms_total / (f64)result->samples;
+    result->per_s = (f64)result->samples / (total_ms / 1000.0);
+}
+
+void load_bench_pipelines(App* pApp, const char* vert_filename, VkShaderModule frag_module, BenchPipelines* pipelines)
+{
+    Shader vert_shader_binary = read_file(vert_filename);
+    pipelines->vert_module = create_shader_module(pApp, vert_shader_binary.binary, vert_shader_binary.size);
+    free(vert_shader_binary.binary);
+
+    pipelines->pipeline =
+        create_pipeline(pApp, pipelines->vert_module, frag_module, NULL, DEPTH_MODE_TEST_WRITE, NULL);
+    pipelines->depth_prepass_pipeline =
+        create_pipeline(pApp, pipelines->vert_module, frag_module, NULL, DEPTH_MODE_PREPASS, NULL);
+    pipelines->equal_pipeline =
+        create_pipeline(pApp, pipelines->vert_module, frag_module, NULL, DEPTH_MODE_EQUAL, NULL);
+}
+
+void destroy_bench_pipelines(App* pApp, BenchPipelines* pipelines)
+{
+    vkDestroyPipeline(pApp->vk_device, pipelines->pipeline, NULL);
+    vkDestroyPipeline(pApp->vk_device, pipelines->depth_prepass_pipeline, NULL);
+    vkDestroyPipeline(pApp->vk_device, pipelines->equal_pipeline, NULL);
+    vkDestroyShaderModule(pApp->vk_device, pipelines->vert_module, NULL);
+}
+
+void use_bench_pipelines(App* pApp, const BenchPipelines* pipelines)
+{
+    pApp->vk_pipeline = pipelines->pipeline;
+    pApp->vk_depth_prepass_pipeline = pipelines->depth_prepass_pipeline;
+    pApp->vk_equal_pipeline = pipelines->equal_pipeline;
+}
+
+WorkloadResult run_frames(App* pApp, const Workload* workload, const BenchPipelines* scenes, u32 frames)
+{
+    WorkloadResult result = {.name = workload->name, .n = workload->n, .samples = frames};
+    pApp->draw = workload->draw;
+    pApp->depth_prepass = workload->depth_prepass;
+    use_bench_pipelines(pApp, &scenes[workload->scene]);
+
+    for (u32 i = 0; i < BENCH_WARMUP_FRAMES; i += 1) {
+        if (!pApp->headless) {
+            glfwPollEvents();
+        }
+        draw_frame(pApp);
+    }
+
+    // the time between two draw_frame returns is the frame time. Whatever part of it was spent blocked on the
+    // fence or the acquire is the GPU (or the display), the rest is the CPU
+    f64* samples_ms = (f64*)malloc(frames * sizeof(f64));
+    f64 cpu_ms_total = 0.0;
+    f64 record_ms_total = 0.0;
+    f64 start_ms = now_ms();
+    f64 last_ms = start_ms;
+    for (u32 i = 0; i < frames; i += 1) {
+        if (!pApp->headless) {
+            glfwPollEvents();
+        }
+        draw_frame(pApp);
+        f64 t = now_ms();
+        samples_ms[i] = t - last_ms;
+        cpu_ms_total += samples_ms[i] - pApp->frame_wait_ms;
+        record_ms_total += pApp->frame_record_ms;
+        last_ms = t;
+    }
+    vkDeviceWaitIdle(pApp->vk_device);
+    f64 total_ms = now_ms() - start_ms;
+
+    summarize(&result, samples_ms, cpu_ms_total, total_ms);
+    result.record_ms = record_ms_total / (f64)frames;
+    free(samples_ms);
+    return result;
+}
+
+// xorshift32, the same sprites on every run
+u32 next_random(u32* state)
+{
+    u32 x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+// One frame of N sprites over the empty scene, with random textures, blend modes and layers, so the sort has work.
+// They move a little every frame, the quads are written again anyway
+void build_sprite_frame(App* pApp, const Sprite* sprites, u32 count, u32 frame)
+{
+    begin_sprites(pApp);
+    f32 offset = (f32)(frame % 64);
+    for (u32 i = 0; i < count; i += 1) {
+        Sprite sprite = sprites[i];
+        sprite.x += offset;
+        sprite.y += offset;
+        draw_sprite(pApp, &sprite);
+    }
+    end_sprites(pApp);
+}
+
+WorkloadResult run_sprites(App* pApp, const Workload* workload, const BenchPipelines* scenes, u32 frames)
+{
+    WorkloadResult result = {.name = workload->name, .n = workload->n, .samples = frames};
+    pApp->draw = workload->draw;
+    pApp->depth_prepass = false;
+    use_bench_pipelines(pApp, &scenes[SCENE_GRID]);
+
+    u32 state = 0x5eed5eed;
+    Sprite* sprites = (Sprite*)malloc(workload->n * sizeof(Sprite));
+    for (u32 i = 0; i < workload->n; i += 1) {
+        sprites[i] = (Sprite){
+            .x = (f32)(next_random(&state) % pApp->vk_extent.width),
+            .y = (f32)(next_random(&state) % pApp->vk_extent.height),
+            .width = 4.0f + (f32)(next_random(&state) % 12),
+            .height = 4.0f + (f32)(next_random(&state) % 12),
+            .uv = {0.0f, 0.0f, 1.0f, 1.0f},
+            .color = next_random(&state) | 0x80000000u,
+            .texture = next_random(&state) % SPRITE_TEXTURE_LAYERS,
+            .layer = (u8)(next_random(&state) % 4),
+            .blend = (SpriteBlend)(next_random(&state) % SPRITE_BLEND_COUNT),
+        };
+    }
+
+    for (u32 i = 0; i < BENCH_WARMUP_FRAMES; i += 1) {
+        if (!pApp->headless) {
+            glfwPollEvents();
+        }
+        build_sprite_frame(pApp, sprites, workload->n, i);
+        draw_frame(pApp);
+    }
+
+    f64* samples_ms = (f64*)malloc(frames * sizeof(f64));
+    f64 cpu_ms_total = 0.0;
+    f64 record_ms_total = 0.0;
+    f64 sprite_ms_total = 0.0;
+    f64 start_ms = now_ms();
+    f64 last_ms = start_ms;
+    for (u32 i = 0; i < frames; i += 1) {
+        if (!pApp->headless) {
+            glfwPollEvents();
+        }
+        // the draw_sprite calls and end_sprites, without its wait for the frame slot
+        f64 build_start_ms = now_ms();
+        build_sprite_frame(pApp, sprites, workload->n, i);
+        sprite_ms_total += now_ms() - build_start_ms - pApp->sprites->wait_ms;
+        draw_frame(pApp);
+        f64 t = now_ms();
+        samples_ms[i] = t - last_ms;
+        cpu_ms_total += samples_ms[i] - pApp->frame_wait_ms;
+        record_ms_total += pApp->frame_record_ms;
+        last_ms = t;
+    }
+    vkDeviceWaitIdle(pApp->vk_device);
+    f64 total_ms = now_ms() - start_ms;
+
+    summarize(&result, samples_ms, cpu_ms_total, total_ms);
+    result.record_ms = record_ms_total / (f64)frames;
+    result.quads_per_ms = (f64)workload->n * (f64)frames / sprite_ms_total;
+    free(samples_ms);
+    free(sprites);
+    return result;
+}
+
+WorkloadResult run_pipelines(App* pApp, const Workload* workload, VkShaderModule vert_module,
+                             VkShaderModule frag_module)
+{
+    WorkloadResult result = {.name = workload->name, .n = workload->n, .samples = workload->n};
+
+    f64* samples_ms = (f64*)malloc(workload->n * sizeof(f64));
+    VkPipeline* pipelines = (VkPipeline*)malloc(workload->n * sizeof(VkPipeline));
+    f64 start_ms = now_ms();
+    for (u32 i = 0; i < workload->n; i += 1) {
+        f64 t = now_ms();
+        pipelines[i] = create_pipeline(pApp, vert_module, frag_module, NULL, DEPTH_MODE_TEST_WRITE, NULL);
+        samples_ms[i] = now_ms() - t;
+    }
+    f64 total_ms = now_ms() - start_ms;
+
+    for (u32 i = 0; i < workload->n; i += 1) {
+        vkDestroyPipeline(pApp->vk_device, pipelines[i], NULL);
+    }
+    free(pipelines);
+
+    // creating a pipeline is all CPU
+    summarize(&result, samples_ms, total_ms, total_ms);
+    free(samples_ms);
+    return result;
+}
+
+// Batches of BENCH_METRICS_BATCH samples, so the clock reads do not dominate. Frame time like values, 1 to 33 ms
+WorkloadResult run_metrics(const Workload* workload)
+{
+    u32 batches = (workload->n + BENCH_METRICS_BATCH - 1) / BENCH_METRICS_BATCH;
+    WorkloadResult result = {.name = workload->name, .n = batches * BENCH_METRICS_BATCH, .samples = batches};
+    Metrics metrics = {0};
+    metrics.histograms = (MetricsHistogram*)calloc(METRIC_COUNT, sizeof(MetricsHistogram));
+
+    u32 state = 0x5eed5eed;
+    u64* values = (u64*)malloc(BENCH_METRICS_BATCH * sizeof(u64));
+    for (u32 i = 0; i < BENCH_METRICS_BATCH; i += 1) {
+        values[i] = 1000000 + next_random(&state) % 32000000;
+    }
+
+    f64* samples_ms = (f64*)malloc(batches * sizeof(f64));
+    f64 start_ms = now_ms();
+    for (u32 b = 0; b < batches; b += 1) {
+        f64 t = now_ms();
+        for (u32 i = 0; i < BENCH_METRICS_BATCH; i += 1) {
+            record_metric(&metrics, METRIC_FRAME_TIME, values[i]);
+        }
+        samples_ms[b] = now_ms() - t;
+    }
+    f64 total_ms = now_ms() - start_ms;
+
+    // all CPU. The rate is per sample, not per batch
+    summarize(&result, samples_ms, total_ms, total_ms);
+    result.per_s = (f64)result.n / (total_ms / 1000.0);
+    free(samples_ms);
+    free(values);
+    free(metrics.histograms);
+    return result;
+}
+
+void write_results(const char* filename, App* pApp, const WorkloadResult* results, u32 result_count)
+{
+    FILE* file = fopen(filename, "w");
+    if (file == NULL) {
+        printf("Could not open %s to write the results!\n", filename);
+        exit(1);
+    }
+
+    VkPhysicalDeviceProperties device_properties;
+    vkGetPhysicalDeviceProperties(pApp->vk_physical_device, &device_properties);
+
+    f64 startup_total_ms = 0.0;
+    fprintf(file, "{\n");
+    fprintf(file, "  \"device\": \"%s\",\n", device_properties.deviceName);
+    fprintf(file, "  \"mode\": \"%s\",\n", pApp->headless ? "offscreen" : "swapchain");
+    fprintf(file, "  \"sync\": \"%s\",\n", pApp->timeline_semaphores ? "timeline" : "fences");
+    fprintf(file, "  \"command_cache\": \"%s\",\n", pApp->disable_command_cache ? "off" : "on");
+    fprintf(file, "  \"msaa_samples\": %u,\n", pApp->vk_msaa_samples);
+    fprintf(file, "  \"post\": \"%s\",\n",
+            pApp->post == NULL ? "off" : (pApp->post_storage_output ? "storage" : "blit"));
+    fprintf(file, "  \"lights\": %u,\n", pApp->lighting->count);
+    fprintf(file, "  \"depth_format\": %u,\n", pApp->vk_depth_format);
+    fprintf(file, "  \"startup_ms\": {\n");
+    for (u32 i = 0; i < INIT_STAGE_COUNT; i += 1) {
+        fprintf(file, "    \"%s\": %.4f,\n", init_stage_names[i], pApp->init_stage_ms[i]);
+        startup_total_ms += pApp->init_stage_ms[i];
+    }
+    // the worker threads of the startup, and how the whole of it compares to its longest dependency chain
+    for (u32 i = 0; i < INIT_TASK_COUNT; i += 1) {
+        const InitTask* task = &pApp->init_tasks[i];
+        fprintf(file, "    \"task_%s\": %.4f,\n", init_task_names[i], task->end_ms - task->start_ms);
+    }
+    fprintf(file, "    \"init\": %.4f,\n", pApp->init_ms);
+    fprintf(file, "    \"critical_path\": %.4f,\n", pApp->init_critical_path_ms);
+    fprintf(file, "    \"first_frame\": %.4f,\n", pApp->first_frame_ms);
+    fprintf(file, "    \"total\": %.4f\n", startup_total_ms);
+    fprintf(file, "  },\n");
+
+    // where the memory stood after the last workload. Not compared, it is not a speed
+    const MemoryStats* memory = &pApp->memory.stats;
+    fprintf(file, "  \"memory\": {\n");
+    fprintf(file, "    \"budget_supported\": %u,\n", memory->budget_supported ? 1 : 0);
+    for (u32 i = 0; i < memory->heap_count; i += 1) {
+        const MemoryHeapStats* heap = &memory->heaps[i];
+        fprintf(file, "    \"heap%u\": {\n", i);
+        fprintf(file, "      \"size_mb\": %.2f,\n", (f64)heap->size / (1024.0 * 1024.0));
+        fprintf(file, "      \"budget_mb\": %.2f,\n", (f64)heap->budget / (1024.0 * 1024.0));
+        fprintf(file, "      \"usage_mb\": %.2f,\n", (f64)heap->usage / (1024.0 * 1024.0));
+        for (u32 c = 0; c < MEMORY_CATEGORY_COUNT; c += 1) {
+            fprintf(file, "      \"%s_mb\": %.2f%s\n", memory_category_names[c],
+                    (f64)heap->engine_usage[c] / (1024.0 * 1024.0), c + 1 < MEMORY_CATEGORY_COUNT ? "," : "");
+        }
+        fprintf(file, "    }%s\n", i + 1 < memory->heap_count ? "," : "");
+    }
+    fprintf(file, "  },\n");
+    fprintf(file, "  \"workloads\": {\n");
+    for (u32 i = 0; i < result_count; i += 1) {
+        const WorkloadResult* r = &results[i];
+        const char* rate_name = "fps";
+        if (strcmp(r->name, "pipelines") == 0) {
+            rate_name = "pipelines_per_s";
+        } else if (strcmp(r->name, "metrics") == 0) {
+            rate_name = "samples_per_s";
+        }
+        fprintf(file, "    \"%s\": {\n", r->name);
+        fprintf(file, "      \"n\": %u,\n", r->n);
+        fprintf(file, "      \"samples\": %u,\n", r->samples);
+        fprintf(file, "      \"%s\": %.4f,\n", rate_name, r->per_s);
+        fprintf(file, "      \"cpu_ms\": %.4f,\n", r->cpu_ms);
+        fprintf(file, "      \"record_ms\": %.4f,\n", r->record_ms);
+        fprintf(file, "      \"p50_ms\": %.4f,\n", r->p50_ms);
+        if (r->quads_per_ms > 0.0) {
+            fprintf(file, "      \"quads_per_ms\": %.4f,\n", r->quads_per_ms);
+        }
+        fprintf(file, "      \"p99_ms\": %.4f\n", r->p99_ms);
+        fprintf(file, "    }%s\n", i + 1 < result_count ? "," : "");
+    }
+    fprintf(file, "  }\n");
+    fprintf(file, "}\n");
+    fclose(file);
+}
+
+// A tiny JSON reader, only enough to flatten our own result files into "a.b.c" -> number
+void skip_whitespace(const char** p)
+{
+    while (**p == ' ' || **p == '\n' || **p == '\r' || **p == '\t') {
+        *p += 1;
+    }
+}
+
+void parse_string(const char** p, char* out, u32 out_size)
+{
+    u32 length = 0;
+    *p += 1; // opening quote
+    while (**p != '\0' && **p != '"') {
+        if (**p == '\\' && (*p)[1] != '\0') {
+            *p += 1;
+        }
+        if (out != NULL && length + 1 < out_size) {
+            out[length++] = **p;
+        }
+        *p += 1;
+    }
+    if (**p == '"') {
+        *p += 1;
+    }
+    if (out != NULL) {
+        out[length] = '\0';
+    }
+}
+
+void parse_value(const char** p, const char* path, BenchMetrics* metrics)
+{
+    skip_whitespace(p);
+    if (**p == '{') {
+        *p += 1;
+        for (;;) {
+            skip_whitespace(p);
+            if (**p != '"') {
+                break;
+            }
+            char key[64];
+            parse_string(p, key, sizeof(key));
+            skip_whitespace(p);
+            if (**p == ':') {
+                *p += 1;
+            }
+            char child[128];
+            snprintf(child, sizeof(child), "%s%s%s", path, path[0] ? "." : "", key);
+            parse_value(p, child, metrics);
+            skip_whitespace(p);
+            if (**p == ',') {
+                *p += 1;
+            }
+        }
+        if (**p == '}') {
+            *p += 1;
+        }
+    } else if (**p == '[') {
+        *p += 1;
+        for (u32 index = 0;; index += 1) {
+            skip_whitespace(p);
+            if (**p == ']' || **p == '\0') {
+                break;
+            }
+            char child[128];
+            snprintf(child, sizeof(child), "%s.%u", path, index);
+            parse_value(p, child, metrics);
+            skip_whitespace(p);
+            if (**p == ',') {
+                *p += 1;
+            }
+        }
+        if (**p == ']') {
+            *p += 1;
+        }
+    } else if (**p == '"') {
+        parse_string(p, NULL, 0);
+    } else {
+        char* end;
+        f64 value = strtod(*p, &end);
+        if (end == *p) {
+            // true, false, null
+            while (**p >= 'a' && **p <= 'z') {
+                *p += 1;
+            }
+            return;
+        }
+        *p = end;
+        if (metrics->count < BENCH_MAX_METRICS) {
+            BenchMetric* metric = &metrics->items[metrics->count++];
+            snprintf(metric->key, sizeof(metric->key), "%s", path);
+            metric->value = value;
+        }
+    }
+}
+
+void load_metrics(const char* filename, BenchMetrics* metrics)
+{
+    Shader file = read_file(filename); // just the bytes, not a shader
+    char* text = (char*)malloc(file.size + 1);
+    memcpy(text, file.binary, file.size);
+    text[file.size] = '\0';
+    free(file.binary);
+
+    const char* p = text;
+    metrics->count = 0;
+    parse_value(&p, "", metrics);
+    free(text);
+}
+
+bool ends_with(const char* s, const char* suffix)
+{
+    size_t s_length = strlen(s);
+    size_t suffix_length = strlen(suffix);
+    return s_length >= suffix_length && strcmp(s + s_length - suffix_length, suffix) == 0;
+}
+
+// 1 if bigger is better, -1 if smaller is better, 0 if it is not a performance metric
+i32 metric_direction(const char* key)
+{
+    if (ends_with(key, ".fps") || ends_with(key, "_per_s") || ends_with(key, "_per_ms")) {
+        return 1;
+    }
+    if (ends_with(key, "_ms") || strncmp(key, "startup_ms.", strlen("startup_ms.")) == 0) {
+        return -1;
+    }
+    return 0;
+}
+
+int compare_results(const char* base_filename, const char* new_filename, f64 threshold_pct)
+{
+    static BenchMetrics base;
+    static BenchMetrics current;
+    load_metrics(base_filename, &base);
+    load_metrics(new_filename, &current);
+
+    u32 regressions = 0;
+    printf("%-48s %14s %14s %9s\n", "metric", "base", "new", "change");
+    for (u32 i = 0; i < current.count; i += 1) {
+        const BenchMetric* metric = &current.items[i];
+        i32 direction = metric_direction(metric->key);
+        if (direction == 0) {
+            continue;
+        }
+        for (u32 j = 0; j < base.count; j += 1) {
+            if (strcmp(base.items[j].key, metric->key) != 0) {
+                continue;
+            }
+            f64 base_value = base.items[j].value;
+            f64 change_pct = base_value != 0.0 ? (metric->value - base_value) / base_value * 100.0 : 0.0;
+            bool regressed = (f64)direction * change_pct < -threshold_pct;
+            printf("%-48s %14.4f %14.4f %+8.2f%%%s\n", metric->key, base_value, metric->value, change_pct,
+                   regressed ? "  REGRESSION" : "");
+            regressions += regressed;
+            break;
+        }
+    }
+
+    if (regressions > 0) {
+        printf("%u metrics regressed more than %.1f%%\n", regressions, threshold_pct);
+        return 1;
+    }
+    printf("No regressions over %.1f%%\n", threshold_pct);
+    return 0;
+}
+
+u32 scaled_count(u32 n, f64 scale)
+{
+    u32 count = (u32)((f64)n * scale);
+    return count > 0 ? count : 1;
+}
+
+int main(int argc, char** argv)
+{
+    const char* out_filename = "bench_results.json";
+    u32 frames = 300;
+    f64 scale = 1.0;
+    bool swapchain = false;
+    u32 msaa_samples = 0;
+    bool depth_prepass = false;
+    const char* mesh_filename = NULL;
+    bool vulkan_1_0 = false;
+    bool command_cache = true;
+    bool post = false;
+    u32 light_count = 0;
+
+    for (i32 i = 1; i < argc; i += 1) {
+        if (strcmp(argv[i], "--compare") == 0 && i + 2 < argc) {
+            f64 threshold_pct = 5.0;
+            if (i + 4 < argc && strcmp(argv[i + 3], "--threshold") == 0) {
+                threshold_pct = atof(argv[i + 4]);
+            }
+            return compare_results(argv[i + 1], argv[i + 2], threshold_pct);
+        } else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            out_filename = argv[++i];
+        } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            frames = (u32)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--scale") == 0 && i + 1 < argc) {
+            scale = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--msaa") == 0 && i + 1 < argc) {
+            msaa_samples = (u32)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--depth-prepass") == 0) {
+            depth_prepass = true;
+        } else if (strcmp(argv[i], "--swapchain") == 0) {
+            swapchain = true;
+        } else if (strcmp(argv[i], "--vulkan-1.0") == 0) {
+            vulkan_1_0 = true;
+        } else if (strcmp(argv[i], "--no-command-cache") == 0) {
+            command_cache = false;
+        } else if (strcmp(argv[i], "--post") == 0) {
+            post = true;
+        } else if (strcmp(argv[i], "--lights") == 0 && i + 1 < argc) {
+            light_count = (u32)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--mesh") == 0 && i + 1 < argc) {
+            mesh_filename = argv[++i];
+        } else {
+            printf("usage: %s [--out file.json] [--frames N] [--scale S] [--msaa N] [--depth-prepass]\n"
+                   "       %*s [--swapchain] [--mesh file.mesh] [--vulkan-1.0] [--no-command-cache] [--post]\n"
+                   "       %*s [--lights N]\n"
+                   "       %s --compare base.json new.json [--threshold pct]\n",
+                   argv[0], (int)strlen(argv[0]), "", (int)strlen(argv[0]), "", argv[0]);
+            return 1;
+        }
+    }
+    if (frames == 0) {
+        frames = 1;
+    }
+
+    u32 n_triangles = scaled_count(100000, scale);
+    u32 n_draw_calls = scaled_count(10000, scale);
+    u32 n_instances = scaled_count(100000, scale);
+    u32 n_pipelines = scaled_count(64, scale);
+    u32 n_layers = scaled_count(32, scale);
+    u32 n_sprites = scaled_count(50000, scale);
+    u32 n_metric_samples = scaled_count(10000000, scale);
+    if (n_sprites > SPRITE_MAX_QUADS) {
+        n_sprites = SPRITE_MAX_QUADS;
+    }
+
+    // the grid workloads take the global --depth-prepass, the overdraw one runs both ways to compare
+    Workload workloads[BENCH_MAX_WORKLOADS] = {
+        {.name = swapchain ? "swapchain_present" : "offscreen_present",
+         .kind = WORKLOAD_FRAMES,
+         .n = 1,
+         .draw = {3, 1, 1},
+         .depth_prepass = depth_prepass},
+        {.name = "triangles",
+         .kind = WORKLOAD_FRAMES,
+         .n = n_triangles,
+         .draw = {3 * n_triangles, 1, 1},
+         .depth_prepass = depth_prepass},
+        {.name = "draw_calls",
+         .kind = WORKLOAD_FRAMES,
+         .n = n_draw_calls,
+         .draw = {3, 1, n_draw_calls},
+         .depth_prepass = depth_prepass},
+        {.name = "instances",
+         .kind = WORKLOAD_FRAMES,
+         .n = n_instances,
+         .draw = {3, n_instances, 1},
+         .depth_prepass = depth_prepass},
+        {.name = "overdraw", .kind = WORKLOAD_FRAMES, .n = n_layers, .draw = {3, n_layers, 1}, .scene = SCENE_OVERDRAW},
+        {.name = "overdraw_prepass",
+         .kind = WORKLOAD_FRAMES,
+         .n = n_layers,
+         .draw = {3, n_layers, 1},
+         .scene = SCENE_OVERDRAW,
+         .depth_prepass = true},
+        {.name = "pipelines", .kind = WORKLOAD_PIPELINES, .n = n_pipelines},
+        {.name = "sprites", .kind = WORKLOAD_SPRITES, .n = n_sprites, .draw = {0, 1, 0}},
+        {.name = "metrics", .kind = WORKLOAD_METRICS, .n = n_metric_samples},
+    };
+    u32 workload_count = 0;
+    while (workloads[workload_count].name != NULL) {
+        workload_count += 1;
+    }
+
+    App app = {0};
+    app.headless = !swapchain;
+    app.requested_msaa_samples = msaa_samples;
+    app.mesh_filename = mesh_filename;
+    app.force_vulkan_1_0 = vulkan_1_0;
+    app.disable_command_cache = !command_cache;
+    app.post_processing = post;
+    app.light_count = light_count;
+    start_init_tasks(&app);
+    if (swapchain) {
+        init_window(&app);
+    }
+    init_vulkan(&app);
+    create_sprite_renderer(&app);
+
+    if (app.mesh != NULL) {
+        workloads[workload_count] = (Workload){
+            .name = "mesh",
+            .kind = WORKLOAD_FRAMES,
+            .n = app.mesh->index_count / 3,
+            .draw = {0, 1, 1, app.mesh},
+            .scene = SCENE_MESH,
+            .depth_prepass = depth_prepass,
+        };
+        workload_count += 1;
+    }
+
+    // The engine's triangle is swapped for the bench scenes, so big counts do not turn into a fill rate test. Keep
+    // the engine pipelines aside, cleanup destroys them. Pinned, the memory pressure does not retire them meanwhile
+    BenchPipelines engine_pipelines = {
+        .pipeline = app.vk_pipeline,
+        .depth_prepass_pipeline = app.vk_depth_prepass_pipeline,
+        .equal_pipeline = app.vk_equal_pipeline,
+    };
+    pin_pipeline_variant(&app, engine_pipelines.pipeline);
+    pin_pipeline_variant(&app, engine_pipelines.depth_prepass_pipeline);
+    pin_pipeline_variant(&app, engine_pipelines.equal_pipeline);
+    Shader frag_shader_binary = read_file("build/shaders/fragment.spv");
+    VkShaderModule frag_module = create_shader_module(&app, frag_shader_binary.binary, frag_shader_binary.size);
+    free(frag_shader_binary.binary);
+    BenchPipelines scenes[SCENE_COUNT];
+    load_bench_pipelines(&app, "build/shaders/bench_vertex.spv", frag_module, &scenes[SCENE_GRID]);
+    load_bench_pipelines(&app, "build/shaders/overdraw_vertex.spv", frag_module, &scenes[SCENE_OVERDRAW]);
+    scenes[SCENE_MESH] = engine_pipelines;
+
+    WorkloadResult results[BENCH_MAX_WORKLOADS];
+    for (u32 i = 0; i < workload_count; i += 1) {
+        printf("[BENCH] running %s (n = %u)\n", workloads[i].name, workloads[i].n);
+        if (workloads[i].kind == WORKLOAD_FRAMES) {
+            results[i] = run_frames(&app, &workloads[i], scenes, frames);
+        } else if (workloads[i].kind == WORKLOAD_SPRITES) {
+            results[i] = run_sprites(&app, &workloads[i], scenes, frames);
+        } else if (workloads[i].kind == WORKLOAD_METRICS) {
+            results[i] = run_metrics(&workloads[i]);
+        } else {
+            results[i] = run_pipelines(&app, &workloads[i], scenes[SCENE_GRID].vert_module, frag_module);
+        }
+        printf("[BENCH] %s: %.2f/s, cpu %.4f ms (record %.4f ms), p50 %.4f ms, p99 %.4f ms\n", results[i].name,
+               results[i].per_s, results[i].cpu_ms, results[i].record_ms, results[i].p50_ms, results[i].p99_ms);
+        if (workloads[i].kind == WORKLOAD_SPRITES) {
+            printf("[BENCH] %s: %.1f quads/ms batched into %u draws\n", results[i].name, results[i].quads_per_ms,
+                   app.sprites->batch_count);
+            // no sprites over the next workloads
+            begin_sprites(&app);
+            end_sprites(&app);
+        } else if (workloads[i].kind == WORKLOAD_METRICS) {
+            printf("[BENCH] %s: %.2f ns per sample\n", results[i].name, 1e9 / results[i].per_s);
+        }
+    }
+
+    for (u32 i = 0; i < SCENE_COUNT; i += 1) {
+        if (i != SCENE_MESH) {
+            destroy_bench_pipelines(&app, &scenes[i]);
+        }
+    }
+    vkDestroyShaderModule(app.vk_device, frag_module, NULL);
+    use_bench_pipelines(&app, &engine_pipelines);
+    unpin_pipeline_variant(&app, engine_pipelines.pipeline);
+    unpin_pipeline_variant(&app, engine_pipelines.depth_prepass_pipeline);
+    unpin_pipeline_variant(&app, engine_pipelines.equal_pipeline);
+
+    write_results(out_filename, &app, results, workload_count);
+    printf("[BENCH] results written to %s\n", out_filename);
+
+    cleanup(&app);
+    return 0;
+}
@@ -0,0 +1,35 @@
+#version 450
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec3 fragPosition; // see shader.frag
+layout(location = 2) out vec3 fragNormal;
+
+invariant gl_Position; // see mesh.vert
+
+// Every triangle gets its own cell of a GRID x GRID grid, so the fill cost stays small whatever the count and the
+// benchmark measures the geometry/submission side and not a software rasterizer filling the screen over and over.
+const uint GRID = 256;
+
+vec2 positions[3] = vec2[](
+        vec2(0.0, -0.5),
+        vec2(0.5, 0.5),
+        vec2(-0.5, 0.5)
+    );
+
+vec3 colors[3] = vec3[](
+        vec3(0.5, 0.5, 0.0),
+        vec3(0.0, 0.5, 0.5),
+        vec3(0.5, 0.0, 0.5)
+    );
+
+void main() {
+    uint triangle = uint(gl_VertexIndex) / 3u + uint(gl_InstanceIndex);
+    uint cell = triangle % (GRID * GRID);
+    float cell_size = 2.0 / float(GRID);
+    vec2 origin = vec2(float(cell % GRID), float(cell / GRID)) * cell_size - 1.0 + 0.5 * cell_size;
+
+    gl_Position = vec4(origin + positions[gl_VertexIndex % 3] * cell_size, 0.0, 1.0);
+    fragColor = colors[gl_VertexIndex % 3];
+    fragPosition = vec3(gl_Position.x, -gl_Position.y, -1.0); // depth 0 is z = -1
+    fragNormal = vec3(0.0, 0.0, 1.0);
+}
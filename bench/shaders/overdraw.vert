@@ -0,0 +1,30 @@
+#version 450
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec3 fragPosition; // see shader.frag
+layout(location = 2) out vec3 fragNormal;
+
+invariant gl_Position; // see mesh.vert
+
+// Full screen triangles stacked back to front. Depth is reversed-Z (nearer is bigger), and every instance is nearer
+// than the previous one, so without a depth prepass every layer gets shaded: the worst case for overdraw.
+vec2 positions[3] = vec2[](
+        vec2(-1.0, -1.0),
+        vec2(3.0, -1.0),
+        vec2(-1.0, 3.0)
+    );
+
+vec3 colors[3] = vec3[](
+        vec3(0.5, 0.5, 0.0),
+        vec3(0.0, 0.5, 0.5),
+        vec3(0.5, 0.0, 0.5)
+    );
+
+void main() {
+    float depth = 1.0 - 1.0 / float(gl_InstanceIndex + 2);
+
+    gl_Position = vec4(positions[gl_VertexIndex % 3], depth, 1.0);
+    fragColor = colors[(gl_VertexIndex + gl_InstanceIndex) % 3];
+    fragPosition = vec3(gl_Position.x, -gl_Position.y, 2.0 * depth - 1.0);
+    fragNormal = vec3(0.0, 0.0, 1.0);
+}
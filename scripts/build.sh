@@ -1,5 +1,26 @@
 FLAGS=$(cat compile_flags.txt)
+# scripts/build.sh [all|engine|bench|replay|meshcook]
+TARGET=${1:-all}
 
 mkdir -p build
 # compile the shaders
-clang -o build/engine src/*.c $FILES $FLAGS 
\ No newline at end of file
+if [ "$TARGET" = "all" ] || [ "$TARGET" = "engine" ]; then
+    clang -o build/engine src/*.c $FILES $FLAGS
+fi
+
+# the benchmark links the engine without its main, optimized and without the validation layers
+if [ "$TARGET" = "all" ] || [ "$TARGET" = "bench" ]; then
+    ENGINE_FILES=$(ls src/*.c | grep -v src/main.c)
+    clang -o build/bench bench/*.c $ENGINE_FILES -Isrc $FLAGS -O2 -DNDEBUG
+fi
+
+# the capture replayer, built like the benchmark
+if [ "$TARGET" = "all" ] || [ "$TARGET" = "replay" ]; then
+    ENGINE_FILES=$(ls src/*.c | grep -v src/main.c)
+    clang -o build/replay tools/replay.c $ENGINE_FILES -Isrc $FLAGS -O2 -DNDEBUG
+fi
+
+# the offline mesh cooker, it needs neither vulkan nor glfw
+if [ "$TARGET" = "all" ] || [ "$TARGET" = "meshcook" ]; then
+    clang -o build/meshcook tools/meshcook.c -Isrc $FLAGS -O2 -lm
+fi
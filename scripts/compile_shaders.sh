@@ -1,3 +1,17 @@
 mkdir -p ./build/shaders
 glslc src/shaders/shader.vert -o build/shaders/vertex.spv
 glslc src/shaders/shader.frag -o build/shaders/fragment.spv
+glslc bench/shaders/bench.vert -o build/shaders/bench_vertex.spv
+glslc bench/shaders/overdraw.vert -o build/shaders/overdraw_vertex.spv
+# one module for all the vertex formats, the variants are specialization constants
+glslc src/shaders/mesh.vert -o build/shaders/mesh_vertex.spv
+# the 2D batch renderer
+glslc src/shaders/sprite.vert -o build/shaders/sprite_vertex.spv
+glslc src/shaders/sprite.frag -o build/shaders/sprite_fragment.spv
+# the compute post processing chain, subgroup operations need SPIR-V 1.3
+glslc --target-env=vulkan1.1 src/shaders/post_downsample.comp -o build/shaders/post_downsample.spv
+glslc --target-env=vulkan1.1 src/shaders/post_blur.comp -o build/shaders/post_blur.spv
+glslc --target-env=vulkan1.1 src/shaders/post_upsample.comp -o build/shaders/post_upsample.spv
+glslc --target-env=vulkan1.1 src/shaders/post_tonemap.comp -o build/shaders/post_tonemap.spv
+# the light binning of the clustered forward lighting
+glslc src/shaders/cluster_lights.comp -o build/shaders/cluster_lights.spv
@@ -0,0 +1,603 @@
+#include "capture.h"
+#include "lighting.h"
+
+void write_capture_record(Capture* capture, CaptureOp op, const void* payload, u32 size, const void* data,
+                          u32 data_size)
+{
+    CaptureRecord record = {.op = op, .size = size + data_size};
+    fwrite(&record, sizeof(record), 1, capture->file);
+    if (size > 0) {
+        fwrite(payload, size, 1, capture->file);
+    }
+    if (data_size > 0) {
+        fwrite(data, data_size, 1, capture->file);
+    }
+    capture->bytes += sizeof(record) + size + data_size;
+}
+
+// Starts capturing at init_vulkan when a capture file is set, so the objects of the startup are known. The frames
+// are written from the first one on
+void begin_capture(App* pApp)
+{
+    if (pApp->capture_filename == NULL || pApp->capture != NULL) {
+        return;
+    }
+    Capture* capture = (Capture*)calloc(1, sizeof(Capture));
+    capture->file = fopen(pApp->capture_filename, "wb");
+    if (capture->file == NULL) {
+        printf("Could not open %s to write the capture!\n", pApp->capture_filename);
+        exit(1);
+    }
+    capture->frames_left = pApp->capture_frame_count > 0 ? pApp->capture_frame_count : CAPTURE_DEFAULT_FRAMES;
+    pthread_mutex_init(&capture->mutex, NULL);
+
+    // the extent and the samples are not known yet, the header is written again at the end
+    CaptureHeader header = {.magic = CAPTURE_MAGIC, .version = CAPTURE_VERSION};
+    fwrite(&header, sizeof(header), 1, capture->file);
+    capture->bytes = sizeof(header);
+    pApp->capture = capture;
+}
+
+void end_capture(App* pApp)
+{
+    Capture* capture = pApp->capture;
+    if (capture == NULL) {
+        return;
+    }
+    CaptureHeader header = {
+        .magic = CAPTURE_MAGIC,
+        .version = CAPTURE_VERSION,
+        .width = pApp->vk_extent.width,
+        .height = pApp->vk_extent.height,
+        .msaa_samples = pApp->vk_msaa_samples,
+        .flags = pApp->post != NULL ? CAPTURE_FLAG_POST : 0,
+        .frame_count = capture->frame_count,
+    };
+    fseek(capture->file, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, capture->file);
+    fclose(capture->file);
+    printf("Captured %u frames to %s (%.2f MB, %u shaders, %u pipelines, %u buffers)\n", capture->frame_count,
+           pApp->capture_filename, (f64)capture->bytes / (1024.0 * 1024.0), capture->next_shader_id,
+           capture->next_pipeline_id, capture->next_buffer_id);
+
+    for (u32 i = 0; i < capture->shader_count; i += 1) {
+        free(capture->shaders[i].code);
+    }
+    for (u32 i = 0; i < capture->buffer_count; i += 1) {
+        free(capture->buffers[i].data);
+    }
+    free(capture->shaders);
+    free(capture->pipelines);
+    free(capture->buffers);
+    pthread_mutex_destroy(&capture->mutex);
+    free(capture);
+    pApp->capture = NULL;
+}
+
+// the SPIR-V is kept, a module can not be read back
+void capture_shader_module(App* pApp, VkShaderModule module, const void* code, u32 size)
+{
+    Capture* capture = pApp->capture;
+    pthread_mutex_lock(&capture->mutex);
+    if (capture->shader_count == capture->shader_capacity) {
+        capture->shader_capacity = capture->shader_capacity > 0 ? capture->shader_capacity * 2 : 8;
+        capture->shaders =
+            (CapturedShader*)realloc(capture->shaders, capture->shader_capacity * sizeof(CapturedShader));
+    }
+    CapturedShader* shader = &capture->shaders[capture->shader_count++];
+    shader->module = module;
+    shader->code = malloc(size);
+    memcpy(shader->code, code, size);
+    shader->size = size;
+    shader->id = 0;
+    pthread_mutex_unlock(&capture->mutex);
+}
+
+// A destroyed pipeline's handle can come back for a new one: the newest entry of a handle wins
+void capture_pipeline(App* pApp, VkPipeline pipeline, VkShaderModule vert_module, VkShaderModule frag_module,
+                      const VertexLayout* vertex_layout, DepthMode depth_mode, const ShaderConstants* constants)
+{
+    Capture* capture = pApp->capture;
+    pthread_mutex_lock(&capture->mutex);
+    if (capture->pipeline_count == capture->pipeline_capacity) {
+        capture->pipeline_capacity = capture->pipeline_capacity > 0 ? capture->pipeline_capacity * 2 : 16;
+        capture->pipelines =
+            (CapturedPipeline*)realloc(capture->pipelines, capture->pipeline_capacity * sizeof(CapturedPipeline));
+    }
+    CapturedPipeline* entry = &capture->pipelines[capture->pipeline_count++];
+    memset(entry, 0, sizeof(*entry));
+    entry->pipeline = pipeline;
+    entry->vert_module = vert_module;
+    entry->frag_module = frag_module;
+    entry->has_vertex_input = vertex_layout != NULL;
+    if (vertex_layout != NULL) {
+        entry->vertex_layout = *vertex_layout;
+    }
+    entry->depth_mode = depth_mode;
+    entry->has_constants = constants != NULL;
+    if (constants != NULL) {
+        entry->constants = *constants;
+    }
+    pthread_mutex_unlock(&capture->mutex);
+}
+
+void capture_buffer(App* pApp, VkBuffer buffer, VkBufferUsageFlags usage, const void* data, u64 size)
+{
+    Capture* capture = pApp->capture;
+    // the contents go in one record, and the size of a record is a u32
+    if (size > UINT32_MAX - sizeof(CaptureBuffer)) {
+        printf("Cannot capture a buffer of %llu bytes, a record holds at most %llu!\n", (unsigned long long)size,
+               (unsigned long long)(UINT32_MAX - sizeof(CaptureBuffer)));
+        exit(1);
+    }
+    pthread_mutex_lock(&capture->mutex);
+    if (capture->buffer_count == capture->buffer_capacity) {
+        capture->buffer_capacity = capture->buffer_capacity > 0 ? capture->buffer_capacity * 2 : 4;
+        capture->buffers =
+            (CapturedBuffer*)realloc(capture->buffers, capture->buffer_capacity * sizeof(CapturedBuffer));
+    }
+    CapturedBuffer* entry = &capture->buffers[capture->buffer_count++];
+    entry->buffer = buffer;
+    entry->usage = usage;
+    entry->data = malloc(size);
+    memcpy(entry->data, data, size);
+    entry->size = size;
+    entry->id = 0;
+    pthread_mutex_unlock(&capture->mutex);
+}
+
+// the ids of the objects, written out the first time they are used. Called with the mutex held
+u32 emit_shader(Capture* capture, VkShaderModule module)
+{
+    if (module == VK_NULL_HANDLE) {
+        return 0;
+    }
+    for (i32 i = (i32)capture->shader_count - 1; i >= 0; i -= 1) {
+        CapturedShader* shader = &capture->shaders[i];
+        if (shader->module != module) {
+            continue;
+        }
+        if (shader->id == 0) {
+            shader->id = ++capture->next_shader_id;
+            CaptureShader payload = {.id = shader->id, .size = shader->size};
+            write_capture_record(capture, CAPTURE_OP_SHADER, &payload, sizeof(payload), shader->code, shader->size);
+        }
+        return shader->id;
+    }
+    return 0;
+}
+
+u32 emit_pipeline(Capture* capture, VkPipeline pipeline)
+{
+    for (i32 i = (i32)capture->pipeline_count - 1; i >= 0; i -= 1) {
+        CapturedPipeline* entry = &capture->pipelines[i];
+        if (entry->pipeline != pipeline) {
+            continue;
+        }
+        if (entry->id == 0) {
+            CapturePipeline payload = {
+                .vert_shader = emit_shader(capture, entry->vert_module),
+                .frag_shader = emit_shader(capture, entry->frag_module),
+                .has_vertex_input = entry->has_vertex_input,
+                .vertex_layout = entry->vertex_layout,
+                .depth_mode = entry->depth_mode,
+                .has_constants = entry->has_constants,
+                .constants = entry->constants,
+            };
+            entry->id = ++capture->next_pipeline_id;
+            payload.id = entry->id;
+            write_capture_record(capture, CAPTURE_OP_PIPELINE, &payload, sizeof(payload), NULL, 0);
+        }
+        return entry->id;
+    }
+    return 0;
+}
+
+u32 emit_buffer(Capture* capture, VkBuffer buffer)
+{
+    for (i32 i = (i32)capture->buffer_count - 1; i >= 0; i -= 1) {
+        CapturedBuffer* entry = &capture->buffers[i];
+        if (entry->buffer != buffer) {
+            continue;
+        }
+        if (entry->id == 0) {
+            entry->id = ++capture->next_buffer_id;
+            CaptureBuffer payload = {.id = entry->id, .usage = entry->usage, .size = entry->size};
+            write_capture_record(capture, CAPTURE_OP_BUFFER, &payload, sizeof(payload), entry->data,
+                                 (u32)entry->size);
+        }
+        return entry->id;
+    }
+    return 0;
+}
+
+void capture_frame_begin(App* pApp)
+{
+    CaptureFrame payload = {.frame = pApp->frame_count};
+    write_capture_record(pApp->capture, CAPTURE_OP_FRAME_BEGIN, &payload, sizeof(payload), NULL, 0);
+}
+
+// ends the capture after its last frame
+void capture_frame_end(App* pApp)
+{
+    Capture* capture = pApp->capture;
+    write_capture_record(capture, CAPTURE_OP_FRAME_END, NULL, 0, NULL, 0);
+    capture->frame_count += 1;
+    capture->frames_left -= 1;
+    if (capture->frames_left == 0) {
+        end_capture(pApp);
+    }
+}
+
+// The light binning of the frame, from record_light_binning: the pipeline when a reload changed its shader, then the
+// lights write_lights left in this frame slot's region
+void capture_light_binning(App* pApp)
+{
+    Capture* capture = pApp->capture;
+    Lighting* lighting = pApp->lighting;
+    if (capture->light_pipeline_id == 0 || capture->light_module != lighting->module) {
+        pthread_mutex_lock(&capture->mutex);
+        CaptureLightPipeline payload = {
+            .id = capture->light_pipeline_id + 1,
+            .shader = emit_shader(capture, lighting->module),
+        };
+        pthread_mutex_unlock(&capture->mutex);
+        write_capture_record(capture, CAPTURE_OP_LIGHT_PIPELINE, &payload, sizeof(payload), NULL, 0);
+        capture->light_pipeline_id = payload.id;
+        capture->light_module = lighting->module;
+    }
+
+    // read back from the ring, which may be write combined: slow, but only while capturing
+    CaptureDispatchLights dispatch = {
+        .pipeline = capture->light_pipeline_id,
+        .light_count = lighting->frame_counts[pApp->current_frame],
+    };
+    const PointLight* region = lighting->mapped + (u64)pApp->current_frame * LIGHT_MAX_COUNT;
+    write_capture_record(capture, CAPTURE_OP_DISPATCH_LIGHTS, &dispatch, sizeof(dispatch), region,
+                         dispatch.light_count * (u32)sizeof(PointLight));
+}
+
+void cmd_bind_pipeline(App* pApp, VkCommandBuffer command_buffer, VkPipeline pipeline)
+{
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    Capture* capture = pApp->capture;
+    if (capture == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&capture->mutex);
+    u32 id = emit_pipeline(capture, pipeline);
+    pthread_mutex_unlock(&capture->mutex);
+    if (id == 0 && !capture->warned_unknown_pipeline) {
+        printf("A pipeline not created by create_pipeline is not in the capture, its draws are skipped!\n");
+        capture->warned_unknown_pipeline = true;
+    }
+    write_capture_record(capture, CAPTURE_OP_BIND_PIPELINE, &id, sizeof(id), NULL, 0);
+}
+
+void cmd_bind_vertex_buffer(App* pApp, VkCommandBuffer command_buffer, VkBuffer buffer, VkDeviceSize offset)
+{
+    vkCmdBindVertexBuffers(command_buffer, 0, 1, &buffer, &offset);
+    Capture* capture = pApp->capture;
+    if (capture == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&capture->mutex);
+    CaptureBindBuffer payload = {.buffer = emit_buffer(capture, buffer), .offset = offset};
+    pthread_mutex_unlock(&capture->mutex);
+    write_capture_record(capture, CAPTURE_OP_BIND_VERTEX_BUFFER, &payload, sizeof(payload), NULL, 0);
+}
+
+void cmd_bind_index_buffer(App* pApp, VkCommandBuffer command_buffer, VkBuffer buffer, VkDeviceSize offset,
+                           VkIndexType index_type)
+{
+    vkCmdBindIndexBuffer(command_buffer, buffer, offset, index_type);
+    Capture* capture = pApp->capture;
+    if (capture == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&capture->mutex);
+    CaptureBindBuffer payload = {.buffer = emit_buffer(capture, buffer), .index_type = index_type, .offset = offset};
+    pthread_mutex_unlock(&capture->mutex);
+    write_capture_record(capture, CAPTURE_OP_BIND_INDEX_BUFFER, &payload, sizeof(payload), NULL, 0);
+}
+
+void cmd_push_constants(App* pApp, VkCommandBuffer command_buffer, VkPipelineLayout layout, VkShaderStageFlags stages,
+                        u32 offset, u32 size, const void* values)
+{
+    vkCmdPushConstants(command_buffer, layout, stages, offset, size, values);
+    if (pApp->capture != NULL) {
+        CapturePushConstants payload = {.stages = stages, .offset = offset, .size = size};
+        write_capture_record(pApp->capture, CAPTURE_OP_PUSH_CONSTANTS, &payload, sizeof(payload), values, size);
+    }
+}
+
+void cmd_draw(App* pApp, VkCommandBuffer command_buffer, u32 vertex_count, u32 instance_count, u32 first_vertex,
+              u32 first_instance)
+{
+    vkCmdDraw(command_buffer, vertex_count, instance_count, first_vertex, first_instance);
+    if (pApp->capture != NULL) {
+        CaptureDraw payload = {vertex_count, instance_count, first_vertex, first_instance};
+        write_capture_record(pApp->capture, CAPTURE_OP_DRAW, &payload, sizeof(payload), NULL, 0);
+    }
+}
+
+void cmd_draw_indexed(App* pApp, VkCommandBuffer command_buffer, u32 index_count, u32 instance_count, u32 first_index,
+                      i32 vertex_offset, u32 first_instance)
+{
+    vkCmdDrawIndexed(command_buffer, index_count, instance_count, first_index, vertex_offset, first_instance);
+    if (pApp->capture != NULL) {
+        CaptureDrawIndexed payload = {index_count, instance_count, first_index, vertex_offset, first_instance};
+        write_capture_record(pApp->capture, CAPTURE_OP_DRAW_INDEXED, &payload, sizeof(payload), NULL, 0);
+    }
+}
+
+// Reads the whole stream and finds the frames. Nothing is created yet: the replay needs the header (the MSAA samples)
+// before init_vulkan
+Replay* read_replay(const char* filename)
+{
+    Shader file = read_file(filename); // just the bytes
+    if (file.size < sizeof(CaptureHeader)) {
+        printf("%s is not a capture!\n", filename);
+        exit(1);
+    }
+    Replay* replay = (Replay*)calloc(1, sizeof(Replay));
+    replay->data = (u8*)file.binary;
+    replay->size = file.size;
+    memcpy(&replay->header, replay->data, sizeof(CaptureHeader));
+    if (replay->header.magic != CAPTURE_MAGIC || replay->header.version != CAPTURE_VERSION) {
+        printf("%s is not a capture of version %u!\n", filename, CAPTURE_VERSION);
+        exit(1);
+    }
+
+    replay->frames = (ReplayFrame*)malloc((replay->header.frame_count + 1) * sizeof(ReplayFrame));
+    u64 offset = sizeof(CaptureHeader);
+    while (offset + sizeof(CaptureRecord) <= replay->size) {
+        CaptureRecord record;
+        memcpy(&record, replay->data + offset, sizeof(record));
+        u64 payload = offset + sizeof(record);
+        if (payload + record.size > replay->size) {
+            printf("The capture %s is truncated!\n", filename);
+            exit(1);
+        }
+        if (record.op == CAPTURE_OP_FRAME_BEGIN && replay->frame_count < replay->header.frame_count) {
+            replay->frames[replay->frame_count].offset = payload + record.size;
+        } else if (record.op == CAPTURE_OP_FRAME_END && replay->frame_count < replay->header.frame_count) {
+            ReplayFrame* frame = &replay->frames[replay->frame_count++];
+            frame->size = offset - frame->offset;
+        }
+        offset = payload + record.size;
+    }
+    if (replay->frame_count == 0) {
+        printf("The capture %s has no frames!\n", filename);
+        exit(1);
+    }
+    return replay;
+}
+
+// a resource id of the stream, checked
+u32 replay_id(u32 id, u32 count, const char* what)
+{
+    if (id == 0 || id > count) {
+        printf("The capture uses %s %u, it only has %u!\n", what, id, count);
+        exit(1);
+    }
+    return id - 1;
+}
+
+// Creates every shader, pipeline and buffer of the stream up front, for the engine's render pass and pipeline layout
+void create_replay_objects(App* pApp, Replay* replay)
+{
+    f64 start_ms = now_ms();
+    u64 offset = sizeof(CaptureHeader);
+    while (offset + sizeof(CaptureRecord) <= replay->size) {
+        CaptureRecord record;
+        memcpy(&record, replay->data + offset, sizeof(record));
+        const u8* payload = replay->data + offset + sizeof(record);
+        offset += sizeof(record) + record.size;
+
+        if (record.op == CAPTURE_OP_SHADER) {
+            CaptureShader shader;
+            memcpy(&shader, payload, sizeof(shader));
+            replay->shaders = (VkShaderModule*)realloc(replay->shaders, shader.id * sizeof(VkShaderModule));
+            replay->shader_count = shader.id;
+            // create_shader_module wants aligned words
+            char* code = (char*)malloc(shader.size);
+            memcpy(code, payload + sizeof(shader), shader.size);
+            replay->shaders[shader.id - 1] = create_shader_module(pApp, code, shader.size);
+            free(code);
+        } else if (record.op == CAPTURE_OP_PIPELINE) {
+            CapturePipeline pipeline;
+            memcpy(&pipeline, payload, sizeof(pipeline));
+            replay->pipelines = (VkPipeline*)realloc(replay->pipelines, pipeline.id * sizeof(VkPipeline));
+            replay->pipeline_count = pipeline.id;
+            VkShaderModule vert_module =
+                replay->shaders[replay_id(pipeline.vert_shader, replay->shader_count, "shader")];
+            VkShaderModule frag_module = pipeline.frag_shader == 0
+                                             ? VK_NULL_HANDLE
+                                             : replay->shaders[replay_id(pipeline.frag_shader, replay->shader_count,
+                                                                         "shader")];
+            const VertexLayout* vertex_layout = pipeline.has_vertex_input ? &pipeline.vertex_layout : NULL;
+            replay->pipelines[pipeline.id - 1] = create_pipeline(pApp, vert_module, frag_module, vertex_layout,
+                                                                 (DepthMode)pipeline.depth_mode,
+                                                                 pipeline.has_constants ? &pipeline.constants : NULL);
+        } else if (record.op == CAPTURE_OP_BUFFER) {
+            CaptureBuffer buffer = {0};
+            if (record.size >= sizeof(buffer)) {
+                memcpy(&buffer, payload, sizeof(buffer));
+            }
+            if (record.size < sizeof(buffer) || buffer.size != record.size - sizeof(buffer)) {
+                printf("Buffer %u of the capture has %llu bytes in a record of %u!\n", buffer.id,
+                       (unsigned long long)buffer.size, record.size);
+                exit(1);
+            }
+            replay->buffers = (VkBuffer*)realloc(replay->buffers, buffer.id * sizeof(VkBuffer));
+            replay->buffer_memories =
+                (VkDeviceMemory*)realloc(replay->buffer_memories, buffer.id * sizeof(VkDeviceMemory));
+            replay->buffer_count = buffer.id;
+
+            VkBuffer staging_buffer;
+            VkDeviceMemory staging_memory;
+            create_buffer(pApp, buffer.size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                          MEMORY_CATEGORY_STAGING, &staging_buffer, &staging_memory);
+            void* mapped;
+            vkMapMemory(pApp->vk_device, staging_memory, 0, buffer.size, 0, &mapped);
+            memcpy(mapped, payload + sizeof(buffer), buffer.size);
+            vkUnmapMemory(pApp->vk_device, staging_memory);
+            create_buffer(pApp, buffer.size, buffer.usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MEMORY_CATEGORY_BUFFER,
+                          &replay->buffers[buffer.id - 1], &replay->buffer_memories[buffer.id - 1]);
+            copy_buffer(pApp, staging_buffer, replay->buffers[buffer.id - 1], buffer.size);
+            vkDestroyBuffer(pApp->vk_device, staging_buffer, NULL);
+            free_memory(pApp, staging_memory);
+        } else if (record.op == CAPTURE_OP_LIGHT_PIPELINE) {
+            CaptureLightPipeline light_pipeline;
+            memcpy(&light_pipeline, payload, sizeof(light_pipeline));
+            replay->light_pipelines =
+                (VkPipeline*)realloc(replay->light_pipelines, light_pipeline.id * sizeof(VkPipeline));
+            replay->light_pipeline_count = light_pipeline.id;
+            VkShaderModule module = replay->shaders[replay_id(light_pipeline.shader, replay->shader_count, "shader")];
+            replay->light_pipelines[light_pipeline.id - 1] = build_light_binning_pipeline(pApp, module);
+        }
+    }
+    printf("Replay objects created in %.2f ms: %u shaders, %u pipelines, %u buffers, %u light pipelines, %u frames\n",
+           now_ms() - start_ms, replay->shader_count, replay->pipeline_count, replay->buffer_count,
+           replay->light_pipeline_count, replay->frame_count);
+}
+
+// Before the render pass: the captured lights of the current frame of the stream into this frame slot's region (the
+// GPU is done with it, like in write_lights) and their binning with the captured shader
+void record_replay_light_binning(App* pApp, VkCommandBuffer command_buffer)
+{
+    Replay* replay = pApp->replay;
+    Lighting* lighting = pApp->lighting;
+    const ReplayFrame* frame = &replay->frames[replay->current_frame];
+
+    u64 offset = frame->offset;
+    u64 end = frame->offset + frame->size;
+    while (offset < end) {
+        CaptureRecord record;
+        memcpy(&record, replay->data + offset, sizeof(record));
+        const u8* payload = replay->data + offset + sizeof(record);
+        offset += sizeof(record) + record.size;
+        if (record.op != CAPTURE_OP_DISPATCH_LIGHTS) {
+            continue;
+        }
+
+        CaptureDispatchLights dispatch;
+        memcpy(&dispatch, payload, sizeof(dispatch));
+        if (dispatch.light_count > LIGHT_MAX_COUNT) {
+            printf("The capture has %u lights in a frame, the most is %u!\n", dispatch.light_count, LIGHT_MAX_COUNT);
+            exit(1);
+        }
+        VkPipeline pipeline =
+            replay->light_pipelines[replay_id(dispatch.pipeline, replay->light_pipeline_count, "light pipeline")];
+        PointLight* region = lighting->mapped + (u64)pApp->current_frame * LIGHT_MAX_COUNT;
+        memcpy(region, payload + sizeof(dispatch), dispatch.light_count * sizeof(PointLight));
+        record_light_dispatch(pApp, command_buffer, pipeline, dispatch.light_count);
+        return;
+    }
+    printf("Frame %u of the capture has no lights!\n", replay->current_frame);
+    exit(1);
+}
+
+// The commands of the current frame of the stream, inside the render pass. The resource records in between were
+// created up front and are skipped, so are the lights (record_replay_light_binning)
+void record_replay_commands(App* pApp, VkCommandBuffer command_buffer)
+{
+    Replay* replay = pApp->replay;
+    const ReplayFrame* frame = &replay->frames[replay->current_frame];
+
+    VkViewport viewport = {0.0f, 0.0f, (f32)pApp->vk_extent.width, (f32)pApp->vk_extent.height, 0.0f, 1.0f};
+    VkRect2D scissor = {{0, 0}, pApp->vk_extent};
+    vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+    vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+
+    bool has_pipeline = false;
+    u64 offset = frame->offset;
+    u64 end = frame->offset + frame->size;
+    while (offset < end) {
+        CaptureRecord record;
+        memcpy(&record, replay->data + offset, sizeof(record));
+        const u8* payload = replay->data + offset + sizeof(record);
+        offset += sizeof(record) + record.size;
+
+        switch (record.op) {
+        case CAPTURE_OP_BIND_PIPELINE: {
+            u32 id;
+            memcpy(&id, payload, sizeof(id));
+            has_pipeline = id != 0;
+            if (has_pipeline) {
+                VkPipeline pipeline = replay->pipelines[replay_id(id, replay->pipeline_count, "pipeline")];
+                vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+            }
+            break;
+        }
+        case CAPTURE_OP_BIND_VERTEX_BUFFER:
+        case CAPTURE_OP_BIND_INDEX_BUFFER: {
+            CaptureBindBuffer bind;
+            memcpy(&bind, payload, sizeof(bind));
+            VkBuffer buffer = replay->buffers[replay_id(bind.buffer, replay->buffer_count, "buffer")];
+            if (record.op == CAPTURE_OP_BIND_VERTEX_BUFFER) {
+                vkCmdBindVertexBuffers(command_buffer, 0, 1, &buffer, &bind.offset);
+            } else {
+                vkCmdBindIndexBuffer(command_buffer, buffer, bind.offset, (VkIndexType)bind.index_type);
+            }
+            break;
+        }
+        case CAPTURE_OP_PUSH_CONSTANTS: {
+            CapturePushConstants push;
+            memcpy(&push, payload, sizeof(push));
+            vkCmdPushConstants(command_buffer, pApp->vk_pipeline_layout, push.stages, push.offset, push.size,
+                               payload + sizeof(push));
+            break;
+        }
+        case CAPTURE_OP_DRAW: {
+            CaptureDraw draw;
+            memcpy(&draw, payload, sizeof(draw));
+            if (has_pipeline) {
+                vkCmdDraw(command_buffer, draw.vertex_count, draw.instance_count, draw.first_vertex,
+                          draw.first_instance);
+            }
+            break;
+        }
+        case CAPTURE_OP_DRAW_INDEXED: {
+            CaptureDrawIndexed draw;
+            memcpy(&draw, payload, sizeof(draw));
+            if (has_pipeline) {
+                vkCmdDrawIndexed(command_buffer, draw.index_count, draw.instance_count, draw.first_index,
+                                 draw.vertex_offset, draw.first_instance);
+            }
+            break;
+        }
+        default:
+            break;
+        }
+    }
+    replay->current_frame = (replay->current_frame + 1) % replay->frame_count;
+}
+
+void destroy_replay(App* pApp, Replay* replay)
+{
+    for (u32 i = 0; i < replay->pipeline_count; i += 1) {
+        vkDestroyPipeline(pApp->vk_device, replay->pipelines[i], NULL);
+    }
+    for (u32 i = 0; i < replay->light_pipeline_count; i += 1) {
+        vkDestroyPipeline(pApp->vk_device, replay->light_pipelines[i], NULL);
+    }
+    for (u32 i = 0; i < replay->shader_count; i += 1) {
+        vkDestroyShaderModule(pApp->vk_device, replay->shaders[i], NULL);
+    }
+    for (u32 i = 0; i < replay->buffer_count; i += 1) {
+        vkDestroyBuffer(pApp->vk_device, replay->buffers[i], NULL);
+        free_memory(pApp, replay->buffer_memories[i]);
+    }
+    free(replay->pipelines);
+    free(replay->light_pipelines);
+    free(replay->shaders);
+    free(replay->buffers);
+    free(replay->buffer_memories);
+    free(replay->frames);
+    free(replay->data);
+    free(replay);
+}
@@ -0,0 +1,256 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include "engine.h"
+
+// Command stream capture and replay. With a capture file set, the engine writes what it submits as a binary stream:
+// the shaders, pipelines and buffer contents the frames use, then the commands of each frame. tools/replay.c plays
+// the stream back headless, with nothing of the engine's own scene, and times every frame, so two builds (or two
+// drivers) can be measured on the exact same commands.
+//
+//     header, then records: {op, size} followed by size bytes
+//     resources are written the first time a frame uses them, before the command that needs them
+//     a frame, in order:
+//         FRAME_BEGIN
+//         DISPATCH_LIGHTS (after a LIGHT_PIPELINE when the shader is new): the light binning, before the render pass
+//         the commands inside the render pass, the viewport and scissor cover the extent
+//         FRAME_END
+//     the post chain is not in the stream: CAPTURE_FLAG_POST in the header, the replay runs its own after FRAME_END
+//
+// The scene is recorded through the cmd_* wrappers below, they call Vulkan and append to the stream when capturing.
+// The captured frames are recorded inline, the command cache would hide the commands of all but the first frame.
+// The sprites are not captured.
+
+#define CAPTURE_MAGIC 0x50414356 // "VCAP"
+#define CAPTURE_VERSION 5
+#define CAPTURE_DEFAULT_FRAMES 300
+
+typedef enum CaptureOp
+{
+    CAPTURE_OP_SHADER = 1,         // CaptureShader, then the SPIR-V
+    CAPTURE_OP_PIPELINE,           // CapturePipeline
+    CAPTURE_OP_BUFFER,             // CaptureBuffer, then the contents
+    CAPTURE_OP_FRAME_BEGIN,        // CaptureFrame
+    CAPTURE_OP_FRAME_END,          // no payload
+    CAPTURE_OP_BIND_PIPELINE,      // u32 pipeline id, 0 for a pipeline the capture does not know
+    CAPTURE_OP_BIND_VERTEX_BUFFER, // CaptureBindBuffer
+    CAPTURE_OP_BIND_INDEX_BUFFER,  // CaptureBindBuffer
+    CAPTURE_OP_PUSH_CONSTANTS,     // CapturePushConstants, then the bytes
+    CAPTURE_OP_DRAW,               // CaptureDraw
+    CAPTURE_OP_DRAW_INDEXED,       // CaptureDrawIndexed
+    CAPTURE_OP_LIGHT_PIPELINE,     // CaptureLightPipeline
+    CAPTURE_OP_DISPATCH_LIGHTS,    // CaptureDispatchLights, then light_count PointLight: this frame's region
+} CaptureOp;
+
+typedef enum CaptureFlags
+{
+    CAPTURE_FLAG_POST = 1 << 0, // the frames ran the compute post chain (see post.h)
+} CaptureFlags;
+
+typedef struct CaptureHeader CaptureHeader;
+struct CaptureHeader {
+    u32 magic;
+    u32 version;
+    u32 width;
+    u32 height;
+    u32 msaa_samples;
+    u32 flags;       // CaptureFlags
+    u32 frame_count; // written when the capture ends
+};
+
+typedef struct CaptureRecord CaptureRecord;
+struct CaptureRecord {
+    u32 op;   // CaptureOp
+    u32 size; // of the payload that follows
+};
+
+typedef struct CaptureShader CaptureShader;
+struct CaptureShader {
+    u32 id;
+    u32 size;
+};
+
+typedef struct CapturePipeline CapturePipeline;
+struct CapturePipeline {
+    u32 id;
+    u32 vert_shader;
+    u32 frag_shader; // 0: none
+    u32 has_vertex_input;
+    VertexLayout vertex_layout;
+    u32 depth_mode; // DepthMode
+    u32 has_constants;
+    ShaderConstants constants;
+};
+
+typedef struct CaptureBuffer CaptureBuffer;
+struct CaptureBuffer {
+    u32 id;
+    u32 usage; // VkBufferUsageFlags
+    u64 size;
+};
+
+typedef struct CaptureFrame CaptureFrame;
+struct CaptureFrame {
+    u64 frame; // the engine's frame_count
+};
+
+typedef struct CaptureBindBuffer CaptureBindBuffer;
+struct CaptureBindBuffer {
+    u32 buffer;
+    u32 index_type; // VkIndexType, only for the index buffer
+    u64 offset;
+};
+
+typedef struct CapturePushConstants CapturePushConstants;
+struct CapturePushConstants {
+    u32 stages; // VkShaderStageFlags
+    u32 offset;
+    u32 size;
+};
+
+typedef struct CaptureDraw CaptureDraw;
+struct CaptureDraw {
+    u32 vertex_count;
+    u32 instance_count;
+    u32 first_vertex;
+    u32 first_instance;
+};
+
+typedef struct CaptureDrawIndexed CaptureDrawIndexed;
+struct CaptureDrawIndexed {
+    u32 index_count;
+    u32 instance_count;
+    u32 first_index;
+    i32 vertex_offset;
+    u32 first_instance;
+};
+
+// the binning pipeline, see build_light_binning_pipeline
+typedef struct CaptureLightPipeline CaptureLightPipeline;
+struct CaptureLightPipeline {
+    u32 id;
+    u32 shader;
+};
+
+typedef struct CaptureDispatchLights CaptureDispatchLights;
+struct CaptureDispatchLights {
+    u32 pipeline; // CaptureLightPipeline id
+    u32 light_count;
+};
+
+// What the capture knows about the objects created while it runs. Written out (given an id) on first use
+typedef struct CapturedShader CapturedShader;
+struct CapturedShader {
+    VkShaderModule module;
+    void* code;
+    u32 size;
+    u32 id; // 0 until written
+};
+
+typedef struct CapturedPipeline CapturedPipeline;
+struct CapturedPipeline {
+    VkPipeline pipeline;
+    VkShaderModule vert_module;
+    VkShaderModule frag_module;
+    bool has_vertex_input;
+    VertexLayout vertex_layout;
+    DepthMode depth_mode;
+    bool has_constants; // without them the shaders keep their defaults
+    ShaderConstants constants;
+    u32 id;
+};
+
+typedef struct CapturedBuffer CapturedBuffer;
+struct CapturedBuffer {
+    VkBuffer buffer;
+    VkBufferUsageFlags usage;
+    void* data;
+    u64 size;
+    u32 id;
+};
+
+struct Capture {
+    FILE* file;
+    u32 frames_left;
+    u32 frame_count;
+    u64 bytes;
+    bool warned_unknown_pipeline;
+
+    // the pipelines task creates modules and pipelines next to the main thread
+    pthread_mutex_t mutex;
+    CapturedShader* shaders;
+    u32 shader_count;
+    u32 shader_capacity;
+    CapturedPipeline* pipelines;
+    u32 pipeline_count;
+    u32 pipeline_capacity;
+    CapturedBuffer* buffers;
+    u32 buffer_count;
+    u32 buffer_capacity;
+    u32 next_shader_id;
+    u32 next_pipeline_id;
+    u32 next_buffer_id;
+
+    // the binning pipeline written last, written again when a reload changes its shader
+    VkShaderModule light_module;
+    u32 light_pipeline_id;
+};
+
+// the frame commands of the stream, by offset
+typedef struct ReplayFrame ReplayFrame;
+struct ReplayFrame {
+    u64 offset;
+    u64 size;
+};
+
+struct Replay {
+    u8* data; // the whole stream
+    u64 size;
+    CaptureHeader header;
+    ReplayFrame* frames;
+    u32 frame_count;
+    u32 current_frame; // what the next draw_frame records, it loops over the frames
+
+    // the objects of the stream, by id
+    VkShaderModule* shaders;
+    u32 shader_count;
+    VkPipeline* pipelines;
+    u32 pipeline_count;
+    VkBuffer* buffers;
+    VkDeviceMemory* buffer_memories;
+    u32 buffer_count;
+    VkPipeline* light_pipelines;
+    u32 light_pipeline_count;
+};
+
+// capture, from the engine
+void begin_capture(App* pApp);
+void end_capture(App* pApp);
+void capture_shader_module(App* pApp, VkShaderModule module, const void* code, u32 size);
+void capture_pipeline(App* pApp, VkPipeline pipeline, VkShaderModule vert_module, VkShaderModule frag_module,
+                      const VertexLayout* vertex_layout, DepthMode depth_mode, const ShaderConstants* constants);
+void capture_buffer(App* pApp, VkBuffer buffer, VkBufferUsageFlags usage, const void* data, u64 size);
+void capture_frame_begin(App* pApp);
+void capture_frame_end(App* pApp);
+void capture_light_binning(App* pApp);
+
+// the commands of the scene
+void cmd_bind_pipeline(App* pApp, VkCommandBuffer command_buffer, VkPipeline pipeline);
+void cmd_bind_vertex_buffer(App* pApp, VkCommandBuffer command_buffer, VkBuffer buffer, VkDeviceSize offset);
+void cmd_bind_index_buffer(App* pApp, VkCommandBuffer command_buffer, VkBuffer buffer, VkDeviceSize offset,
+                           VkIndexType index_type);
+void cmd_push_constants(App* pApp, VkCommandBuffer command_buffer, VkPipelineLayout layout, VkShaderStageFlags stages,
+                        u32 offset, u32 size, const void* values);
+void cmd_draw(App* pApp, VkCommandBuffer command_buffer, u32 vertex_count, u32 instance_count, u32 first_vertex,
+              u32 first_instance);
+void cmd_draw_indexed(App* pApp, VkCommandBuffer command_buffer, u32 index_count, u32 instance_count, u32 first_index,
+                      i32 vertex_offset, u32 first_instance);
+
+// replay
+Replay* read_replay(const char* filename);
+void create_replay_objects(App* pApp, Replay* replay);
+void record_replay_light_binning(App* pApp, VkCommandBuffer command_buffer);
+void record_replay_commands(App* pApp, VkCommandBuffer command_buffer);
+void destroy_replay(App* pApp, Replay* replay);
+
+#endif // CAPTURE_H
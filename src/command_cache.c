@@ -0,0 +1,183 @@
+#include "engine.h"
+#include "sprites.h"
+
+// which contents each bucket is recorded from. The prepass does not care about the prepass toggle, only the main
+// bucket switches between the normal and the EQUAL pipeline
+const u32 command_bucket_depends[COMMAND_BUCKET_COUNT] = {
+    [COMMAND_BUCKET_DEPTH_PREPASS] =
+        (1u << CACHE_CONTENT_SCENE) | (1u << CACHE_CONTENT_PIPELINES) | (1u << CACHE_CONTENT_TARGETS),
+    [COMMAND_BUCKET_MAIN] = (1u << CACHE_CONTENT_SCENE) | (1u << CACHE_CONTENT_PIPELINES) |
+                            (1u << CACHE_CONTENT_TARGETS) | (1u << CACHE_CONTENT_STATE),
+    [COMMAND_BUCKET_SPRITES] = (1u << CACHE_CONTENT_TARGETS) | (1u << CACHE_CONTENT_SPRITES),
+};
+
+const char* command_bucket_names[COMMAND_BUCKET_COUNT] = {
+    "depth_prepass",
+    "main",
+    "sprites",
+};
+
+void create_command_cache(App* pApp)
+{
+    CommandCache* cache = &pApp->command_cache;
+
+    for (u32 b = 0; b < COMMAND_BUCKET_COUNT; b += 1) {
+        CommandBucket* bucket = &cache->buckets[b];
+        bucket->depends = command_bucket_depends[b];
+
+        VkCommandBufferAllocateInfo alloc_info = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandPool = pApp->vk_command_pool,
+            .level = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+            .commandBufferCount = MAX_FRAMES_IN_FLIGHT,
+        };
+        if (vkAllocateCommandBuffers(pApp->vk_device, &alloc_info, bucket->command_buffers) != VK_SUCCESS) {
+            printf("Failed to allocate the secondary command buffers of the %s bucket!\n", command_bucket_names[b]);
+            exit(1);
+        }
+    }
+    add_memory_pressure_callback(pApp, trim_command_cache, NULL);
+    printf("Command cache created (%u buckets).\n", COMMAND_BUCKET_COUNT);
+}
+
+// Memory pressure: the buckets a frame slot does not execute (the prepass without the prepass, the sprites without
+// sprites) give their memory back to the pool. Not now, the GPU may still be reading them: each frame slot releases
+// its own at its next frame, see execute_cached_commands
+void trim_command_cache(App* pApp, u32 heap_index, MemoryPressure pressure, const MemoryStats* stats,
+                        void* user_data)
+{
+    UNUSED(heap_index);
+    UNUSED(stats);
+    UNUSED(user_data);
+    if (pressure != MEMORY_PRESSURE_LEVEL_NONE) {
+        pApp->command_cache.trim_frames = (1u << MAX_FRAMES_IN_FLIGHT) - 1;
+    }
+}
+
+// re-recorded from scratch if the bucket is needed again
+void release_bucket(CommandCache* cache, CommandBucketId id, u32 frame)
+{
+    CommandBucket* bucket = &cache->buckets[id];
+    if (!bucket->recorded[frame]) {
+        return;
+    }
+    vkResetCommandBuffer(bucket->command_buffers[frame], VK_COMMAND_BUFFER_RESET_RELEASE_RESOURCES_BIT);
+    bucket->recorded[frame] = false;
+    printf("Command cache: %s bucket of frame %u released\n", command_bucket_names[id], frame);
+}
+
+// For what the cache can not see on its own: the contents of a buffer, anything behind a pointer
+void invalidate_commands(App* pApp, CacheContent content)
+{
+    pApp->command_cache.versions[content] += 1;
+}
+
+// Bumps the versions of whatever changed in the App since the last frame. A few compares, cheap enough to do always
+void detect_command_changes(App* pApp)
+{
+    CommandCache* cache = &pApp->command_cache;
+
+    const DrawParams* draw = &pApp->draw;
+    if (cache->draw.vertex_count != draw->vertex_count || cache->draw.instance_count != draw->instance_count ||
+        cache->draw.draw_call_count != draw->draw_call_count || cache->draw.mesh != draw->mesh) {
+        cache->draw = pApp->draw;
+        invalidate_commands(pApp, CACHE_CONTENT_SCENE);
+    }
+    VkPipeline pipelines[3] = {pApp->vk_pipeline, pApp->vk_depth_prepass_pipeline, pApp->vk_equal_pipeline};
+    if (memcmp(cache->pipelines, pipelines, sizeof(pipelines)) != 0) {
+        memcpy(cache->pipelines, pipelines, sizeof(pipelines));
+        invalidate_commands(pApp, CACHE_CONTENT_PIPELINES);
+    }
+    if (cache->renderpass != pApp->vk_renderpass || cache->extent.width != pApp->vk_extent.width ||
+        cache->extent.height != pApp->vk_extent.height) {
+        cache->renderpass = pApp->vk_renderpass;
+        cache->extent = pApp->vk_extent;
+        invalidate_commands(pApp, CACHE_CONTENT_TARGETS);
+    }
+    if (cache->depth_prepass != pApp->depth_prepass) {
+        cache->depth_prepass = pApp->depth_prepass;
+        invalidate_commands(pApp, CACHE_CONTENT_STATE);
+    }
+}
+
+bool bucket_is_stale(const CommandCache* cache, const CommandBucket* bucket, u32 frame)
+{
+    if (!bucket->recorded[frame]) {
+        return true;
+    }
+    for (u32 c = 0; c < CACHE_CONTENT_COUNT; c += 1) {
+        if ((bucket->depends & (1u << c)) && bucket->recorded_versions[frame][c] != cache->versions[c]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// The secondary command buffer of the current frame slot is only re-recorded when stale. The GPU is done with it:
+// draw_frame waited for this frame before recording
+VkCommandBuffer get_bucket_commands(App* pApp, CommandBucketId id)
+{
+    CommandCache* cache = &pApp->command_cache;
+    CommandBucket* bucket = &cache->buckets[id];
+    u32 frame = pApp->current_frame;
+    VkCommandBuffer command_buffer = bucket->command_buffers[frame];
+
+    if (!bucket_is_stale(cache, bucket, frame)) {
+        return command_buffer;
+    }
+
+    // valid for any framebuffer of the render pass, so it does not depend on the swapchain image
+    VkCommandBufferInheritanceInfo inheritance_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+        .renderPass = pApp->vk_renderpass,
+        .subpass = 0,
+        .framebuffer = VK_NULL_HANDLE,
+    };
+    VkCommandBufferBeginInfo begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+        .pInheritanceInfo = &inheritance_info,
+    };
+    if (vkBeginCommandBuffer(command_buffer, &begin_info) != VK_SUCCESS) {
+        printf("Failed to begin recording the %s bucket!\n", command_bucket_names[id]);
+        exit(1);
+    }
+    record_bucket(pApp, command_buffer, id);
+    if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
+        printf("Failed to record the %s bucket!\n", command_bucket_names[id]);
+        exit(1);
+    }
+
+    bucket->recorded[frame] = true;
+    memcpy(bucket->recorded_versions[frame], cache->versions, sizeof(cache->versions));
+    cache->record_count += 1;
+    return command_buffer;
+}
+
+// Inside the render pass of the primary command buffer, begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+void execute_cached_commands(App* pApp, VkCommandBuffer command_buffer)
+{
+    detect_command_changes(pApp);
+
+    CommandCache* cache = &pApp->command_cache;
+    u32 frame = pApp->current_frame;
+    bool trim = (cache->trim_frames & (1u << frame)) != 0;
+    cache->trim_frames &= ~(1u << frame);
+
+    VkCommandBuffer secondaries[COMMAND_BUCKET_COUNT];
+    u32 secondary_count = 0;
+    if (pApp->depth_prepass) {
+        secondaries[secondary_count++] = get_bucket_commands(pApp, COMMAND_BUCKET_DEPTH_PREPASS);
+    } else if (trim) {
+        release_bucket(cache, COMMAND_BUCKET_DEPTH_PREPASS, frame);
+    }
+    secondaries[secondary_count++] = get_bucket_commands(pApp, COMMAND_BUCKET_MAIN);
+    if (has_sprites(pApp)) {
+        secondaries[secondary_count++] = get_bucket_commands(pApp, COMMAND_BUCKET_SPRITES);
+    } else if (trim) {
+        release_bucket(cache, COMMAND_BUCKET_SPRITES, frame);
+    }
+
+    vkCmdExecuteCommands(command_buffer, secondary_count, secondaries);
+    cache->execute_count += secondary_count;
+}
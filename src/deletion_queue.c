@@ -0,0 +1,115 @@
+#include "engine.h"
+
+void destroy_retired(App* pApp, const RetiredHandle* retired)
+{
+    VkDevice device = pApp->vk_device;
+    switch (retired->kind) {
+    case RETIRED_BUFFER:
+        vkDestroyBuffer(device, retired->object.buffer, NULL);
+        break;
+    case RETIRED_IMAGE:
+        vkDestroyImage(device, retired->object.image, NULL);
+        break;
+    case RETIRED_IMAGE_VIEW:
+        vkDestroyImageView(device, retired->object.image_view, NULL);
+        break;
+    case RETIRED_MEMORY:
+        free_memory(pApp, retired->object.memory);
+        break;
+    case RETIRED_PIPELINE:
+        vkDestroyPipeline(device, retired->object.pipeline, NULL);
+        break;
+    case RETIRED_SHADER_MODULE:
+        vkDestroyShaderModule(device, retired->object.shader_module, NULL);
+        break;
+    case RETIRED_FRAMEBUFFER:
+        vkDestroyFramebuffer(device, retired->object.framebuffer, NULL);
+        break;
+    }
+    pApp->deletion_queue.destroyed_count += 1;
+}
+
+// The handle is destroyed once the GPU has finished the submission that signals timeline_value
+void retire_handle(App* pApp, RetiredKind kind, RetiredObject object, u64 timeline_value)
+{
+    DeletionQueue* queue = &pApp->deletion_queue;
+    if (queue->count == queue->capacity) {
+        queue->capacity = queue->capacity > 0 ? queue->capacity * 2 : 64;
+        queue->handles = (RetiredHandle*)realloc(queue->handles, queue->capacity * sizeof(RetiredHandle));
+    }
+    queue->handles[queue->count++] = (RetiredHandle){
+        .kind = kind,
+        .object = object,
+        .timeline_value = timeline_value,
+    };
+    queue->retired_count += 1;
+}
+
+// The handles below were used up to now: by what is submitted and, if we are in the middle of a frame, by what is
+// being recorded. So they wait for the next submission too
+u64 retire_value(App* pApp) { return pApp->timeline_value + 1; }
+
+void retire_buffer(App* pApp, VkBuffer buffer)
+{
+    retire_handle(pApp, RETIRED_BUFFER, (RetiredObject){.buffer = buffer}, retire_value(pApp));
+}
+
+void retire_image(App* pApp, VkImage image)
+{
+    retire_handle(pApp, RETIRED_IMAGE, (RetiredObject){.image = image}, retire_value(pApp));
+}
+
+void retire_image_view(App* pApp, VkImageView image_view)
+{
+    retire_handle(pApp, RETIRED_IMAGE_VIEW, (RetiredObject){.image_view = image_view}, retire_value(pApp));
+}
+
+void retire_memory(App* pApp, VkDeviceMemory memory)
+{
+    retire_handle(pApp, RETIRED_MEMORY, (RetiredObject){.memory = memory}, retire_value(pApp));
+}
+
+void retire_pipeline(App* pApp, VkPipeline pipeline)
+{
+    retire_handle(pApp, RETIRED_PIPELINE, (RetiredObject){.pipeline = pipeline}, retire_value(pApp));
+}
+
+void retire_framebuffer(App* pApp, VkFramebuffer framebuffer)
+{
+    retire_handle(pApp, RETIRED_FRAMEBUFFER, (RetiredObject){.framebuffer = framebuffer}, retire_value(pApp));
+}
+
+// Destroys everything the GPU is done with, without waiting for anything. Called every frame by draw_frame
+void collect_retired(App* pApp)
+{
+    DeletionQueue* queue = &pApp->deletion_queue;
+    if (queue->count == 0) {
+        return;
+    }
+
+    u64 completed = get_completed_timeline_value(pApp);
+    u32 kept = 0;
+    for (u32 i = 0; i < queue->count; i += 1) {
+        if (queue->handles[i].timeline_value <= completed) {
+            destroy_retired(pApp, &queue->handles[i]);
+        } else {
+            queue->handles[kept++] = queue->handles[i];
+        }
+    }
+    queue->count = kept;
+}
+
+// Only once the device is idle: destroys all of it, done or not
+void destroy_deletion_queue(App* pApp)
+{
+    DeletionQueue* queue = &pApp->deletion_queue;
+    for (u32 i = 0; i < queue->count; i += 1) {
+        destroy_retired(pApp, &queue->handles[i]);
+    }
+    printf("Deletion queue destroyed (%llu handles retired, %llu destroyed).\n",
+           (unsigned long long)queue->retired_count, (unsigned long long)queue->destroyed_count);
+    free(queue->handles);
+    queue->handles = NULL;
+    queue->count = 0;
+    queue->capacity = 0;
+}
@@ -0,0 +1,2325 @@
+#include "engine.h"
+#include "mesh.h"
+#include "sprites.h"
+#include "capture.h"
+#include "post.h"
+#include "lighting.h"
+
+const char* WIN_TITLE = "Vulkan";
+const u32 WIN_WIDTH = 800;
+const u32 WIN_HEIGHT = 600;
+
+const u32 validation_layers_count = 1;
+const u32 device_extensions_count = 1;
+const char* validation_layers[] = {"VK_LAYER_KHRONOS_validation"};
+const char* device_extensions[] = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+
+#if NDEBUG
+const bool enable_validation_layers = false;
+#else
+const bool enable_validation_layers = true;
+#endif
+
+const char* init_stage_names[INIT_STAGE_COUNT] = {
+    "init_window",
+    "create_instance",
+    "setup_debug_messenger",
+    "create_surface",
+    "pick_graphics_card",
+    "create_logical_device",
+    "create_commandpool",
+    "create_renderpass",
+    "load_mesh",
+    "create_swapchain",
+    "create_imageviews",
+    "create_color_resources",
+    "create_depth_resources",
+    "create_framebuffers",
+    "create_commandbuffers",
+    "create_sync_objects",
+    "create_graphicspipeline",
+};
+
+// implementations
+void init_window(App* pApp)
+{
+    f64 t = now_ms();
+    glfwInit();
+    glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+    glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+
+    pApp->window = glfwCreateWindow(WIN_WIDTH, WIN_HEIGHT, WIN_TITLE, NULL, NULL);
+    glfwSetWindowUserPointer(pApp->window, pApp);
+    glfwSetKeyCallback(pApp->window, key_callback);
+    record_init_stage(pApp, INIT_STAGE_WINDOW, t);
+}
+
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+    UNUSED(scancode);
+    UNUSED(mods);
+    App* pApp = (App*)glfwGetWindowUserPointer(window);
+    if (key == GLFW_KEY_F5 && action == GLFW_PRESS) {
+        pApp->reload_requested = true;
+    }
+    if (key == GLFW_KEY_F6 && action == GLFW_PRESS) {
+        pApp->disable_lighting = !pApp->disable_lighting;
+        pApp->variants_requested = true;
+    }
+}
+
+void init_vulkan(App* pApp)
+{
+    // by default draw the hardcoded triangle once
+    if (pApp->draw.draw_call_count == 0) {
+        pApp->draw.vertex_count = 3;
+        pApp->draw.instance_count = 1;
+        pApp->draw.draw_call_count = 1;
+    }
+
+    // the file reads are already going if main started them before the window
+    start_init_tasks(pApp);
+    init_metrics(pApp);
+    // before the pipelines task and the mesh upload, the capture needs their objects
+    begin_capture(pApp);
+
+    f64 t = now_ms();
+    create_instance(pApp);
+    t = record_init_stage(pApp, INIT_STAGE_INSTANCE, t);
+    setup_debug_messenger(pApp);
+    t = record_init_stage(pApp, INIT_STAGE_DEBUG_MESSENGER, t);
+    if (!pApp->headless) {
+        create_surface(pApp);
+    }
+    t = record_init_stage(pApp, INIT_STAGE_SURFACE, t);
+    pick_graphics_card(pApp);
+    t = record_init_stage(pApp, INIT_STAGE_PICK_DEVICE, t);
+    create_logical_device(pApp);
+    t = record_init_stage(pApp, INIT_STAGE_LOGICAL_DEVICE, t);
+    // the pool comes early, uploads need it before there is anything to draw
+    create_commandpool(pApp);
+    t = record_init_stage(pApp, INIT_STAGE_COMMANDPOOL, t);
+
+    // The pipelines only need the formats of the attachments, not the attachments. With the render pass made from
+    // them first, the pipelines compile on their own thread while the swapchain and the rest are created here
+    choose_target_formats(pApp);
+    create_renderpass(pApp);
+    // the lights are set 0 of the pipeline layout
+    create_lighting(pApp);
+    create_pipeline_layout(pApp);
+    t = record_init_stage(pApp, INIT_STAGE_RENDERPASS, t);
+    start_init_task(pApp, INIT_TASK_PIPELINES, run_pipelines_task, 1u << INIT_TASK_SHADER_IO, INIT_STAGE_RENDERPASS);
+
+    if (pApp->mesh_filename != NULL) {
+        wait_init_task_in_stage(pApp, INIT_STAGE_LOAD_MESH, INIT_TASK_MESH_IO);
+        pApp->mesh = upload_mesh(pApp, pApp->mesh_file);
+        if (pApp->draw.mesh == NULL) {
+            pApp->draw.mesh = pApp->mesh;
+        }
+    }
+    t = record_init_stage(pApp, INIT_STAGE_LOAD_MESH, t);
+    if (pApp->headless) {
+        create_offscreen_targets(pApp);
+    } else {
+        create_swapchain(pApp);
+    }
+    t = record_init_stage(pApp, INIT_STAGE_SWAPCHAIN, t);
+    create_imageviews(pApp);
+    t = record_init_stage(pApp, INIT_STAGE_IMAGEVIEWS, t);
+    create_color_resources(pApp);
+    // the HDR target is what the framebuffers draw into
+    create_post_chain(pApp);
+    t = record_init_stage(pApp, INIT_STAGE_COLOR_RESOURCES, t);
+    create_depth_resources(pApp);
+    t = record_init_stage(pApp, INIT_STAGE_DEPTH_RESOURCES, t);
+    create_framebuffers(pApp);
+    t = record_init_stage(pApp, INIT_STAGE_FRAMEBUFFERS, t);
+    create_commandbuffers(pApp);
+    if (!pApp->disable_command_cache) {
+        create_command_cache(pApp);
+    }
+    t = record_init_stage(pApp, INIT_STAGE_COMMANDS, t);
+    create_sync_objects(pApp);
+    create_timestamp_queries(pApp);
+    t = record_init_stage(pApp, INIT_STAGE_SYNC_OBJECTS, t);
+
+    wait_init_task_in_stage(pApp, INIT_STAGE_GRAPHICSPIPELINE, INIT_TASK_PIPELINES);
+    // after the task, the shader variants are not shared between threads
+    add_memory_pressure_callback(pApp, trim_shader_variants, NULL);
+    create_lighting_pipeline(pApp);
+    if (pApp->post != NULL) {
+        create_post_pipelines(pApp);
+    }
+    record_init_stage(pApp, INIT_STAGE_GRAPHICSPIPELINE, t);
+    finish_init_tasks(pApp);
+
+    pApp->init_ms = now_ms() - pApp->init_start_ms;
+    pApp->init_critical_path_ms = compute_init_critical_path(pApp);
+    for (u32 i = 0; i < INIT_TASK_COUNT; i += 1) {
+        const InitTask* task = &pApp->init_tasks[i];
+        printf("\tInit task %s: %.2f ms (from %.2f to %.2f ms)\n", init_task_names[i], task->end_ms - task->start_ms,
+               task->start_ms, task->end_ms);
+    }
+    printf("Initialized in %.2f ms, the longest dependency chain is %.2f ms\n", pApp->init_ms,
+           pApp->init_critical_path_ms);
+
+    print_memory_stats(&pApp->memory.stats);
+}
+void main_loop(App* pApp)
+{
+    f64 last_ms = now_ms();
+    while (!glfwWindowShouldClose(pApp->window)) {
+        glfwPollEvents();
+        if (pApp->reload_requested) {
+            pApp->reload_requested = false;
+            reload_pipelines(pApp);
+        }
+        if (pApp->variants_requested) {
+            pApp->variants_requested = false;
+            select_scene_pipelines(pApp);
+        }
+        draw_frame(pApp);
+
+        // the frame is the whole iteration, events and reloads included. What it did not spend waiting is the CPU
+        f64 t = now_ms();
+        f64 frame_ms = t - last_ms;
+        last_ms = t;
+        Metrics* metrics = &pApp->metrics;
+        record_metric_ms(metrics, METRIC_FRAME_TIME, frame_ms);
+        record_metric_ms(metrics, METRIC_CPU_FRAME_TIME, frame_ms - pApp->frame_wait_ms - pApp->frame_present_ms);
+        record_metric_ms(metrics, METRIC_FENCE_WAIT, pApp->frame_wait_ms - pApp->frame_acquire_ms);
+        if (!pApp->headless) {
+            record_metric_ms(metrics, METRIC_ACQUIRE_WAIT, pApp->frame_acquire_ms);
+            record_metric_ms(metrics, METRIC_PRESENT, pApp->frame_present_ms);
+        }
+        count_metric(metrics, COUNTER_FRAMES);
+    }
+
+    // wait for the last frames before destroying everything
+    vkDeviceWaitIdle(pApp->vk_device);
+}
+void cleanup(App* pApp)
+{
+    printf("Cleaning...\n");
+
+    // the exporter thread reads the App
+    destroy_metrics(pApp);
+
+    // a capture that got fewer frames than it asked for
+    end_capture(pApp);
+
+    // the frames are done (main_loop waited), everything retired can go now
+    destroy_deletion_queue(pApp);
+
+    for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; i += 1) {
+        vkDestroySemaphore(pApp->vk_device, pApp->vk_image_available_semaphores[i], NULL);
+        vkDestroyFence(pApp->vk_device, pApp->vk_in_flight_fences[i], NULL);
+    }
+    vkDestroySemaphore(pApp->vk_device, pApp->vk_timeline_semaphore, NULL);
+    vkDestroyQueryPool(pApp->vk_device, pApp->vk_timestamp_pool, NULL);
+    for (u32 i = 0; i < pApp->vk_image_count; i += 1) {
+        vkDestroySemaphore(pApp->vk_device, pApp->vk_render_finished_semaphores[i], NULL);
+    }
+    free(pApp->vk_render_finished_semaphores);
+    printf("Sync objects destroyed.\n");
+
+    vkDestroyCommandPool(pApp->vk_device, pApp->vk_command_pool, NULL);
+    printf("Command pool destroyed.\n");
+
+    for (u32 i = 0; i < pApp->vk_image_count; i += 1) {
+        vkDestroyFramebuffer(pApp->vk_device, pApp->vk_framebuffers[i], NULL);
+    }
+    free(pApp->vk_framebuffers);
+    printf("Framebuffers destroyed.\n");
+
+    // the scene pipelines are variants, owned there
+    destroy_shader_variants(pApp);
+    printf("Pipelines destroyed.\n");
+    vkDestroyPipelineLayout(pApp->vk_device, pApp->vk_pipeline_layout, NULL);
+    printf("Pipeline layout destoyed.\n");
+    destroy_lighting(pApp);
+    printf("Lighting destroyed.\n");
+    vkDestroyRenderPass(pApp->vk_device, pApp->vk_renderpass, NULL);
+    printf("Render pass destroyed.\n");
+
+    if (pApp->mesh != NULL) {
+        destroy_mesh(pApp, pApp->mesh);
+        printf("Mesh destroyed.\n");
+    }
+
+    if (pApp->sprites != NULL) {
+        destroy_sprite_renderer(pApp);
+        printf("Sprite renderer destroyed.\n");
+    }
+
+    if (pApp->post != NULL) {
+        destroy_post_chain(pApp);
+        printf("Post processing chain destroyed.\n");
+    }
+
+    vkDestroyImageView(pApp->vk_device, pApp->vk_depth_imageview, NULL);
+    vkDestroyImage(pApp->vk_device, pApp->vk_depth_image, NULL);
+    free_memory(pApp, pApp->vk_depth_memory);
+    printf("Depth buffer destroyed.\n");
+
+    if (pApp->vk_color_image != VK_NULL_HANDLE) {
+        vkDestroyImageView(pApp->vk_device, pApp->vk_color_imageview, NULL);
+        vkDestroyImage(pApp->vk_device, pApp->vk_color_image, NULL);
+        free_memory(pApp, pApp->vk_color_memory);
+        printf("MSAA color target destroyed.\n");
+    }
+
+    for (u32 i = 0; i < pApp->vk_image_count; i += 1) {
+        vkDestroyImageView(pApp->vk_device, pApp->vk_imageviews[i], NULL);
+    }
+    printf("Image views destroyed...\n");
+    free(pApp->vk_imageviews);
+    printf("Freeing vk_imageview...\n");
+    if (pApp->headless) {
+        // the offscreen images are ours, not the swapchain ones
+        for (u32 i = 0; i < pApp->vk_image_count; i += 1) {
+            vkDestroyImage(pApp->vk_device, pApp->vk_images[i], NULL);
+            free_memory(pApp, pApp->vk_offscreen_memories[i]);
+        }
+        free(pApp->vk_offscreen_memories);
+        printf("Offscreen images destroyed.\n");
+    }
+    free(pApp->vk_images);
+    printf("Freeing vk_images...\n");
+    if (!pApp->headless) {
+        vkDestroySwapchainKHR(pApp->vk_device, pApp->vk_swapchain, NULL);
+        printf("Swapchain destoyed.\n");
+    }
+
+    destroy_memory_tracker(pApp);
+    vkDestroyDevice(pApp->vk_device, NULL);
+    printf("Logical Device destroyed.\n");
+
+    if (enable_validation_layers) {
+        DestroyDebugUtilsMessengerEXT(pApp->vk_instance, pApp->vk_debugmessenger, NULL);
+        printf("Debug messenger destroyed.\n");
+    }
+
+    if (!pApp->headless) {
+        vkDestroySurfaceKHR(pApp->vk_instance, pApp->vk_surface, NULL);
+        printf("Vulkan surface destroyed.\n");
+    }
+    vkDestroyInstance(pApp->vk_instance, NULL);
+    printf("Vulkan instance destroyed.\n");
+
+    if (!pApp->headless) {
+        glfwDestroyWindow(pApp->window);
+        glfwTerminate();
+        printf("Destroying GLFW window and terminating.\n");
+    }
+}
+
+f64 now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (f64)ts.tv_sec * 1000.0 + (f64)ts.tv_nsec / 1000000.0;
+}
+
+// for qsort of the frame time samples of bench and replay
+int compare_f64(const void* a, const void* b)
+{
+    f64 x = *(const f64*)a;
+    f64 y = *(const f64*)b;
+    return (x > y) - (x < y);
+}
+
+// nearest rank percentile of already sorted samples
+f64 percentile(const f64* sorted, u32 count, f64 p)
+{
+    if (count == 0) {
+        return 0.0;
+    }
+    f64 exact_rank = p / 100.0 * (f64)count;
+    u32 rank = (u32)exact_rank;
+    if ((f64)rank < exact_rank) {
+        rank += 1;
+    }
+    if (rank == 0) {
+        rank = 1;
+    }
+    return sorted[rank - 1];
+}
+
+// stores how long the stage took and returns the start time of the next one
+f64 record_init_stage(App* pApp, InitStage stage, f64 start_ms)
+{
+    f64 end_ms = now_ms();
+    pApp->init_stage_ms[stage] = end_ms - start_ms;
+    return end_ms;
+}
+
+void create_instance(App* pApp)
+{
+    // Vulkan 1.3 when the loader has it. Whether the device can take the newer path is up to pick_graphics_card
+    pApp->vk_api_version = VK_API_VERSION_1_0;
+    PFN_vkEnumerateInstanceVersion enumerate_instance_version =
+        (PFN_vkEnumerateInstanceVersion)vkGetInstanceProcAddr(NULL, "vkEnumerateInstanceVersion");
+    u32 loader_version = 0;
+    if (!pApp->force_vulkan_1_0 && enumerate_instance_version != NULL &&
+        enumerate_instance_version(&loader_version) == VK_SUCCESS && loader_version >= VK_API_VERSION_1_3) {
+        pApp->vk_api_version = VK_API_VERSION_1_3;
+    }
+    printf("Instance API version %u.%u\n", VK_API_VERSION_MAJOR(pApp->vk_api_version),
+           VK_API_VERSION_MINOR(pApp->vk_api_version));
+    // vkGetPhysicalDeviceMemoryProperties2 is core since 1.1
+    pApp->memory.has_properties2 = pApp->vk_api_version >= VK_API_VERSION_1_1;
+
+    VkApplicationInfo app_info = {
+        .sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
+        .pApplicationName = "Hello Triangle",
+        .applicationVersion = VK_MAKE_VERSION(1, 0, 0),
+        .pEngineName = "No Engine",
+        .engineVersion = VK_MAKE_VERSION(1, 0, 0),
+        .apiVersion = pApp->vk_api_version,
+        .pNext = NULL,
+    };
+
+    // check all available instance extensions
+    u32 all_extension_count = 0;
+    vkEnumerateInstanceExtensionProperties(NULL, &all_extension_count, NULL);
+    VkExtensionProperties all_extensions[all_extension_count];
+    vkEnumerateInstanceExtensionProperties(NULL, &all_extension_count, all_extensions);
+    // Enumerate all instance extensions
+    // for (u32 i = 0; i < all_extension_count; i += 1) {
+    //     printf("\tExtension: %s\n", all_extensions[i].extensionName);
+    // }
+
+    // get required extensions from glfw (window stuff related, surface)
+    // headless there is no glfw at all, so no surface extensions either
+    u32 glfw_extension_count = 0;
+    const char** glfw_extensions = NULL;
+    if (!pApp->headless) {
+        glfw_extensions = glfwGetRequiredInstanceExtensions(&glfw_extension_count);
+    }
+    u32 required_glfw_extension_count = glfw_extension_count;
+
+    // add the debug util extension
+    if (enable_validation_layers) {
+        glfw_extension_count += 1;
+    }
+    printf("glfw_extension_count: %u\n", glfw_extension_count);
+
+    const char* extensions[glfw_extension_count + 2];
+    for (u32 i = 0; i < required_glfw_extension_count; i += 1) {
+        extensions[i] = glfw_extensions[i];
+    }
+
+    if (enable_validation_layers) {
+        extensions[glfw_extension_count - 1] = "VK_EXT_debug_utils";
+    }
+
+    // check that the required extensions are in the available
+    u32 found_extensions = 0;
+    for (u32 i = 0; i < glfw_extension_count; i += 1) {
+        for (u32 j = 0; j < all_extension_count; j += 1) {
+            if (strcmp(all_extensions[j].extensionName, extensions[i]) == 0) {
+                printf("%s vs %s\n", all_extensions[j].extensionName, extensions[i]);
+                found_extensions += 1;
+            }
+        }
+    }
+    if (found_extensions == glfw_extension_count) {
+        printf("All required extensions found!\n");
+    } else {
+        printf("Extension failed\n");
+    }
+
+    // optional: the memory budget query goes through vkGetPhysicalDeviceMemoryProperties2
+    u32 extension_count = glfw_extension_count;
+    for (u32 j = 0; j < all_extension_count; j += 1) {
+        if (strcmp(all_extensions[j].extensionName, VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) == 0) {
+            extensions[extension_count++] = VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME;
+            pApp->memory.has_properties2 = true;
+            break;
+        }
+    }
+
+    // check for layer support
+    u32 available_layer_count = 0;
+    vkEnumerateInstanceLayerProperties(&available_layer_count, NULL);
+    VkLayerProperties available_layers[available_layer_count];
+    vkEnumerateInstanceLayerProperties(&available_layer_count, available_layers);
+    u32 found_validation_layers = 0;
+    for (u32 i = 0; i < validation_layers_count; i += 1) {
+        for (u32 j = 0; j < available_layer_count; j += 1) {
+            if (strcmp(available_layers[j].layerName, validation_layers[i]) == 0) {
+                printf("%s vs %s\n", available_layers[j].layerName, validation_layers[i]);
+                found_validation_layers += 1;
+            }
+        }
+    }
+    if (found_validation_layers == validation_layers_count) {
+        printf("All required validation layers found!\n");
+    }
+
+    // create info
+    VkInstanceCreateInfo create_info = {
+        .sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
+        .pApplicationInfo = &app_info,
+        .enabledExtensionCount = extension_count,
+        .ppEnabledExtensionNames = extensions,
+    };
+
+    VkDebugUtilsMessengerCreateInfoEXT debug_create_info = {0};
+
+    if (enable_validation_layers) {
+        create_info.enabledLayerCount = validation_layers_count;
+        create_info.ppEnabledLayerNames = validation_layers;
+
+        populateDebugMessengerCreateInfo(&debug_create_info);
+        create_info.pNext = (VkDebugUtilsMessengerCreateInfoEXT*)(&debug_create_info);
+
+    } else {
+        create_info.enabledLayerCount = 0;
+        create_info.pNext = NULL;
+    }
+
+    if (vkCreateInstance(&create_info, NULL, &pApp->vk_instance) != VK_SUCCESS) {
+        printf("Failed to create Instance\n");
+        exit(1);
+    }
+
+    printf("Vulkan instance created succesfully.\n");
+}
+
+// DEBUG MESSENGER
+// TODO: move to source file
+VkResult CreateDebugUtilsMessengerEXT(VkInstance instance, const VkDebugUtilsMessengerCreateInfoEXT* pCreateInfo,
+                                      const VkAllocationCallbacks* pAllocator,
+                                      VkDebugUtilsMessengerEXT* pDebugMessenger)
+{
+    PFN_vkCreateDebugUtilsMessengerEXT func =
+        (PFN_vkCreateDebugUtilsMessengerEXT)vkGetInstanceProcAddr(instance, "vkCreateDebugUtilsMessengerEXT");
+    if (func != NULL) {
+        return func(instance, pCreateInfo, pAllocator, pDebugMessenger);
+    } else {
+        return VK_ERROR_EXTENSION_NOT_PRESENT;
+    }
+}
+
+void DestroyDebugUtilsMessengerEXT(VkInstance instance, VkDebugUtilsMessengerEXT debugMessenger,
+                                   const VkAllocationCallbacks* pAllocator)
+{
+    PFN_vkDestroyDebugUtilsMessengerEXT func =
+        (PFN_vkDestroyDebugUtilsMessengerEXT)vkGetInstanceProcAddr(instance, "vkDestroyDebugUtilsMessengerEXT");
+    if (func != NULL) {
+        func(instance, debugMessenger, pAllocator);
+    }
+}
+
+VKAPI_ATTR VkBool32 VKAPI_CALL debug_callback(VkDebugUtilsMessageSeverityFlagBitsEXT message_severity,
+                                              VkDebugUtilsMessageTypeFlagsEXT message_type,
+                                              const VkDebugUtilsMessengerCallbackDataEXT* pcallback_data,
+                                              void* puser_data)
+{
+    UNUSED(message_severity);
+    UNUSED(message_type);
+    UNUSED(puser_data);
+    printf("[DEBUG MESSENGER]: Validation layer: %s\n", pcallback_data->pMessage);
+    return VK_FALSE;
+}
+
+void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT* create_info)
+{
+    create_info->sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
+    create_info->messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT |
+                                   VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT |
+                                   VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+    create_info->messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT |
+                               VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT |
+                               VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
+    create_info->pfnUserCallback = debug_callback;
+    create_info->pUserData = NULL;
+}
+
+void setup_debug_messenger(App* pApp)
+{
+    if (!enable_validation_layers) {
+        return;
+    }
+
+    VkDebugUtilsMessengerCreateInfoEXT create_info = {0};
+    populateDebugMessengerCreateInfo(&create_info);
+
+    if (CreateDebugUtilsMessengerEXT(pApp->vk_instance, &create_info, NULL, &pApp->vk_debugmessenger) != VK_SUCCESS) {
+        printf("Failed to setup debug messenger!\n");
+        exit(1);
+    }
+
+    printf("Debug messenger set up.\n");
+}
+
+void create_surface(App* pApp)
+{
+    if (glfwCreateWindowSurface(pApp->vk_instance, pApp->window, NULL, &pApp->vk_surface) != VK_SUCCESS) {
+        printf("Could not create a surface\n");
+        exit(1);
+    }
+    printf("Created surface.\n");
+}
+
+// The Vulkan 1.2+ path needs 1.2 on both the instance and the device, and the timelineSemaphore feature
+bool check_timeline_support(App* pApp)
+{
+    if (pApp->vk_api_version < VK_API_VERSION_1_2) {
+        return false;
+    }
+    VkPhysicalDeviceProperties device_properties;
+    vkGetPhysicalDeviceProperties(pApp->vk_physical_device, &device_properties);
+    if (device_properties.apiVersion < VK_API_VERSION_1_2) {
+        return false;
+    }
+
+    PFN_vkGetPhysicalDeviceFeatures2 get_features2 =
+        (PFN_vkGetPhysicalDeviceFeatures2)vkGetInstanceProcAddr(pApp->vk_instance, "vkGetPhysicalDeviceFeatures2");
+    if (get_features2 == NULL) {
+        return false;
+    }
+    VkPhysicalDeviceVulkan12Features vulkan12_features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+    };
+    VkPhysicalDeviceFeatures2 features2 = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .pNext = &vulkan12_features,
+    };
+    get_features2(pApp->vk_physical_device, &features2);
+    return vulkan12_features.timelineSemaphore == VK_TRUE;
+}
+
+u32 rate_device_suitability(VkPhysicalDevice device)
+{
+    // get the properties of the device (to get the names, etc...)
+    VkPhysicalDeviceProperties device_properties;
+    vkGetPhysicalDeviceProperties(device, &device_properties);
+
+    // get the features of the device (to get the names, etc...)
+    VkPhysicalDeviceFeatures device_features;
+    vkGetPhysicalDeviceFeatures(device, &device_features);
+
+    u32 score = 0;
+    if (device_properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU) {
+        score += 1000;
+    }
+
+    // maximum size of textures affects graphics quality
+    score += device_properties.limits.maxImageDimension2D;
+
+    // app cannot function without geometry shaders
+    if (!device_features.geometryShader) {
+        return 0;
+    }
+
+    return score;
+}
+
+void pick_graphics_card(App* pApp)
+{
+
+    u32 physical_device_count = 0;
+    vkEnumeratePhysicalDevices(pApp->vk_instance, &physical_device_count, NULL);
+    if (physical_device_count == 0) {
+        printf("There are no devices available!");
+        exit(1);
+    }
+    printf("Physical devices count: %u\n", physical_device_count);
+
+    // get the physical devices
+    VkPhysicalDevice physical_devices[physical_device_count];
+    vkEnumeratePhysicalDevices(pApp->vk_instance, &physical_device_count, physical_devices);
+
+    VkPhysicalDevice chosen_physical_device = VK_NULL_HANDLE;
+    u32 physical_device_score = 0;
+    for (u32 i = 0; i < physical_device_count; i += 1) {
+        u32 score = rate_device_suitability(physical_devices[i]);
+        if (score > physical_device_score) {
+            physical_device_score = score;
+            chosen_physical_device = physical_devices[i];
+        }
+    }
+    pApp->vk_physical_device = chosen_physical_device;
+    if (pApp->vk_physical_device == VK_NULL_HANDLE) {
+        printf("Could not find any suitable device!\n");
+        exit(1);
+    }
+
+    VkPhysicalDeviceProperties device_properties;
+    vkGetPhysicalDeviceProperties(pApp->vk_physical_device, &device_properties);
+    printf("Selected Physical Device: %s (with score %u)\n", device_properties.deviceName, physical_device_score);
+
+    pApp->vk_msaa_samples = choose_msaa_samples(pApp);
+    printf("Using %u samples per pixel.\n", pApp->vk_msaa_samples);
+
+    pApp->timeline_semaphores = check_timeline_support(pApp);
+    printf("Synchronization: %s\n", pApp->timeline_semaphores ? "timeline semaphore" : "fences (Vulkan 1.0)");
+
+    // check queue families and look for the graphics bit (for now)
+    printf("Checking queue families...\n");
+    QueueFamilyIndices queue_family_index = find_families_queue(pApp->vk_physical_device, pApp->vk_surface);
+    if (!queue_family_index.is_graphics_family_set) {
+        printf("Graphics Family not supported!\n");
+        exit(1);
+    }
+
+    // set the queue family index
+    printf("Setting the queue family index...,\n");
+    pApp->vk_queue_family_indices = queue_family_index;
+
+    // falls back to drawing straight into the swapchain when the device cannot run the compute chain
+    if (pApp->post_processing) {
+        pApp->post_processing = check_post_support(pApp);
+    }
+
+    // check for swapchain capability
+    u32 device_available_extensions_count;
+    vkEnumerateDeviceExtensionProperties(pApp->vk_physical_device, NULL, &device_available_extensions_count, NULL);
+    VkExtensionProperties device_available_extensions[device_available_extensions_count];
+    vkEnumerateDeviceExtensionProperties(pApp->vk_physical_device, NULL, &device_available_extensions_count,
+                                         device_available_extensions);
+
+    // headless we never present, so the swapchain extension is not needed
+    u32 required_device_extensions_count = pApp->headless ? 0 : device_extensions_count;
+    u32 found_device_extensions = 0;
+    for (u32 i = 0; i < required_device_extensions_count; i += 1) {
+        for (u32 j = 0; j < device_available_extensions_count; j += 1) {
+            // printf("%s vs %s\n", device_extensions[i], device_available_extensions[j].extensionName);
+            if (strcmp(device_extensions[i], device_available_extensions[j].extensionName) == 0) {
+                printf("Found extension %s\n", device_extensions[i]);
+                found_device_extensions += 1;
+                break;
+            }
+        }
+    }
+    if (found_device_extensions != required_device_extensions_count) {
+        printf("Not all devices extensions are supported!\n");
+        exit(0);
+    }
+    printf("All required device extensions are supported!\n");
+
+    // optional ones
+    for (u32 j = 0; j < device_available_extensions_count; j += 1) {
+        if (strcmp(device_available_extensions[j].extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0) {
+            pApp->memory.budget_supported = pApp->memory.has_properties2;
+        }
+    }
+    init_memory_tracker(pApp);
+}
+
+// A helper function
+void print_queue_family_to_string(u32 queue_family)
+{
+    const char* QueueFlagNames[] = {
+        "VK_QUEUE_GRAPHICS_BIT",        "VK_QUEUE_COMPUTE_BIT",   "VK_QUEUE_TRANSFER",
+        "VK_QUEUE_SPARSE_BINDING_BIT",  "VK_QUEUE_PROTECTED_BIT", "VK_QUEUE_VIDEO_DECODE_BIT_KHR",
+        "VK_QUEUE_OPTICAL_FLOW_BIT_NV",
+    };
+    uint32_t QueueFlagMasks[] = {
+        0x00000001, 0x00000002, 0x00000004, 0x00000008, 0x00000010, 0x00000020, 0x00000040, 0x00000100,
+    };
+    uint32_t number_of_flags = sizeof(QueueFlagNames) / sizeof(QueueFlagNames[0]);
+
+    printf("Queue Family %u (binary 0x%08b) has the flags: ", queue_family, queue_family);
+    for (uint32_t i = 0; i < number_of_flags; i += 1) {
+        if (queue_family & QueueFlagMasks[i]) {
+            printf("%s, ", QueueFlagNames[i]);
+        }
+    }
+    printf("\n");
+}
+
+QueueFamilyIndices find_families_queue(VkPhysicalDevice device, VkSurfaceKHR surface)
+{
+    QueueFamilyIndices indices;
+    indices.is_graphics_family_set = 0;
+    indices.is_present_family_set = 0;
+    VkBool32 present_support = false;
+
+    u32 queue_family_count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &queue_family_count, NULL);
+
+    VkQueueFamilyProperties queue_family_properties[queue_family_count];
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &queue_family_count, queue_family_properties);
+
+    indices.is_graphics_family_set = 0;
+
+    for (u32 i = 0; i < queue_family_count; i += 1) {
+        u32 queue_family = queue_family_properties[i].queueFlags;
+        print_queue_family_to_string(queue_family);
+    }
+    // set the correct flag for the graphics family queue
+    for (u32 i = 0; i < queue_family_count; i += 1) {
+        if (!indices.is_graphics_family_set) {
+            if (queue_family_properties[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+                printf("Family %u has the Graphics Bit\n", queue_family_properties[i].queueFlags);
+                indices.graphics_family = i;
+                indices.is_graphics_family_set = 1;
+            }
+        }
+
+        if (!indices.is_present_family_set && surface != VK_NULL_HANDLE) {
+            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &present_support);
+            if (present_support) {
+                printf("Family %u has Present support\n", queue_family_properties[i].queueFlags);
+                indices.present_family = i;
+                indices.is_present_family_set = 1;
+            }
+        }
+    }
+    printf("\n");
+
+    // without a surface (headless) nothing is presented, the graphics queue does it all
+    if (surface == VK_NULL_HANDLE && indices.is_graphics_family_set) {
+        indices.present_family = indices.graphics_family;
+        indices.is_present_family_set = 1;
+    }
+
+    return indices;
+}
+
+// Comparison function for qsort
+int compare_u32(const void* a, const void* b) { return (*(u32*)a - *(u32*)b); }
+void get_unique_values(u32* array, u32 n, u32* unique_array, u32* unique_values_count)
+{
+    // sort the array in increaing order
+    qsort(array, n, sizeof(u32), compare_u32);
+    // Find the number of unique values
+
+    if (unique_array == NULL) {
+        *unique_values_count = 1; // at least we have one, the first element
+        for (u32 i = 1; i < n; i++) {
+            if (array[i] != array[i - 1]) {
+                *unique_values_count += 1;
+            }
+        }
+        return;
+    }
+
+    u32 count = 0;
+    unique_array[0] = array[0]; // at least the first array
+    for (u32 i = 1; i < *unique_values_count; i++) {
+        if (array[i] != array[i - 1]) {
+            unique_array[count++] = array[i];
+        }
+    }
+    return;
+}
+
+void create_logical_device(App* pApp)
+{
+    // queue info
+    float queue_priority = 1.0;
+    u32 all_queue_families[] = {pApp->vk_queue_family_indices.graphics_family,
+                                pApp->vk_queue_family_indices.present_family};
+    u32 all_queue_family_count = sizeof(all_queue_families) / sizeof(all_queue_families[0]); // 2
+    u32 unique_queue_families_count;
+    get_unique_values(all_queue_families, all_queue_family_count, NULL, &unique_queue_families_count);
+    u32 unique_queue_families[unique_queue_families_count];
+    get_unique_values(all_queue_families, all_queue_family_count, unique_queue_families, &unique_queue_families_count);
+    printf("There are %u unique families.\n", unique_queue_families_count);
+
+    VkDeviceQueueCreateInfo queue_create_infos[unique_queue_families_count];
+
+    for (u32 i = 0; i < unique_queue_families_count; i += 1) {
+        VkDeviceQueueCreateInfo queue_create_info = {
+            .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+            .queueFamilyIndex = unique_queue_families[i],
+            .queueCount = 1,
+            .pQueuePriorities = &queue_priority,
+        };
+
+        queue_create_infos[i] = queue_create_info;
+    }
+
+    VkPhysicalDeviceFeatures device_features = {0};
+    // the tonemap writes the swapchain images as storage images of whatever format they have
+    device_features.shaderStorageImageWriteWithoutFormat = pApp->post_processing;
+    VkPhysicalDeviceVulkan12Features vulkan12_features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+        .timelineSemaphore = VK_TRUE,
+    };
+
+    // the required ones (none headless) and the optional ones pick_graphics_card found
+    const char* extensions[device_extensions_count + 1];
+    u32 extension_count = 0;
+    for (u32 i = 0; i < (pApp->headless ? 0 : device_extensions_count); i += 1) {
+        extensions[extension_count++] = device_extensions[i];
+    }
+    if (pApp->memory.budget_supported) {
+        extensions[extension_count++] = VK_EXT_MEMORY_BUDGET_EXTENSION_NAME;
+    }
+
+    VkDeviceCreateInfo device_info = {
+        .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+        .pQueueCreateInfos = queue_create_infos,
+        .queueCreateInfoCount = unique_queue_families_count,
+        .pEnabledFeatures = &device_features,
+        .ppEnabledExtensionNames = extensions,
+        .enabledExtensionCount = extension_count,
+        .pNext = pApp->timeline_semaphores ? &vulkan12_features : NULL,
+    };
+
+    // Device specific layers are not needed anymore in newer versions of Vulkan. Just keep it for backwards
+    // compatibilty
+    if (enable_validation_layers) {
+        device_info.enabledLayerCount = validation_layers_count;
+        device_info.ppEnabledLayerNames = validation_layers;
+    } else {
+        device_info.enabledLayerCount = 0;
+    }
+
+    // create the logical device
+    if (vkCreateDevice(pApp->vk_physical_device, &device_info, NULL, &pApp->vk_device) != VK_SUCCESS) {
+        printf("Could not create logical device!\n");
+        exit(1);
+    }
+
+    // get the graphics family queue and store the handle (we will need it)
+    vkGetDeviceQueue(pApp->vk_device, pApp->vk_queue_family_indices.graphics_family, 0, &pApp->vk_graphics_queue);
+
+    // get the present family queue and store the handle
+    vkGetDeviceQueue(pApp->vk_device, pApp->vk_queue_family_indices.present_family, 0, &pApp->vk_present_queue);
+
+    // core 1.2 functions, through the device so a 1.0 loader still links
+    if (pApp->timeline_semaphores) {
+        pApp->vk_wait_semaphores = (PFN_vkWaitSemaphores)vkGetDeviceProcAddr(pApp->vk_device, "vkWaitSemaphores");
+        pApp->vk_get_semaphore_counter_value =
+            (PFN_vkGetSemaphoreCounterValue)vkGetDeviceProcAddr(pApp->vk_device, "vkGetSemaphoreCounterValue");
+    }
+
+    printf("Created logical device!\n");
+}
+
+// The format of the swapchain images, B8G8R8A8_SRGB when the surface has it. The render pass is made from it before
+// the swapchain exists. With the post chain B8G8R8A8_UNORM: the tonemap encodes to sRGB itself, and UNORM formats are
+// far more often storage images than SRGB ones
+VkSurfaceFormatKHR choose_surface_format(App* pApp)
+{
+    // 2. Surface formats (pixel format, color space)
+    u32 format_count;
+    vkGetPhysicalDeviceSurfaceFormatsKHR(pApp->vk_physical_device, pApp->vk_surface, &format_count, NULL);
+    if (format_count == 0) {
+        printf("\tNot enough formats (0) available\n");
+        exit(1);
+    }
+    printf("\tThere are %u available formats: ", format_count);
+    VkSurfaceFormatKHR surface_formats[format_count];
+    vkGetPhysicalDeviceSurfaceFormatsKHR(pApp->vk_physical_device, pApp->vk_surface, &format_count, surface_formats);
+    for (u32 i = 0; i < format_count; i += 1) {
+        printf("%u ", surface_formats[i].format); // VK_FORMAT_B8G8R8A8_UNORM and VK_FORMAT_B8G8R8A8_SRGB
+    }
+    printf("\n");
+
+    // Select the format
+    VkFormat wanted_format = pApp->post_processing ? VK_FORMAT_B8G8R8A8_UNORM : VK_FORMAT_B8G8R8A8_SRGB;
+    i32 chosen_format = -1;
+    for (u32 i = 0; i < format_count; i += 1) {
+        if (surface_formats[i].format == wanted_format &&
+            surface_formats[i].colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR) {
+            chosen_format = i;
+            printf("\tFound requirements. Chosing the format %u and colorspace %u\n",
+                   surface_formats[chosen_format].format, surface_formats[chosen_format].colorSpace);
+        }
+    }
+    if (chosen_format == -1) {
+        chosen_format = 0;
+        printf("\tThere are not the required format and colorspace. Chosing the first available one\n");
+        printf("\t\tChosing the format %u and colorspace %u\n", surface_formats[chosen_format].format,
+               surface_formats[chosen_format].colorSpace);
+    }
+    return surface_formats[chosen_format];
+}
+
+void create_swapchain(App* pApp)
+{
+    // *** CHECK SWAPCHAIN DETAILS
+    printf("Creating the swapchain\n");
+    VkSurfaceFormatKHR surface_format = choose_surface_format(pApp);
+
+    // 3. Available presentation modes
+    u32 present_modes_count;
+    vkGetPhysicalDeviceSurfacePresentModesKHR(pApp->vk_physical_device, pApp->vk_surface, &present_modes_count, NULL);
+    if (present_modes_count == 0) {
+        printf("\tNot enough present_modes (0) available\n");
+        exit(1);
+    }
+    VkPresentModeKHR present_modes[present_modes_count];
+    vkGetPhysicalDeviceSurfacePresentModesKHR(pApp->vk_physical_device, pApp->vk_surface, &present_modes_count,
+                                              present_modes);
+    printf("\tThere are %u presentation modes: ", present_modes_count);
+    for (u32 i = 0; i < present_modes_count; i += 1) {
+        printf("%u ", present_modes[i]); // VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_FIFO_KHR,
+                                         // VK_PRESENT_MODE_FIFO_RELAXED_KHR
+    }
+    printf("\n\tThe swapchain is capable\n");
+
+    // Select the present_mode
+    VkPresentModeKHR present_mode;
+    i32 chosen_present_mode = -1;
+    for (u32 i = 0; i < present_modes_count; i += 1) {
+        if (present_modes[i] == VK_PRESENT_MODE_MAILBOX_KHR) {
+            chosen_present_mode = i;
+            printf("\tChosen the VK_PRESENT_MODE_MAILBOX_KHR");
+            present_mode = VK_PRESENT_MODE_MAILBOX_KHR;
+        }
+    }
+    if (chosen_present_mode == -1) {
+        printf("\tThere are not the required present modes. Chosing VK_PRESENT_MODE_FIFO_KHR\n");
+        present_mode = VK_PRESENT_MODE_FIFO_KHR;
+    }
+
+    // 1. Basic surface capabilities (min/max number of images in swap chain, min/max width and height of images)
+    VkSurfaceCapabilitiesKHR capabilities;
+    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(pApp->vk_physical_device, pApp->vk_surface, &capabilities);
+
+    printf("\tCurrent extent (pixels) (%u, %u)\n", capabilities.currentExtent.width, capabilities.currentExtent.height);
+    printf("\tMin extent: (%u, %u)\n", capabilities.minImageExtent.width, capabilities.minImageExtent.height);
+    printf("\tMax extent: (%u, %u)\n", capabilities.maxImageExtent.width, capabilities.maxImageExtent.height);
+
+    VkExtent2D extent = {0, 0};
+    if (capabilities.currentExtent.width != UINT32_MAX) {
+        extent = capabilities.currentExtent;
+    } else {
+        i32 w, h;
+        glfwGetFramebufferSize(pApp->window, &w, &h);
+        printf("\tGLFW framebuffer size: (%u, %u)\n", w, h);
+        w = clamp_u32(w, capabilities.minImageExtent.width, capabilities.maxImageExtent.width);
+        h = clamp_u32(h, capabilities.minImageExtent.height, capabilities.maxImageExtent.height);
+        extent.width = w;
+        extent.height = h;
+    }
+    printf("\tChosen the current extent, which is (%u, %u)\n", extent.width, extent.height);
+
+    printf("\tFormat: %u\n\tColor Space: %u\n", surface_format.format, surface_format.colorSpace);
+    printf("\tPresent Mode: %u\n", present_mode);
+    printf("\tExtent: (%u, %u)\n", extent.width, extent.height);
+    // it is recomended to request at least one more image the minimum capable images
+    u32 image_count = capabilities.minImageCount + 1;
+    if (capabilities.maxImageCount > 0 && image_count > capabilities.maxImageCount) {
+        image_count = capabilities.maxImageCount;
+    }
+
+    VkSwapchainCreateInfoKHR swapchain_info = {
+        .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
+        .surface = pApp->vk_surface,
+        .minImageCount = image_count,
+        .imageFormat = surface_format.format,
+        .imageColorSpace = surface_format.colorSpace,
+        .imageExtent = extent,
+        .imageArrayLayers = 1,
+        // the post chain writes them from compute, or blits into them
+        .imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | post_target_usage(pApp),
+    };
+
+    // set the image sharing mode between the queues
+    u32 queue_family_indeces[] = {pApp->vk_queue_family_indices.graphics_family,
+                                  pApp->vk_queue_family_indices.present_family};
+    if (pApp->vk_queue_family_indices.graphics_family != pApp->vk_queue_family_indices.present_family) {
+        printf("\tThe queue families are not the same, creating two queues\n");
+        swapchain_info.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
+        swapchain_info.queueFamilyIndexCount = 2;
+        swapchain_info.pQueueFamilyIndices = queue_family_indeces;
+    } else {
+        printf("\tThe queue families are the same\n");
+        swapchain_info.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        swapchain_info.queueFamilyIndexCount = 0;  // optional
+        swapchain_info.pQueueFamilyIndices = NULL; // optional
+    }
+
+    // do not transform the image;
+    printf("\tCurrent transform: %u\n", capabilities.currentTransform);
+    swapchain_info.preTransform = capabilities.currentTransform;
+    // the way to blend the window with others. Probably always ommit the alpha
+    swapchain_info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+
+    swapchain_info.presentMode = present_mode;
+    swapchain_info.clipped = VK_TRUE;
+    // sometimes, if the window is resized we need to create another swapchain, and we need to refer to the old one. For
+    // now, we just create one.
+    swapchain_info.oldSwapchain = VK_NULL_HANDLE;
+
+    // create the swapchain
+    if (vkCreateSwapchainKHR(pApp->vk_device, &swapchain_info, NULL, &pApp->vk_swapchain) != VK_SUCCESS) {
+        printf("Failed to create the swapchain!\n");
+        exit(1);
+    }
+    printf("Swapchain succesfully created!\n");
+
+    // Retrieve the swapchain images
+    printf("Retrieve Swapchain images...\n");
+    printf("Old image count %u\n", image_count);
+    vkGetSwapchainImagesKHR(pApp->vk_device, pApp->vk_swapchain, &image_count, NULL); // we get 3 (2 + 1)
+    printf("After image count %u\n", image_count);
+    // the problem is that with VLA the memory address gets freed when leaving the scope... we have to malloc,
+    // apparently...
+    VkImage* swapchain_images = (VkImage*)malloc(image_count * sizeof(VkImage));
+    // VkImage swapchain_images[image_count];
+    vkGetSwapchainImagesKHR(pApp->vk_device, pApp->vk_swapchain, &image_count, swapchain_images);
+
+    pApp->vk_images = swapchain_images;
+    pApp->vk_image_count = image_count;
+    pApp->vk_format = surface_format.format;
+    pApp->vk_extent = extent;
+}
+
+u32 clamp_u32(u32 value, u32 min, u32 max)
+{
+    if (value <= max)
+        return max;
+    if (value >= min)
+        return min;
+    return 0;
+}
+
+void create_imageviews(App* pApp)
+{
+    // the image views defines how the images should be read and interpreted.
+
+    // again... malloc...
+    VkImageView* image_views = (VkImageView*)malloc(pApp->vk_image_count * sizeof(VkImageView));
+
+    for (u32 i = 0; i < pApp->vk_image_count; i += 1) {
+        VkImageViewCreateInfo create_info = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+            .image = pApp->vk_images[i],
+            .viewType = VK_IMAGE_VIEW_TYPE_2D,
+            .format = pApp->vk_format,
+            .components.r = VK_COMPONENT_SWIZZLE_IDENTITY,
+            .components.g = VK_COMPONENT_SWIZZLE_IDENTITY,
+            .components.b = VK_COMPONENT_SWIZZLE_IDENTITY,
+            .components.a = VK_COMPONENT_SWIZZLE_IDENTITY,
+            .subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .subresourceRange.levelCount = 1,
+            .subresourceRange.baseMipLevel = 0,
+            .subresourceRange.baseArrayLayer = 0,
+            .subresourceRange.layerCount = 1,
+        };
+
+        if (vkCreateImageView(pApp->vk_device, &create_info, NULL, &image_views[i]) != VK_SUCCESS) {
+            printf("failed to create image views!");
+            exit(1);
+        }
+    }
+
+    pApp->vk_imageviews = image_views;
+}
+
+void create_offscreen_targets(App* pApp)
+{
+    // Headless we have no swapchain to give us images, so we make our own ones with the same roles. They are never
+    // presented, only rendered to.
+    printf("Creating the offscreen targets\n");
+    u32 image_count = MAX_FRAMES_IN_FLIGHT;
+    VkFormat format = pApp->vk_format; // see choose_target_formats
+    VkExtent2D extent = {WIN_WIDTH, WIN_HEIGHT};
+
+    VkImage* images = (VkImage*)malloc(image_count * sizeof(VkImage));
+    VkDeviceMemory* memories = (VkDeviceMemory*)malloc(image_count * sizeof(VkDeviceMemory));
+
+    for (u32 i = 0; i < image_count; i += 1) {
+        create_image(pApp, extent, format, VK_SAMPLE_COUNT_1_BIT,
+                     VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | post_target_usage(pApp),
+                     &images[i], &memories[i]);
+    }
+    printf("Created %u offscreen images of (%u, %u)\n", image_count, extent.width, extent.height);
+
+    pApp->vk_images = images;
+    pApp->vk_offscreen_memories = memories;
+    pApp->vk_image_count = image_count;
+    pApp->vk_format = format;
+    pApp->vk_extent = extent;
+}
+
+// the MSAA target. It only lives inside the render pass (it is resolved into the swapchain image, or the HDR target of
+// the post chain, at the end), so it is transient: on tilers it can stay in tile memory and never be backed by real
+// memory
+void create_color_resources(App* pApp)
+{
+    if (pApp->vk_msaa_samples == VK_SAMPLE_COUNT_1_BIT) {
+        printf("MSAA disabled, rendering straight into the %s.\n",
+               pApp->post_processing ? "HDR target" : "swapchain images");
+        return;
+    }
+
+    create_image(pApp, pApp->vk_extent, pApp->vk_scene_format, pApp->vk_msaa_samples,
+                 VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT, &pApp->vk_color_image,
+                 &pApp->vk_color_memory);
+    pApp->vk_color_imageview =
+        create_image_view(pApp, pApp->vk_color_image, pApp->vk_scene_format, VK_IMAGE_ASPECT_COLOR_BIT);
+    printf("Created the %ux MSAA color target.\n", pApp->vk_msaa_samples);
+}
+
+// the highest sample count the device supports for color and depth, capped at what was requested
+VkSampleCountFlagBits choose_msaa_samples(App* pApp)
+{
+    u32 requested = pApp->requested_msaa_samples;
+    if (requested == 0) {
+        requested = 4; // the default
+    }
+
+    VkPhysicalDeviceProperties device_properties;
+    vkGetPhysicalDeviceProperties(pApp->vk_physical_device, &device_properties);
+    VkSampleCountFlags counts = device_properties.limits.framebufferColorSampleCounts &
+                                device_properties.limits.framebufferDepthSampleCounts;
+
+    // the flag bits are the sample counts themselves (VK_SAMPLE_COUNT_4_BIT == 4)
+    for (u32 samples = VK_SAMPLE_COUNT_64_BIT; samples > VK_SAMPLE_COUNT_1_BIT; samples >>= 1) {
+        if (samples <= requested && (counts & samples)) {
+            return (VkSampleCountFlagBits)samples;
+        }
+    }
+    return VK_SAMPLE_COUNT_1_BIT;
+}
+
+// Reversed-Z wants a float depth format, the precision of the floats is where it is needed (far away)
+VkFormat find_depth_format(App* pApp)
+{
+    VkFormat candidates[] = {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT};
+    u32 candidates_count = sizeof(candidates) / sizeof(candidates[0]);
+
+    for (u32 i = 0; i < candidates_count; i += 1) {
+        VkFormatProperties properties;
+        vkGetPhysicalDeviceFormatProperties(pApp->vk_physical_device, candidates[i], &properties);
+        if (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT) {
+            return candidates[i];
+        }
+    }
+
+    printf("Failed to find a float depth format!\n");
+    exit(1);
+}
+
+void create_depth_resources(App* pApp)
+{
+    // same samples as the color target, and nobody reads it after the pass so it is transient
+    create_image(pApp, pApp->vk_extent, pApp->vk_depth_format, pApp->vk_msaa_samples,
+                 VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
+                 &pApp->vk_depth_image, &pApp->vk_depth_memory);
+    pApp->vk_depth_imageview =
+        create_image_view(pApp, pApp->vk_depth_image, pApp->vk_depth_format, VK_IMAGE_ASPECT_DEPTH_BIT);
+    printf("Created the depth buffer (format %u).\n", pApp->vk_depth_format);
+}
+
+// Creates a 2D image with its own memory. Transient attachments go to lazily allocated memory when the device has it
+void create_image(App* pApp, VkExtent2D extent, VkFormat format, VkSampleCountFlagBits samples,
+                  VkImageUsageFlags usage, VkImage* image, VkDeviceMemory* memory)
+{
+    VkImageCreateInfo image_info = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = format,
+        .extent = {extent.width, extent.height, 1},
+        .mipLevels = 1,
+        .arrayLayers = 1,
+        .samples = samples,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = usage,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+    };
+    if (vkCreateImage(pApp->vk_device, &image_info, NULL, image) != VK_SUCCESS) {
+        printf("Failed to create an image!\n");
+        exit(1);
+    }
+
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements(pApp->vk_device, *image, &requirements);
+
+    u32 memory_type;
+    bool lazy = (usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) &&
+                try_find_memory_type(pApp, requirements.memoryTypeBits,
+                                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT,
+                                     &memory_type);
+    if (!lazy) {
+        memory_type = find_memory_type(pApp, requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    }
+    if (usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) {
+        printf("\tTransient attachment in %s memory (type %u)\n", lazy ? "lazily allocated" : "device local",
+               memory_type);
+    }
+
+    MemoryCategory category =
+        (usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) ? MEMORY_CATEGORY_TRANSIENT : MEMORY_CATEGORY_IMAGE;
+    *memory = allocate_memory(pApp, requirements.size, memory_type, category);
+    vkBindImageMemory(pApp->vk_device, *image, *memory, 0);
+}
+
+VkImageView create_image_view(App* pApp, VkImage image, VkFormat format, VkImageAspectFlags aspect)
+{
+    VkImageViewCreateInfo create_info = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .image = image,
+        .viewType = VK_IMAGE_VIEW_TYPE_2D,
+        .format = format,
+        .components.r = VK_COMPONENT_SWIZZLE_IDENTITY,
+        .components.g = VK_COMPONENT_SWIZZLE_IDENTITY,
+        .components.b = VK_COMPONENT_SWIZZLE_IDENTITY,
+        .components.a = VK_COMPONENT_SWIZZLE_IDENTITY,
+        .subresourceRange.aspectMask = aspect,
+        .subresourceRange.levelCount = 1,
+        .subresourceRange.baseMipLevel = 0,
+        .subresourceRange.baseArrayLayer = 0,
+        .subresourceRange.layerCount = 1,
+    };
+
+    VkImageView image_view;
+    if (vkCreateImageView(pApp->vk_device, &create_info, NULL, &image_view) != VK_SUCCESS) {
+        printf("failed to create an image view!");
+        exit(1);
+    }
+    return image_view;
+}
+
+bool try_find_memory_type(App* pApp, u32 type_filter, VkMemoryPropertyFlags properties, u32* memory_type)
+{
+    VkPhysicalDeviceMemoryProperties memory_properties;
+    vkGetPhysicalDeviceMemoryProperties(pApp->vk_physical_device, &memory_properties);
+
+    for (u32 i = 0; i < memory_properties.memoryTypeCount; i += 1) {
+        if ((type_filter & (1u << i)) && (memory_properties.memoryTypes[i].propertyFlags & properties) == properties) {
+            *memory_type = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+u32 find_memory_type(App* pApp, u32 type_filter, VkMemoryPropertyFlags properties)
+{
+    u32 memory_type;
+    if (!try_find_memory_type(pApp, type_filter, properties, &memory_type)) {
+        printf("Failed to find a suitable memory type!\n");
+        exit(1);
+    }
+    return memory_type;
+}
+
+void create_buffer(App* pApp, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+                   MemoryCategory category, VkBuffer* buffer, VkDeviceMemory* memory)
+{
+    VkBufferCreateInfo buffer_info = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = size,
+        .usage = usage,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+    if (vkCreateBuffer(pApp->vk_device, &buffer_info, NULL, buffer) != VK_SUCCESS) {
+        printf("Failed to create a buffer!\n");
+        exit(1);
+    }
+
+    VkMemoryRequirements memory_requirements;
+    vkGetBufferMemoryRequirements(pApp->vk_device, *buffer, &memory_requirements);
+    u32 memory_type = find_memory_type(pApp, memory_requirements.memoryTypeBits, properties);
+    *memory = allocate_memory(pApp, memory_requirements.size, memory_type, category);
+    vkBindBufferMemory(pApp->vk_device, *buffer, *memory, 0);
+}
+
+// a throwaway command buffer for uploads, submitted and waited on right away
+VkCommandBuffer begin_single_time_commands(App* pApp)
+{
+    VkCommandBufferAllocateInfo alloc_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = pApp->vk_command_pool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1,
+    };
+    VkCommandBuffer command_buffer;
+    vkAllocateCommandBuffers(pApp->vk_device, &alloc_info, &command_buffer);
+
+    VkCommandBufferBeginInfo begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+    vkBeginCommandBuffer(command_buffer, &begin_info);
+    return command_buffer;
+}
+
+void end_single_time_commands(App* pApp, VkCommandBuffer command_buffer)
+{
+    vkEndCommandBuffer(command_buffer);
+
+    VkSubmitInfo submit_info = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &command_buffer,
+    };
+    vkQueueSubmit(pApp->vk_graphics_queue, 1, &submit_info, VK_NULL_HANDLE);
+    count_metric(&pApp->metrics, COUNTER_SUBMISSIONS);
+    vkQueueWaitIdle(pApp->vk_graphics_queue);
+
+    vkFreeCommandBuffers(pApp->vk_device, pApp->vk_command_pool, 1, &command_buffer);
+}
+
+void copy_buffer(App* pApp, VkBuffer src, VkBuffer dst, VkDeviceSize size)
+{
+    VkCommandBuffer command_buffer = begin_single_time_commands(pApp);
+    VkBufferCopy region = {
+        .srcOffset = 0,
+        .dstOffset = 0,
+        .size = size,
+    };
+    vkCmdCopyBuffer(command_buffer, src, dst, 1, &region);
+    end_single_time_commands(pApp, command_buffer);
+}
+
+Shader read_file(const char* filename)
+{
+    FILE* file;
+    file = fopen(filename, "rb");
+
+    if (file == NULL) {
+        printf("The file couldn't be opened!\n");
+        exit(1);
+    }
+
+    // Seek to the end of the file to determine its size
+    fseek(file, 0, SEEK_END);
+    unsigned long file_size = ftell(file);
+    printf("Filename %s has size of: %lu\n", filename, file_size);
+    fseek(file, 0, SEEK_SET); // Reset file position indicator to the beginning
+    // printf("Postion of the file pointer at: %lu\n", ftell(file));
+
+    char* buffer = (char*)malloc(file_size);
+    fread(buffer, file_size, sizeof(char), file);
+    fclose(file);
+
+    Shader shader;
+    shader.binary = buffer;
+    shader.size = file_size;
+
+    return shader;
+}
+
+VkShaderModule create_shader_module(App* pApp, char* binary, u32 size)
+{
+    UNUSED(binary);
+    UNUSED(size);
+
+    VkShaderModuleCreateInfo shader_info = {
+        .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+        .codeSize = size,
+        .pCode = (u32*)binary,
+    };
+
+    VkShaderModule shader_module = {0};
+    if (vkCreateShaderModule(pApp->vk_device, &shader_info, NULL, &shader_module) != VK_SUCCESS) {
+        printf("Could not create shader module!\n");
+        exit(1);
+    }
+    if (pApp->capture != NULL) {
+        capture_shader_module(pApp, shader_module, binary, size);
+    }
+
+    return shader_module;
+}
+
+// The formats of the color and depth attachments, all the render pass and the pipelines need from the targets
+void choose_target_formats(App* pApp)
+{
+    if (pApp->headless) {
+        pApp->vk_format = VK_FORMAT_B8G8R8A8_UNORM;
+    } else {
+        pApp->vk_format = choose_surface_format(pApp).format;
+    }
+    pApp->vk_depth_format = find_depth_format(pApp);
+    if (pApp->post_processing) {
+        choose_post_output(pApp); // may still turn it off
+    }
+    pApp->vk_scene_format = pApp->post_processing ? choose_hdr_format(pApp) : pApp->vk_format;
+}
+
+void create_renderpass(App* pApp)
+{
+    // Headless nobody presents the image, so we leave it ready to be copied out. The HDR target of the post chain is
+    // left ready for its kernels to sample
+    VkImageLayout final_layout =
+        pApp->headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    if (pApp->post_processing) {
+        final_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    }
+    bool msaa = pApp->vk_msaa_samples != VK_SAMPLE_COUNT_1_BIT;
+
+    // the color buffer attachment. Without MSAA it is one of the images from the swapchain (or the HDR target). With
+    // MSAA it is the multisampled target, which is never stored: it is resolved at the end of the subpass
+    VkAttachmentDescription color_attachment = {
+        .format = pApp->vk_scene_format,
+        .samples = pApp->vk_msaa_samples,
+        .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+        .storeOp = msaa ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE,
+        .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+        .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED, // we clear it anyway
+        .finalLayout = msaa ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : final_layout,
+    };
+
+    // the depth buffer. Cleared to 0.0 (reversed-Z), and thrown away at the end
+    VkAttachmentDescription depth_attachment = {
+        .format = pApp->vk_depth_format,
+        .samples = pApp->vk_msaa_samples,
+        .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+        .storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+        .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+        .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+    };
+
+    // the swapchain image (or the HDR target) the MSAA target is resolved to
+    VkAttachmentDescription resolve_attachment = {
+        .format = pApp->vk_scene_format,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE, // fully overwritten by the resolve
+        .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+        .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+        .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .finalLayout = final_layout,
+    };
+
+    VkAttachmentReference color_attachment_ref = {
+        .attachment = 0, // the index in the attachments array (layout(location = 0) out vec4 outColor)
+        .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+    };
+
+    VkAttachmentReference depth_attachment_ref = {
+        .attachment = 1,
+        .layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+    };
+
+    VkAttachmentReference resolve_attachment_ref = {
+        .attachment = 2,
+        .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+    };
+
+    VkSubpassDescription subpass = {
+        .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+        .colorAttachmentCount = 1,
+        .pColorAttachments = &color_attachment_ref,
+        .pResolveAttachments = msaa ? &resolve_attachment_ref : NULL, // resolved in-pass, no extra copy
+        .pDepthStencilAttachment = &depth_attachment_ref,
+    };
+
+    // wait for the image to be acquired before writing to it. The depth buffer (and the MSAA target) is shared by
+    // all the frames in flight, so also wait for the previous frame to be done writing to it. The HDR target too, and
+    // the previous post chain reads it
+    VkSubpassDependency dependencies[] = {
+        {
+            .srcSubpass = VK_SUBPASS_EXTERNAL,
+            .dstSubpass = 0,
+            .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT |
+                            (pApp->post_processing ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT : 0),
+            .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+            .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
+            .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+        },
+        // the post chain samples the HDR target after the pass
+        {
+            .srcSubpass = 0,
+            .dstSubpass = VK_SUBPASS_EXTERNAL,
+            .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+            .dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+        },
+    };
+
+    VkAttachmentDescription attachments[] = {color_attachment, depth_attachment, resolve_attachment};
+    VkRenderPassCreateInfo renderpass_info = {
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+        .attachmentCount = msaa ? 3 : 2,
+        .pAttachments = attachments,
+        .subpassCount = 1,
+        .pSubpasses = &subpass,
+        .dependencyCount = pApp->post_processing ? 2 : 1,
+        .pDependencies = dependencies,
+    };
+
+    if (vkCreateRenderPass(pApp->vk_device, &renderpass_info, NULL, &pApp->vk_renderpass) != VK_SUCCESS) {
+        printf("Failed to create the render pass!\n");
+        exit(1);
+    }
+    printf("Render pass created.\n");
+}
+
+void create_pipeline_layout(App* pApp)
+{
+    // Pipeline layout. The push constants place the mesh, the triangle shaders ignore them. Set 0 is the lights and
+    // their clusters, read by the fragment shader
+    VkPushConstantRange push_constant_range = {
+        .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+        .offset = 0,
+        .size = sizeof(MeshPushConstants),
+    };
+
+    VkPipelineLayoutCreateInfo pipeline_layout_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 1,
+        .pSetLayouts = &pApp->lighting->descriptor_set_layout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &push_constant_range,
+    };
+    // create it
+    if (vkCreatePipelineLayout(pApp->vk_device, &pipeline_layout_info, NULL, &pApp->vk_pipeline_layout) != VK_SUCCESS) {
+        printf("Pipeline Layout couldn't create properly\n");
+        exit(1);
+    }
+}
+
+// The three pipelines of the scene (normal, depth prepass, EQUAL), from the shaders on disk
+void create_scene_pipelines(App* pApp)
+{
+    read_scene_shaders(pApp);
+    build_scene_pipelines(pApp);
+}
+
+// Only file reads, no device: the startup does it on a worker thread. The vertex format comes from the loaded mesh,
+// or from the mapped file when the mesh is not uploaded yet
+void read_scene_shaders(App* pApp)
+{
+    SceneShaders* shaders = &pApp->scene_shaders;
+    // a loaded mesh comes with vertex buffers, the triangle is hardcoded in the shader
+    shaders->vert_filename = "build/shaders/vertex.spv";
+    shaders->frag_filename = "build/shaders/fragment.spv";
+    shaders->has_vertex_input = false;
+    shaders->octahedral_normals = false;
+    // the file first: during the startup the main thread may be setting pApp->mesh while this runs
+    if (pApp->mesh_file != NULL || pApp->mesh != NULL) {
+        u32 vertex_format = pApp->mesh_file != NULL ? pApp->mesh_file->vertex_format : pApp->mesh->vertex_format;
+        shaders->vert_filename = "build/shaders/mesh_vertex.spv";
+        shaders->vertex_layout = mesh_vertex_layout(vertex_format);
+        shaders->has_vertex_input = true;
+        shaders->octahedral_normals = mesh_octahedral_normals(vertex_format);
+    }
+    shaders->vert = read_file(shaders->vert_filename);
+    shaders->frag = read_file(shaders->frag_filename);
+}
+
+// needs the render pass and the pipeline layout. The binaries go into the modules of the shader variants
+void build_scene_pipelines(App* pApp)
+{
+    SceneShaders* shaders = &pApp->scene_shaders;
+    add_shader_module(pApp, shaders->vert_filename, &shaders->vert);
+    add_shader_module(pApp, shaders->frag_filename, &shaders->frag);
+    select_scene_pipelines(pApp);
+    printf("Graphics pipelines created.\n");
+}
+
+// Points the three scene pipelines (normal, depth prepass, EQUAL) at the variants for the current toggles. A
+// combination seen before is only a lookup
+void select_scene_pipelines(App* pApp)
+{
+    const SceneShaders* shaders = &pApp->scene_shaders;
+    VkShaderModule vert_module = find_shader_module(pApp, shaders->vert_filename);
+    VkShaderModule frag_module = find_shader_module(pApp, shaders->frag_filename);
+    const VertexLayout* pvertex_layout = shaders->has_vertex_input ? &shaders->vertex_layout : NULL;
+
+    ShaderConstants constants = {0};
+    constants.values[SHADER_CONSTANT_OCTAHEDRAL_NORMALS] = shaders->octahedral_normals;
+    constants.values[SHADER_CONSTANT_LIGHTING] = !pApp->disable_lighting;
+
+    pApp->vk_pipeline =
+        get_pipeline_variant(pApp, vert_module, frag_module, pvertex_layout, DEPTH_MODE_TEST_WRITE, &constants);
+    pApp->vk_depth_prepass_pipeline =
+        get_pipeline_variant(pApp, vert_module, frag_module, pvertex_layout, DEPTH_MODE_PREPASS, &constants);
+    pApp->vk_equal_pipeline =
+        get_pipeline_variant(pApp, vert_module, frag_module, pvertex_layout, DEPTH_MODE_EQUAL, &constants);
+}
+
+// Rebuilds the pipelines while frames are in flight: the old ones are retired, not destroyed, so there is no
+// vkDeviceWaitIdle. The command cache sees the new handles and re-records
+void reload_pipelines(App* pApp)
+{
+    f64 start_ms = now_ms();
+    clear_shader_variants(pApp);
+    create_scene_pipelines(pApp);
+    retire_pipeline(pApp, pApp->lighting->pipeline);
+    create_lighting_pipeline(pApp);
+    if (pApp->sprites != NULL) {
+        for (u32 i = 0; i < SPRITE_BLEND_COUNT; i += 1) {
+            retire_pipeline(pApp, pApp->sprites->pipelines[i]);
+        }
+        create_sprite_pipelines(pApp);
+    }
+    if (pApp->post != NULL) {
+        for (u32 i = 0; i < POST_KERNEL_COUNT; i += 1) {
+            retire_pipeline(pApp, pApp->post->pipelines[i]);
+        }
+        create_post_pipelines(pApp);
+    }
+    printf("Pipelines reloaded in %.2f ms\n", now_ms() - start_ms);
+}
+
+// Builds a pipeline with all the fixed function state, for the current render pass and layout. Split from
+// build_scene_pipelines so the same modules can be reused (the benchmark creates lots of them)
+VkPipeline create_pipeline(App* pApp, VkShaderModule vert_module, VkShaderModule frag_module,
+                           const VertexLayout* vertex_layout, DepthMode depth_mode, const ShaderConstants* constants)
+{
+    // The specialization constants, the same ones for both stages. Without them the shaders keep their defaults
+    VkSpecializationMapEntry map_entries[SHADER_CONSTANT_COUNT];
+    for (u32 i = 0; i < SHADER_CONSTANT_COUNT; i += 1) {
+        map_entries[i] = (VkSpecializationMapEntry){
+            .constantID = i,
+            .offset = i * sizeof(u32),
+            .size = sizeof(u32),
+        };
+    }
+    VkSpecializationInfo specialization_info = {
+        .mapEntryCount = SHADER_CONSTANT_COUNT,
+        .pMapEntries = map_entries,
+        .dataSize = sizeof(ShaderConstants),
+        .pData = constants,
+    };
+
+    // Assign the shaders to a specific stage in the graphics pipeline
+    // Start with the vertex shader
+    VkPipelineShaderStageCreateInfo vert_shader_stage_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+        .stage = VK_SHADER_STAGE_VERTEX_BIT, // here
+        .module = vert_module,
+        .pName = "main", // the entry point
+        .pSpecializationInfo = constants != NULL ? &specialization_info : NULL,
+    };
+
+    // The fragment shader
+    VkPipelineShaderStageCreateInfo frag_shader_stage_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+        .stage = VK_SHADER_STAGE_FRAGMENT_BIT, // here
+        .module = frag_module,
+        .pName = "main", // the entry point
+        .pSpecializationInfo = constants != NULL ? &specialization_info : NULL,
+    };
+
+    // store here the shader stages, the programable parts. The depth prepass only needs the positions
+    VkPipelineShaderStageCreateInfo shader_stages[] = {vert_shader_stage_info, frag_shader_stage_info};
+    u32 shader_stages_count = depth_mode == DEPTH_MODE_PREPASS ? 1 : 2;
+
+    // The fixed functions, non programable
+
+    // what is this? states that can be changed without recreating the pipeline at draw time. We set the viewport and
+    // the scissors
+    VkDynamicState dynamic_states[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    u32 dynamic_states_count = 2;
+    VkPipelineDynamicStateCreateInfo dynamic_state = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+        .dynamicStateCount = dynamic_states_count,
+        .pDynamicStates = dynamic_states,
+    };
+
+    // The vertex input. How the vertex data will be passed to the vertex shader. Nothing without a layout
+    VkPipelineVertexInputStateCreateInfo vertex_input_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+        .vertexBindingDescriptionCount = 0,
+        .pVertexBindingDescriptions = NULL, // Optional
+        .vertexAttributeDescriptionCount = 0,
+        .pVertexAttributeDescriptions = NULL, // Optional
+    };
+    if (vertex_layout != NULL) {
+        vertex_input_info.vertexBindingDescriptionCount = 1;
+        vertex_input_info.pVertexBindingDescriptions = &vertex_layout->binding;
+        vertex_input_info.vertexAttributeDescriptionCount = vertex_layout->attribute_count;
+        vertex_input_info.pVertexAttributeDescriptions = vertex_layout->attributes;
+    }
+
+    // vertex assembler how the vertex data will be read
+    VkPipelineInputAssemblyStateCreateInfo input_assembly = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+        .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+        .primitiveRestartEnable = VK_FALSE,
+    };
+
+    // set the viewport. The part of the frambuffer that the output will be rendered to. For now (and almost always)
+    // will be from (0,0) to (width, height). Since they are dynamic, the real ones are set in record_commandbuffer
+
+    // Since we are doing the viewport and scissor dynamic, we don't need to don't need to pass the viewport and scissor
+    // to be generated at the creation of the pipeline (do not pass to the pipeline layout, basically)
+    VkPipelineViewportStateCreateInfo viewport_state = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+        .viewportCount = 1,
+        .scissorCount = 1,
+    };
+
+    // the rasterizer
+    VkPipelineRasterizationStateCreateInfo rasterizer = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+        .depthClampEnable = VK_FALSE,
+        .rasterizerDiscardEnable = VK_FALSE,
+        .polygonMode = VK_POLYGON_MODE_FILL,
+        .lineWidth = 1.0f,
+        .cullMode = VK_CULL_MODE_BACK_BIT,
+        .frontFace = VK_FRONT_FACE_CLOCKWISE,
+        .depthBiasEnable = VK_FALSE,
+        .depthBiasConstantFactor = 0.0f, // Optional
+        .depthBiasClamp = 0.0f,          // Optional
+        .depthBiasSlopeFactor = 0.0f,    // Optional
+    };
+
+    // multisampling, it has to match the samples of the render pass color attachment
+    VkPipelineMultisampleStateCreateInfo multisampling = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+        .sampleShadingEnable = VK_FALSE,
+        .rasterizationSamples = pApp->vk_msaa_samples,
+        .minSampleShading = 1.0f,          // Optional
+        .pSampleMask = NULL,               // Optional
+        .alphaToCoverageEnable = VK_FALSE, // Optional
+        .alphaToOneEnable = VK_FALSE,      // optional
+    };
+
+    // Depth and stencil testing. Reversed-Z: the buffer is cleared to 0.0 and nearer fragments have bigger depth.
+    // After a prepass the depth is final, so EQUAL lets exactly one fragment per sample through (full early-Z)
+    VkPipelineDepthStencilStateCreateInfo depth_stencil = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+        .depthTestEnable = VK_TRUE,
+        .depthWriteEnable = depth_mode == DEPTH_MODE_EQUAL ? VK_FALSE : VK_TRUE,
+        .depthCompareOp = depth_mode == DEPTH_MODE_EQUAL ? VK_COMPARE_OP_EQUAL : VK_COMPARE_OP_GREATER_OR_EQUAL,
+        .depthBoundsTestEnable = VK_FALSE,
+        .minDepthBounds = 0.0f, // Optional
+        .maxDepthBounds = 1.0f, // Optional
+        .stencilTestEnable = VK_FALSE,
+    };
+
+    // color blending
+    VkColorComponentFlags color_write_mask =
+        VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    VkPipelineColorBlendAttachmentState color_blend_attachment = {
+        .colorWriteMask = depth_mode == DEPTH_MODE_PREPASS ? 0 : color_write_mask,
+        .blendEnable = VK_FALSE,
+        .srcColorBlendFactor = VK_BLEND_FACTOR_ONE,  // Optional
+        .dstColorBlendFactor = VK_BLEND_FACTOR_ZERO, // Optional
+        .colorBlendOp = VK_BLEND_OP_ADD,             // Optional
+        .srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE,  // Optional
+        .dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO, // Optional
+        .alphaBlendOp = VK_BLEND_OP_ADD,             // Optional
+    };
+
+    VkPipelineColorBlendStateCreateInfo color_blending = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+        .logicOpEnable = VK_FALSE,
+        .logicOp = VK_LOGIC_OP_COPY, // Optional
+        .attachmentCount = 1,
+        .pAttachments = &color_blend_attachment,
+        .blendConstants[0] = 0.0f, // Optional
+        .blendConstants[1] = 0.0f, // Optional
+        .blendConstants[2] = 0.0f, // Optional
+        .blendConstants[3] = 0.0f, // Optional
+    };
+
+    VkGraphicsPipelineCreateInfo pipeline_info = {
+        .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+        .stageCount = shader_stages_count,
+        .pStages = shader_stages,
+        .pVertexInputState = &vertex_input_info,
+        .pInputAssemblyState = &input_assembly,
+        .pViewportState = &viewport_state,
+        .pRasterizationState = &rasterizer,
+        .pMultisampleState = &multisampling,
+        .pDepthStencilState = &depth_stencil,
+        .pColorBlendState = &color_blending,
+        .pDynamicState = &dynamic_state,
+        .layout = pApp->vk_pipeline_layout,
+        .renderPass = pApp->vk_renderpass,
+        .subpass = 0,
+        .basePipelineHandle = VK_NULL_HANDLE, // Optional
+        .basePipelineIndex = -1,              // Optional
+    };
+
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    if (vkCreateGraphicsPipelines(pApp->vk_device, VK_NULL_HANDLE, 1, &pipeline_info, NULL, &pipeline) != VK_SUCCESS) {
+        printf("Failed to create the graphics pipeline!\n");
+        exit(1);
+    }
+    if (pApp->capture != NULL) {
+        capture_pipeline(pApp, pipeline, vert_module, frag_module, vertex_layout, depth_mode, constants);
+    }
+
+    return pipeline;
+}
+
+void create_framebuffers(App* pApp)
+{
+    // one framebuffer per image, the render pass draws into the one we acquired
+    pApp->vk_framebuffers = (VkFramebuffer*)malloc(pApp->vk_image_count * sizeof(VkFramebuffer));
+
+    for (u32 i = 0; i < pApp->vk_image_count; i += 1) {
+        // same order as the render pass attachments. All of them share the one depth buffer (and MSAA target)
+        bool msaa = pApp->vk_msaa_samples != VK_SAMPLE_COUNT_1_BIT;
+        // with the post chain the pass draws into the HDR target, the same for every image
+        VkImageView target = pApp->post != NULL ? pApp->post->hdr_view : pApp->vk_imageviews[i];
+        VkImageView attachments[3] = {target, pApp->vk_depth_imageview};
+        if (msaa) {
+            attachments[0] = pApp->vk_color_imageview;
+            attachments[2] = target;
+        }
+
+        VkFramebufferCreateInfo framebuffer_info = {
+            .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+            .renderPass = pApp->vk_renderpass,
+            .attachmentCount = msaa ? 3 : 2,
+            .pAttachments = attachments,
+            .width = pApp->vk_extent.width,
+            .height = pApp->vk_extent.height,
+            .layers = 1,
+        };
+
+        if (vkCreateFramebuffer(pApp->vk_device, &framebuffer_info, NULL, &pApp->vk_framebuffers[i]) != VK_SUCCESS) {
+            printf("Failed to create framebuffer %u!\n", i);
+            exit(1);
+        }
+    }
+    printf("Created %u framebuffers.\n", pApp->vk_image_count);
+}
+
+void create_commandpool(App* pApp)
+{
+    VkCommandPoolCreateInfo pool_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT, // we re-record every frame
+        .queueFamilyIndex = pApp->vk_queue_family_indices.graphics_family,
+    };
+
+    if (vkCreateCommandPool(pApp->vk_device, &pool_info, NULL, &pApp->vk_command_pool) != VK_SUCCESS) {
+        printf("Failed to create the command pool!\n");
+        exit(1);
+    }
+    printf("Command pool created.\n");
+}
+
+void create_commandbuffers(App* pApp)
+{
+    VkCommandBufferAllocateInfo alloc_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = pApp->vk_command_pool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = MAX_FRAMES_IN_FLIGHT,
+    };
+
+    if (vkAllocateCommandBuffers(pApp->vk_device, &alloc_info, pApp->vk_command_buffers) != VK_SUCCESS) {
+        printf("Failed to allocate the command buffers!\n");
+        exit(1);
+    }
+    printf("Command buffers allocated.\n");
+}
+
+void create_sync_objects(App* pApp)
+{
+    VkSemaphoreCreateInfo semaphore_info = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+    };
+
+    // signaled, so the first wait of each frame does not block forever
+    VkFenceCreateInfo fence_info = {
+        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+        .flags = VK_FENCE_CREATE_SIGNALED_BIT,
+    };
+
+    for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; i += 1) {
+        if (vkCreateSemaphore(pApp->vk_device, &semaphore_info, NULL, &pApp->vk_image_available_semaphores[i]) !=
+            VK_SUCCESS) {
+            printf("Failed to create the sync objects for a frame!\n");
+            exit(1);
+        }
+        if (!pApp->timeline_semaphores &&
+            vkCreateFence(pApp->vk_device, &fence_info, NULL, &pApp->vk_in_flight_fences[i]) != VK_SUCCESS) {
+            printf("Failed to create the fences for a frame!\n");
+            exit(1);
+        }
+    }
+
+    // starts at 0, which every frame "waits" for the first time around
+    if (pApp->timeline_semaphores) {
+        VkSemaphoreTypeCreateInfo type_info = {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+            .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+            .initialValue = 0,
+        };
+        VkSemaphoreCreateInfo timeline_info = {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+            .pNext = &type_info,
+        };
+        if (vkCreateSemaphore(pApp->vk_device, &timeline_info, NULL, &pApp->vk_timeline_semaphore) != VK_SUCCESS) {
+            printf("Failed to create the timeline semaphore!\n");
+            exit(1);
+        }
+    }
+
+    // the render finished semaphore is waited by the present of that image, so it goes per image and not per frame
+    pApp->vk_render_finished_semaphores = (VkSemaphore*)malloc(pApp->vk_image_count * sizeof(VkSemaphore));
+    for (u32 i = 0; i < pApp->vk_image_count; i += 1) {
+        if (vkCreateSemaphore(pApp->vk_device, &semaphore_info, NULL, &pApp->vk_render_finished_semaphores[i]) !=
+            VK_SUCCESS) {
+            printf("Failed to create the render finished semaphores!\n");
+            exit(1);
+        }
+    }
+    printf("Sync objects created.\n");
+}
+
+// Without timestamps on the graphics queue the GPU frame time is simply not reported
+void create_timestamp_queries(App* pApp)
+{
+    u32 queue_family_count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(pApp->vk_physical_device, &queue_family_count, NULL);
+    VkQueueFamilyProperties* queue_families =
+        (VkQueueFamilyProperties*)malloc(queue_family_count * sizeof(VkQueueFamilyProperties));
+    vkGetPhysicalDeviceQueueFamilyProperties(pApp->vk_physical_device, &queue_family_count, queue_families);
+    u32 valid_bits = queue_families[pApp->vk_queue_family_indices.graphics_family].timestampValidBits;
+    free(queue_families);
+
+    VkPhysicalDeviceProperties device_properties;
+    vkGetPhysicalDeviceProperties(pApp->vk_physical_device, &device_properties);
+    if (valid_bits == 0 || device_properties.limits.timestampPeriod <= 0.0f) {
+        printf("No timestamps on the graphics queue, the GPU frame time is not measured.\n");
+        return;
+    }
+    pApp->timestamp_period_ns = (f64)device_properties.limits.timestampPeriod;
+    pApp->timestamp_mask = valid_bits >= 64 ? ~0ull : (1ull << valid_bits) - 1;
+
+    VkQueryPoolCreateInfo pool_info = {
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .queryType = VK_QUERY_TYPE_TIMESTAMP,
+        .queryCount = FRAME_TIMESTAMPS * MAX_FRAMES_IN_FLIGHT,
+    };
+    if (vkCreateQueryPool(pApp->vk_device, &pool_info, NULL, &pApp->vk_timestamp_pool) != VK_SUCCESS) {
+        printf("Failed to create the timestamp query pool!\n");
+        exit(1);
+    }
+    pApp->gpu_timestamps = true;
+}
+
+// The frame slot was just waited for, its timestamps are there: no VK_QUERY_RESULT_WAIT_BIT, no stall
+void read_frame_timestamps(App* pApp, u32 frame)
+{
+    pApp->frame_gpu_ms = -1.0;
+    if (!pApp->timestamps_written[frame]) {
+        return;
+    }
+    u64 timestamps[FRAME_TIMESTAMPS];
+    if (vkGetQueryPoolResults(pApp->vk_device, pApp->vk_timestamp_pool, frame * FRAME_TIMESTAMPS, FRAME_TIMESTAMPS,
+                              sizeof(timestamps), timestamps, sizeof(u64), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+        return;
+    }
+    u64 ticks = (timestamps[2] - timestamps[0]) & pApp->timestamp_mask;
+    u64 gpu_ns = (u64)((f64)ticks * pApp->timestamp_period_ns);
+    record_metric(&pApp->metrics, METRIC_GPU_FRAME_TIME, gpu_ns);
+    pApp->frame_gpu_ms = (f64)gpu_ns / 1000000.0;
+    if (pApp->post != NULL) {
+        u64 post_ticks = (timestamps[2] - timestamps[1]) & pApp->timestamp_mask;
+        record_metric(&pApp->metrics, METRIC_GPU_POST_TIME, (u64)((f64)post_ticks * pApp->timestamp_period_ns));
+    }
+}
+
+// Blocks until the GPU is done with every submission up to value. Without timeline semaphores, a fence covers all
+// the earlier submissions of the queue too, so the first frame fence at or past value is enough
+void wait_timeline_value(App* pApp, u64 value)
+{
+    if (value <= pApp->completed_timeline_value) {
+        return;
+    }
+
+    if (pApp->timeline_semaphores) {
+        VkSemaphoreWaitInfo wait_info = {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+            .semaphoreCount = 1,
+            .pSemaphores = &pApp->vk_timeline_semaphore,
+            .pValues = &value,
+        };
+        pApp->vk_wait_semaphores(pApp->vk_device, &wait_info, UINT64_MAX);
+    } else {
+        u32 wait_frame = MAX_FRAMES_IN_FLIGHT;
+        for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; i += 1) {
+            if (pApp->frame_timeline_values[i] >= value &&
+                (wait_frame == MAX_FRAMES_IN_FLIGHT ||
+                 pApp->frame_timeline_values[i] < pApp->frame_timeline_values[wait_frame])) {
+                wait_frame = i;
+            }
+        }
+        if (wait_frame == MAX_FRAMES_IN_FLIGHT) {
+            printf("Waiting for timeline value %llu, which was never submitted!\n", (unsigned long long)value);
+            return;
+        }
+        vkWaitForFences(pApp->vk_device, 1, &pApp->vk_in_flight_fences[wait_frame], VK_TRUE, UINT64_MAX);
+    }
+    pApp->completed_timeline_value = value;
+}
+
+// Where the GPU is, without blocking
+u64 get_completed_timeline_value(App* pApp)
+{
+    u64 completed = pApp->completed_timeline_value;
+    if (pApp->timeline_semaphores) {
+        pApp->vk_get_semaphore_counter_value(pApp->vk_device, pApp->vk_timeline_semaphore, &completed);
+    } else {
+        for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; i += 1) {
+            if (pApp->frame_timeline_values[i] > completed &&
+                vkGetFenceStatus(pApp->vk_device, pApp->vk_in_flight_fences[i]) == VK_SUCCESS) {
+                completed = pApp->frame_timeline_values[i];
+            }
+        }
+    }
+    if (completed > pApp->completed_timeline_value) {
+        pApp->completed_timeline_value = completed;
+    }
+    return pApp->completed_timeline_value;
+}
+
+void record_commandbuffer(App* pApp, VkCommandBuffer command_buffer, u32 image_index)
+{
+    VkCommandBufferBeginInfo begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+
+    if (vkBeginCommandBuffer(command_buffer, &begin_info) != VK_SUCCESS) {
+        printf("Failed to begin recording the command buffer!\n");
+        exit(1);
+    }
+
+    // the frame on the GPU, from the start of this command buffer to the end of its work. The one in the middle
+    // splits it at the end of the render pass, what comes after is the post chain
+    u32 first_query = pApp->current_frame * FRAME_TIMESTAMPS;
+    if (pApp->gpu_timestamps) {
+        vkCmdResetQueryPool(command_buffer, pApp->vk_timestamp_pool, first_query, FRAME_TIMESTAMPS);
+        vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, pApp->vk_timestamp_pool, first_query);
+    }
+
+    // the lights of the frame into the clusters, before the fragments read them. A capture has them at the start of
+    // the frame, the replay bins the captured ones
+    bool capturing = pApp->capture != NULL;
+    if (pApp->replay != NULL) {
+        record_replay_light_binning(pApp, command_buffer);
+    } else {
+        if (capturing) {
+            capture_frame_begin(pApp);
+        }
+        record_light_binning(pApp, command_buffer);
+    }
+
+    // same order as the attachments. The depth clears to the far plane, which is 0.0 with reversed-Z
+    VkClearValue clear_values[2] = {
+        {.color = {{0.0f, 0.0f, 0.0f, 1.0f}}},
+        {.depthStencil = {0.0f, 0}},
+    };
+    VkRenderPassBeginInfo renderpass_info = {
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+        .renderPass = pApp->vk_renderpass,
+        .framebuffer = pApp->vk_framebuffers[image_index],
+        .renderArea.offset = {0, 0},
+        .renderArea.extent = pApp->vk_extent,
+        .clearValueCount = 2,
+        .pClearValues = clear_values,
+    };
+
+    // a capture records every frame inline, through the cmd_* wrappers
+    if (pApp->replay != NULL) {
+        vkCmdBeginRenderPass(command_buffer, &renderpass_info, VK_SUBPASS_CONTENTS_INLINE);
+        // the descriptor sets are not in the stream, they are the replay's own over the captured lights
+        bind_lighting(pApp, command_buffer);
+        record_replay_commands(pApp, command_buffer);
+    } else if (!pApp->disable_command_cache && !capturing) {
+        vkCmdBeginRenderPass(command_buffer, &renderpass_info, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+        execute_cached_commands(pApp, command_buffer);
+    } else {
+        vkCmdBeginRenderPass(command_buffer, &renderpass_info, VK_SUBPASS_CONTENTS_INLINE);
+        if (pApp->depth_prepass) {
+            record_bucket(pApp, command_buffer, COMMAND_BUCKET_DEPTH_PREPASS);
+        }
+        record_bucket(pApp, command_buffer, COMMAND_BUCKET_MAIN);
+        // the sprites stream their own instances every frame, they are not in the capture
+        if (has_sprites(pApp)) {
+            record_bucket(pApp, command_buffer, COMMAND_BUCKET_SPRITES);
+        }
+        if (capturing) {
+            capture_frame_end(pApp);
+        }
+    }
+
+    vkCmdEndRenderPass(command_buffer);
+
+    if (pApp->gpu_timestamps) {
+        vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, pApp->vk_timestamp_pool,
+                            first_query + 1);
+    }
+    if (pApp->post != NULL) {
+        record_post(pApp, command_buffer, image_index);
+    }
+    if (pApp->gpu_timestamps) {
+        vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, pApp->vk_timestamp_pool,
+                            first_query + 2);
+    }
+
+    if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
+        printf("Failed to record the command buffer!\n");
+        exit(1);
+    }
+}
+
+// What goes inside the render pass, one bucket at a time. Inline in the primary command buffer, or in a secondary one
+// that the command cache keeps. The dynamic states are not inherited by secondaries, every bucket sets its own
+void record_bucket(App* pApp, VkCommandBuffer command_buffer, CommandBucketId bucket)
+{
+    // the dynamic states
+    VkViewport viewport = {
+        .x = 0.0f,
+        .y = 0.0f,
+        .width = (f32)pApp->vk_extent.width,
+        .height = (f32)pApp->vk_extent.height,
+        .minDepth = 0.0f,
+        .maxDepth = 1.0f,
+    };
+    vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+
+    // set the scissor. Any pixel outside the scissor will not be considered for the rasterizer
+    VkRect2D scissor = {
+        .offset = {0, 0},
+        .extent = pApp->vk_extent,
+    };
+    vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+
+    if (bucket == COMMAND_BUCKET_SPRITES) {
+        record_sprites(pApp, command_buffer);
+        return;
+    }
+
+    // with the prepass, lay down the depth first, then shade only what survived it. Same subpass, the depth tests
+    // are ordered
+    VkPipeline pipeline = pApp->vk_pipeline;
+    if (bucket == COMMAND_BUCKET_DEPTH_PREPASS) {
+        pipeline = pApp->vk_depth_prepass_pipeline;
+    } else if (pApp->depth_prepass) {
+        pipeline = pApp->vk_equal_pipeline;
+    }
+    bind_lighting(pApp, command_buffer);
+    cmd_bind_pipeline(pApp, command_buffer, pipeline);
+    record_draws(pApp, command_buffer);
+}
+
+void record_draws(App* pApp, VkCommandBuffer command_buffer)
+{
+    if (pApp->draw.mesh != NULL) {
+        record_mesh_draws(pApp, command_buffer, pApp->vk_pipeline_layout, pApp->draw.mesh, &pApp->draw);
+        return;
+    }
+
+    // each draw call starts where the previous one ended, so they do not all land on the same vertices
+    for (u32 i = 0; i < pApp->draw.draw_call_count; i += 1) {
+        cmd_draw(pApp, command_buffer, pApp->draw.vertex_count, pApp->draw.instance_count, i * pApp->draw.vertex_count,
+                 0);
+    }
+}
+
+void draw_frame(App* pApp)
+{
+    u32 frame = pApp->current_frame;
+    VkCommandBuffer command_buffer = pApp->vk_command_buffers[frame];
+
+    // wait until the GPU is done with this frame's command buffer
+    f64 wait_start = now_ms();
+    wait_timeline_value(pApp, pApp->frame_timeline_values[frame]);
+
+    u32 image_index = frame; // headless there is one offscreen image per frame in flight
+    f64 acquire_start = now_ms();
+    if (!pApp->headless) {
+        vkAcquireNextImageKHR(pApp->vk_device, pApp->vk_swapchain, UINT64_MAX,
+                              pApp->vk_image_available_semaphores[frame], VK_NULL_HANDLE, &image_index);
+    }
+    f64 acquire_end = now_ms();
+    pApp->frame_acquire_ms = acquire_end - acquire_start;
+    pApp->frame_wait_ms = acquire_end - wait_start;
+
+    read_frame_timestamps(pApp, frame);
+
+    collect_retired(pApp);
+
+    update_memory_stats(pApp);
+
+    if (!pApp->timeline_semaphores) {
+        vkResetFences(pApp->vk_device, 1, &pApp->vk_in_flight_fences[frame]);
+    }
+
+    // the frame slot is free, so is its region of the lights. The replay writes the captured ones when recording
+    if (pApp->replay == NULL) {
+        write_lights(pApp);
+    }
+
+    f64 record_start = now_ms();
+    vkResetCommandBuffer(command_buffer, 0);
+    record_commandbuffer(pApp, command_buffer, image_index);
+    pApp->frame_record_ms = now_ms() - record_start;
+
+    // the swapchain image is first written by the render pass, or by the post chain after it
+    VkPipelineStageFlags wait_stages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+    if (pApp->post != NULL) {
+        wait_stages[0] = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+    }
+    VkSubmitInfo submit_info = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &command_buffer,
+    };
+    // the acquire and the present only take binary semaphores, the timeline one is signaled next to them
+    u64 signal_value = pApp->timeline_value + 1;
+    VkSemaphore signal_semaphores[2];
+    u64 signal_values[2];
+    u32 signal_count = 0;
+    if (!pApp->headless) {
+        submit_info.waitSemaphoreCount = 1;
+        submit_info.pWaitSemaphores = &pApp->vk_image_available_semaphores[frame];
+        submit_info.pWaitDstStageMask = wait_stages;
+        signal_semaphores[signal_count] = pApp->vk_render_finished_semaphores[image_index];
+        signal_values[signal_count++] = 0; // ignored for binary semaphores
+    }
+    VkFence fence = pApp->vk_in_flight_fences[frame];
+    u64 wait_value = 0;
+    VkTimelineSemaphoreSubmitInfo timeline_info = {
+        .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+        .waitSemaphoreValueCount = submit_info.waitSemaphoreCount,
+        .pWaitSemaphoreValues = &wait_value,
+    };
+    if (pApp->timeline_semaphores) {
+        signal_semaphores[signal_count] = pApp->vk_timeline_semaphore;
+        signal_values[signal_count++] = signal_value;
+        timeline_info.signalSemaphoreValueCount = signal_count;
+        timeline_info.pSignalSemaphoreValues = signal_values;
+        submit_info.pNext = &timeline_info;
+        fence = VK_NULL_HANDLE;
+    }
+    submit_info.signalSemaphoreCount = signal_count;
+    submit_info.pSignalSemaphores = signal_semaphores;
+
+    if (vkQueueSubmit(pApp->vk_graphics_queue, 1, &submit_info, fence) != VK_SUCCESS) {
+        printf("Failed to submit the draw command buffer!\n");
+        exit(1);
+    }
+    count_metric(&pApp->metrics, COUNTER_SUBMISSIONS);
+    pApp->timestamps_written[frame] = pApp->gpu_timestamps;
+    pApp->timeline_value = signal_value;
+    pApp->frame_timeline_values[frame] = signal_value;
+
+    if (!pApp->headless) {
+        VkPresentInfoKHR present_info = {
+            .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
+            .waitSemaphoreCount = 1,
+            .pWaitSemaphores = &pApp->vk_render_finished_semaphores[image_index],
+            .swapchainCount = 1,
+            .pSwapchains = &pApp->vk_swapchain,
+            .pImageIndices = &image_index,
+        };
+        f64 present_start = now_ms();
+        vkQueuePresentKHR(pApp->vk_present_queue, &present_info);
+        pApp->frame_present_ms = now_ms() - present_start;
+    }
+
+    if (pApp->frame_count == 0) {
+        pApp->first_frame_ms = now_ms() - pApp->init_start_ms;
+        atomic_store(&pApp->metrics.first_frame_ns, (u64)(pApp->first_frame_ms * 1000000.0));
+        printf("First frame presented %.2f ms after the start (init %.2f ms, its longest chain %.2f ms)\n",
+               pApp->first_frame_ms, pApp->init_ms, pApp->init_critical_path_ms);
+    }
+
+    pApp->current_frame = (frame + 1) % MAX_FRAMES_IN_FLIGHT;
+    pApp->frame_count += 1;
+}
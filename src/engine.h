@@ -0,0 +1,548 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include <pthread.h>
+#include <vulkan/vk_platform.h>
+#include <vulkan/vulkan_core.h>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include "types.h"
+#include "memory.h"
+#include "metrics.h"
+
+#define MAX_FRAMES_IN_FLIGHT 2
+// the start of the frame, the end of the render pass and the end of the frame
+#define FRAME_TIMESTAMPS 3
+
+extern const char* WIN_TITLE;
+extern const u32 WIN_WIDTH;
+extern const u32 WIN_HEIGHT;
+
+extern const u32 validation_layers_count;
+extern const u32 device_extensions_count;
+extern const char* validation_layers[];
+extern const char* device_extensions[];
+
+extern const bool enable_validation_layers;
+
+// the steps of the startup on the main thread, in order. Each one is timed so we can see where the startup goes
+typedef enum InitStage
+{
+    INIT_STAGE_WINDOW,
+    INIT_STAGE_INSTANCE,
+    INIT_STAGE_DEBUG_MESSENGER,
+    INIT_STAGE_SURFACE,
+    INIT_STAGE_PICK_DEVICE,
+    INIT_STAGE_LOGICAL_DEVICE,
+    INIT_STAGE_COMMANDPOOL,
+    INIT_STAGE_RENDERPASS,
+    INIT_STAGE_LOAD_MESH,
+    INIT_STAGE_SWAPCHAIN,
+    INIT_STAGE_IMAGEVIEWS,
+    INIT_STAGE_COLOR_RESOURCES,
+    INIT_STAGE_DEPTH_RESOURCES,
+    INIT_STAGE_FRAMEBUFFERS,
+    INIT_STAGE_COMMANDS,
+    INIT_STAGE_SYNC_OBJECTS,
+    INIT_STAGE_GRAPHICSPIPELINE, // only waits for INIT_TASK_PIPELINES
+    INIT_STAGE_COUNT,
+} InitStage;
+
+extern const char* init_stage_names[INIT_STAGE_COUNT];
+
+// The parts of the startup that run on their own thread, next to the main one. A task only depends on tasks before it
+typedef enum InitTaskId
+{
+    INIT_TASK_MESH_IO,   // maps and checks the mesh file, no device needed
+    INIT_TASK_SHADER_IO, // reads the scene shaders, it needs the vertex format of the mesh
+    INIT_TASK_PIPELINES, // the shader modules and the scene pipelines, once the render pass exists
+    INIT_TASK_COUNT,
+} InitTaskId;
+
+extern const char* init_task_names[INIT_TASK_COUNT];
+
+typedef struct App App;
+
+typedef struct InitTask InitTask;
+struct InitTask {
+    void (*run)(App* pApp);
+    App* pApp;
+    u32 depends;     // 1 << InitTaskId of the tasks it waits for before running
+    i32 after_stage; // the InitStage it was started after, -1 when it needs nothing from the main thread
+    pthread_t thread;
+    bool started;
+    bool done; // under App.init_mutex
+    f64 start_ms;
+    f64 end_ms;
+};
+
+// Structs
+typedef struct QueueFamilyIndices QueueFamilyIndices;
+struct QueueFamilyIndices {
+    u32 graphics_family;
+    u8 is_graphics_family_set; // HACK: mimic the optional in C++?
+    u32 present_family;
+    u8 is_present_family_set; // HACK: mimic the optional in C++?
+    u8 is_complete;
+};
+
+typedef struct Shader Shader;
+struct Shader {
+    char* binary;
+    u32 size;
+};
+
+// typedef struct SwapChainSupportDetails SwapChainSupportDetails;
+// struct SwapChainSupportDetails {
+//     VkSurfaceCapabilitiesKHR capabilities;
+//     VkSurfaceFormatKHR format;
+//     VkPresentModeKHR present_mode;
+// };
+
+// How a pipeline uses the depth buffer. Depth is reversed-Z: cleared to 0.0 (far), nearer is bigger
+typedef enum DepthMode
+{
+    DEPTH_MODE_TEST_WRITE, // the normal pass: GREATER_OR_EQUAL test and write
+    DEPTH_MODE_PREPASS,    // depth only, no fragment shader and no color writes
+    DEPTH_MODE_EQUAL,      // after a prepass: only the visible fragment passes, no depth write
+} DepthMode;
+
+// The vertex input of a pipeline. The hardcoded triangle has none
+#define MAX_VERTEX_ATTRIBUTES 4
+typedef struct VertexLayout VertexLayout;
+struct VertexLayout {
+    VkVertexInputBindingDescription binding;
+    VkVertexInputAttributeDescription attributes[MAX_VERTEX_ATTRIBUTES];
+    u32 attribute_count;
+};
+
+typedef struct Mesh Mesh;                     // see mesh.h
+typedef struct MeshFile MeshFile;             // see mesh.h
+typedef struct SpriteRenderer SpriteRenderer; // see sprites.h
+typedef struct Capture Capture;               // see capture.h
+typedef struct Replay Replay;                 // see capture.h
+typedef struct PostChain PostChain;           // see post.h
+typedef struct Lighting Lighting;             // see lighting.h
+
+// The shaders of the scene pipelines and the vertex input that goes with them, read before the pipelines are built.
+// The binaries are freed once the modules exist, the rest is kept to specialize more variants
+typedef struct SceneShaders SceneShaders;
+struct SceneShaders {
+    const char* vert_filename;
+    const char* frag_filename;
+    Shader vert;
+    Shader frag;
+    bool has_vertex_input; // false for the hardcoded triangle
+    VertexLayout vertex_layout;
+    bool octahedral_normals; // the packed mesh formats
+};
+
+// The specialization constants of the shaders (layout(constant_id = N)), one id space for all of them. A shader
+// ignores the ids it does not declare. Bools are 32 bits, like VkBool32
+typedef enum ShaderConstantId
+{
+    SHADER_CONSTANT_OCTAHEDRAL_NORMALS, // mesh.vert: the normals are octahedral encoded
+    SHADER_CONSTANT_LIGHTING,           // shader.frag: the sun and the point lights, or only the vertex colors
+    SHADER_CONSTANT_COUNT,
+} ShaderConstantId;
+
+typedef struct ShaderConstants ShaderConstants;
+struct ShaderConstants {
+    u32 values[SHADER_CONSTANT_COUNT];
+};
+
+typedef struct ShaderModuleEntry ShaderModuleEntry;
+struct ShaderModuleEntry {
+    char* filename;
+    VkShaderModule module;
+};
+
+typedef struct PipelineVariant PipelineVariant;
+struct PipelineVariant {
+    // the key
+    VkShaderModule vert_module;
+    VkShaderModule frag_module;
+    bool has_vertex_input;
+    VertexLayout vertex_layout;
+    DepthMode depth_mode;
+    ShaderConstants constants;
+
+    VkPipeline pipeline;
+    u32 pins; // borrowers that hold the handle outside the App, the trim keeps it while > 0
+};
+
+// One shader module per SPIR-V file, and one pipeline per combination of modules, vertex input, depth mode and
+// constant values. The driver folds the constants, so a feature toggle costs a pipeline, not a branch in the shader
+typedef struct ShaderVariants ShaderVariants;
+struct ShaderVariants {
+    ShaderModuleEntry* modules;
+    u32 module_count;
+    u32 module_capacity;
+    PipelineVariant* pipelines;
+    u32 pipeline_count;
+    u32 pipeline_capacity;
+    u64 hits; // lookups that found the pipeline already there
+};
+
+// What record_commandbuffer draws every frame. The default is the single hardcoded triangle.
+typedef struct DrawParams DrawParams;
+struct DrawParams {
+    u32 vertex_count;
+    u32 instance_count;
+    u32 draw_call_count;
+    const Mesh* mesh; // when set, the mesh is drawn indexed and vertex_count is ignored
+};
+
+// What the recorded commands depend on. Each one has a version, bumped when it changes
+typedef enum CacheContent
+{
+    CACHE_CONTENT_SCENE,     // the DrawParams and whatever they point to (the mesh)
+    CACHE_CONTENT_PIPELINES, // the pipeline handles
+    CACHE_CONTENT_TARGETS,   // the render pass and the extent
+    CACHE_CONTENT_STATE,     // render state toggles, like the depth prepass
+    CACHE_CONTENT_SPRITES,   // the sprite batches and pipelines
+    CACHE_CONTENT_COUNT,
+} CacheContent;
+
+// The parts of the render pass that get their own secondary command buffers
+typedef enum CommandBucketId
+{
+    COMMAND_BUCKET_DEPTH_PREPASS,
+    COMMAND_BUCKET_MAIN,
+    COMMAND_BUCKET_SPRITES,
+    COMMAND_BUCKET_COUNT,
+} CommandBucketId;
+
+typedef struct CommandBucket CommandBucket;
+struct CommandBucket {
+    u32 depends; // 1 << CacheContent of everything it is recorded from
+    // one per frame in flight: re-recording only touches the one whose frame the GPU is done with
+    VkCommandBuffer command_buffers[MAX_FRAMES_IN_FLIGHT];
+    bool recorded[MAX_FRAMES_IN_FLIGHT];
+    u64 recorded_versions[MAX_FRAMES_IN_FLIGHT][CACHE_CONTENT_COUNT];
+};
+
+// Static content is recorded once in secondary command buffers and executed every frame until something it depends
+// on changes. The primary command buffer is only the render pass around them
+typedef struct CommandCache CommandCache;
+struct CommandCache {
+    u64 versions[CACHE_CONTENT_COUNT];
+    CommandBucket buckets[COMMAND_BUCKET_COUNT];
+
+    // what the versions were bumped for, to catch the changes made straight to the App
+    DrawParams draw;
+    VkPipeline pipelines[3];
+    VkRenderPass renderpass;
+    VkExtent2D extent;
+    bool depth_prepass;
+
+    u64 record_count;  // secondary command buffers recorded
+    u64 execute_count; // and executed
+
+    // memory pressure: 1 << frame of the frame slots whose idle buckets are released at their next frame
+    u32 trim_frames;
+};
+
+// What retire_handle can destroy later
+typedef enum RetiredKind
+{
+    RETIRED_BUFFER,
+    RETIRED_IMAGE,
+    RETIRED_IMAGE_VIEW,
+    RETIRED_MEMORY, // goes back through free_memory, so the memory stats stay right
+    RETIRED_PIPELINE,
+    RETIRED_SHADER_MODULE,
+    RETIRED_FRAMEBUFFER,
+} RetiredKind;
+
+typedef union RetiredObject RetiredObject;
+union RetiredObject {
+    VkBuffer buffer;
+    VkImage image;
+    VkImageView image_view;
+    VkDeviceMemory memory;
+    VkPipeline pipeline;
+    VkShaderModule shader_module;
+    VkFramebuffer framebuffer;
+};
+
+typedef struct RetiredHandle RetiredHandle;
+struct RetiredHandle {
+    RetiredKind kind;
+    RetiredObject object;
+    u64 timeline_value; // the last submission that may use it
+};
+
+// Handles replaced at runtime wait here until the GPU is past the last submission that used them, instead of a
+// vkDeviceWaitIdle. draw_frame collects what is done every frame
+typedef struct DeletionQueue DeletionQueue;
+struct DeletionQueue {
+    RetiredHandle* handles;
+    u32 count;
+    u32 capacity;
+    u64 retired_count;
+    u64 destroyed_count;
+};
+
+struct App {
+    GLFWwindow* window;
+    bool headless; // no window, no surface, no swapchain. We render to offscreen images instead
+    bool force_vulkan_1_0; // set before init_vulkan, to stay on the fences even when timeline semaphores are there
+    u32 vk_api_version;    // what the instance was created with: 1.3 when the loader has it, 1.0 otherwise
+    VkInstance vk_instance;
+    VkDebugUtilsMessengerEXT vk_debugmessenger;
+    VkSurfaceKHR vk_surface;
+    VkPhysicalDevice vk_physical_device;
+    QueueFamilyIndices vk_queue_family_indices;
+    VkQueue vk_graphics_queue;
+    VkQueue vk_present_queue;
+    VkDevice vk_device; // logical device
+    VkSwapchainKHR vk_swapchain;
+    VkImage* vk_images;
+    VkDeviceMemory* vk_offscreen_memories; // only when headless, the swapchain owns its images memory
+    u32 vk_image_count;
+    VkFormat vk_format;
+    VkFormat vk_scene_format; // what the render pass draws into: vk_format, or the HDR target of the post chain
+    VkExtent2D vk_extent;
+    VkImageView* vk_imageviews;
+    u32 requested_msaa_samples; // set before init_vulkan. 0 is the default (4x), 1 disables MSAA
+    VkSampleCountFlagBits vk_msaa_samples;
+    VkImage vk_color_image; // the multisampled target, resolved into the swapchain image at the end of the pass
+    VkDeviceMemory vk_color_memory;
+    VkImageView vk_color_imageview;
+    VkFormat vk_depth_format;
+    VkImage vk_depth_image; // transient too, it is not needed after the pass
+    VkDeviceMemory vk_depth_memory;
+    VkImageView vk_depth_imageview;
+    VkRenderPass vk_renderpass;
+    VkPipelineLayout vk_pipeline_layout;
+    VkPipeline vk_pipeline;
+    VkPipeline vk_depth_prepass_pipeline;
+    VkPipeline vk_equal_pipeline; // the main pass when the prepass already laid down the depth
+    VkFramebuffer* vk_framebuffers;
+    VkCommandPool vk_command_pool;
+    VkCommandBuffer vk_command_buffers[MAX_FRAMES_IN_FLIGHT];
+    bool disable_command_cache; // set before init_vulkan, to record everything inline every frame
+    CommandCache command_cache;
+    DeletionQueue deletion_queue;
+    bool reload_requested; // F5, the pipelines are rebuilt from the shaders on disk at the next frame
+    bool disable_lighting; // F6, the scene pipelines are specialized without the lights
+    bool variants_requested; // the scene pipelines are picked again at the next frame
+    ShaderVariants shader_variants;
+    SceneShaders scene_shaders;
+    VkSemaphore vk_image_available_semaphores[MAX_FRAMES_IN_FLIGHT];
+    VkSemaphore* vk_render_finished_semaphores; // one per swapchain image
+    VkFence vk_in_flight_fences[MAX_FRAMES_IN_FLIGHT]; // only without timeline semaphores
+
+    // The Vulkan 1.2+ path: one timeline semaphore on the graphics queue counts the submissions, every submission
+    // signals the next value. Without it the same values are tracked with the frame fences
+    bool timeline_semaphores;
+    VkSemaphore vk_timeline_semaphore;
+    PFN_vkWaitSemaphores vk_wait_semaphores;
+    PFN_vkGetSemaphoreCounterValue vk_get_semaphore_counter_value;
+    u64 timeline_value;           // signaled by the last submission
+    u64 completed_timeline_value; // the GPU is known to be past it
+    u64 frame_timeline_values[MAX_FRAMES_IN_FLIGHT]; // signaled by the last submission of each frame in flight
+    u32 current_frame;
+    u64 frame_count;
+
+    MemoryTracker memory; // every device allocation, and the budget of the heaps
+    Metrics metrics;      // the frame time histograms, and their exporter
+
+    // GPU frame times: timestamps at the start and at the end of each frame's command buffer, and between the render
+    // pass and the post chain, FRAME_TIMESTAMPS queries per frame in flight. Read back once the frame slot is waited
+    // for, so it never stalls
+    bool gpu_timestamps; // the graphics queue has timestamps
+    VkQueryPool vk_timestamp_pool;
+    f64 timestamp_period_ns;
+    u64 timestamp_mask; // the valid bits of a timestamp
+    bool timestamps_written[MAX_FRAMES_IN_FLIGHT];
+    f64 frame_gpu_ms; // of the frame read back last, -1 when it had no timestamps
+
+    const char* mesh_filename; // a mesh cooked by meshcook, set before init_vulkan. NULL draws the triangle
+    Mesh* mesh;
+
+    SpriteRenderer* sprites; // NULL until create_sprite_renderer
+
+    // the compute post processing chain (see post.h). Requested before init_vulkan, false again when the device
+    // cannot run it. The tonemap writes the swapchain images directly, or an image blitted into them
+    bool post_processing;
+    bool post_storage_output;
+    PostChain* post;
+
+    // the clustered point lights (see lighting.h), binned by a compute pass before the render pass of every frame
+    u32 light_count; // set before init_vulkan, 0 is LIGHT_DEFAULT_COUNT
+    Lighting* lighting;
+
+    // the command stream capture (see capture.h): the file is set before init_vulkan, the capture is NULL again once
+    // its frames are written. The replay, when set, is drawn instead of the scene
+    const char* capture_filename;
+    u32 capture_frame_count; // 0 is CAPTURE_DEFAULT_FRAMES
+    Capture* capture;
+    Replay* replay;
+
+    // the startup tasks (see start_init_tasks), and what they hand over to the main thread
+    bool init_started;
+    pthread_mutex_t init_mutex;
+    pthread_cond_t init_cond;
+    InitTask init_tasks[INIT_TASK_COUNT];
+    MeshFile* mesh_file;
+
+    DrawParams draw;
+    bool depth_prepass; // can be toggled at any frame, to see what it buys on overdraw heavy scenes
+
+    // timings
+    f64 init_start_ms; // when start_init_tasks ran, everything below is relative to it
+    f64 init_stage_ms[INIT_STAGE_COUNT];
+    f64 init_wait_ms[INIT_STAGE_COUNT]; // the part of the stage spent blocked on a task
+    u32 init_stage_waits[INIT_STAGE_COUNT]; // 1 << InitTaskId of the tasks the stage waited for
+    f64 init_ms;                            // init_vulkan done
+    f64 init_critical_path_ms; // the longest chain of dependent work: the best the startup can do on enough cores
+    f64 first_frame_ms;        // the first frame was submitted and presented
+    f64 frame_wait_ms;    // time the last draw_frame spent blocked on the fence and the acquire
+    f64 frame_acquire_ms; // the acquire part of it
+    f64 frame_present_ms; // time the last draw_frame spent in the present
+    f64 frame_record_ms;  // time the last draw_frame spent recording commands
+};
+
+// declarations
+void init_window(App* pApp);
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
+void init_vulkan(App* pApp);
+void main_loop(App* pApp);
+void cleanup(App* pApp);
+
+// time helpers, and the percentiles of the frame time samples (bench and replay)
+f64 now_ms(void);
+f64 record_init_stage(App* pApp, InitStage stage, f64 start_ms);
+int compare_f64(const void* a, const void* b);
+f64 percentile(const f64* sorted, u32 count, f64 p);
+
+// startup tasks (init_tasks.c)
+void start_init_tasks(App* pApp);
+void start_init_task(App* pApp, InitTaskId id, void (*run)(App* pApp), u32 depends, i32 after_stage);
+void wait_init_task(App* pApp, InitTaskId id);
+void wait_init_task_in_stage(App* pApp, InitStage stage, InitTaskId id);
+void finish_init_tasks(App* pApp);
+f64 compute_init_critical_path(App* pApp);
+void run_mesh_io_task(App* pApp);
+void run_shader_io_task(App* pApp);
+void run_pipelines_task(App* pApp);
+
+void create_instance(App* pApp);
+
+// debug messenger
+VkResult CreateDebugUtilsMessengerEXT(VkInstance instance, const VkDebugUtilsMessengerCreateInfoEXT* pCreateInfo,
+                                      const VkAllocationCallbacks* pAllocator,
+                                      VkDebugUtilsMessengerEXT* pDebugMessenger);
+
+void DestroyDebugUtilsMessengerEXT(VkInstance instance, VkDebugUtilsMessengerEXT debugMessenger,
+                                   const VkAllocationCallbacks* pAllocator);
+
+VKAPI_ATTR VkBool32 VKAPI_CALL debug_callback(VkDebugUtilsMessageSeverityFlagBitsEXT message_severity,
+                                              VkDebugUtilsMessageTypeFlagsEXT message_type,
+                                              const VkDebugUtilsMessengerCallbackDataEXT* pcallback_data,
+                                              void* puser_data);
+
+void setup_debug_messenger(App* pApp);
+void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT* create_info);
+
+void create_surface(App* pApp);
+
+u32 rate_device_suitability(VkPhysicalDevice device);
+bool check_timeline_support(App* pApp);
+void pick_graphics_card(App* pApp);
+QueueFamilyIndices find_families_queue(VkPhysicalDevice device, VkSurfaceKHR surface);
+
+void get_unique_values(u32* array, u32 n, u32* unique_array,
+                       u32* unique_values_count); // HACK: like set in C++ but much much worse
+void create_logical_device(App* pApp);
+
+u32 clamp_u32(u32 value, u32 min, u32 max);
+void create_swapchain(App* pApp);
+void create_offscreen_targets(App* pApp);
+void create_imageviews(App* pApp);
+VkSampleCountFlagBits choose_msaa_samples(App* pApp);
+void create_color_resources(App* pApp);
+VkFormat find_depth_format(App* pApp);
+void create_depth_resources(App* pApp);
+
+void create_image(App* pApp, VkExtent2D extent, VkFormat format, VkSampleCountFlagBits samples,
+                  VkImageUsageFlags usage, VkImage* image, VkDeviceMemory* memory);
+VkImageView create_image_view(App* pApp, VkImage image, VkFormat format, VkImageAspectFlags aspect);
+bool try_find_memory_type(App* pApp, u32 type_filter, VkMemoryPropertyFlags properties, u32* memory_type);
+u32 find_memory_type(App* pApp, u32 type_filter, VkMemoryPropertyFlags properties);
+void create_buffer(App* pApp, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+                   MemoryCategory category, VkBuffer* buffer, VkDeviceMemory* memory);
+VkCommandBuffer begin_single_time_commands(App* pApp);
+void end_single_time_commands(App* pApp, VkCommandBuffer command_buffer);
+void copy_buffer(App* pApp, VkBuffer src, VkBuffer dst, VkDeviceSize size);
+
+// GRAPHICS STUFF
+VkShaderModule create_shader_module(App* pApp, char* binary, u32 size);
+Shader read_file(const char* filename);
+
+void create_renderpass(App* pApp);
+void choose_target_formats(App* pApp);
+VkSurfaceFormatKHR choose_surface_format(App* pApp);
+void create_pipeline_layout(App* pApp);
+void create_scene_pipelines(App* pApp);
+void read_scene_shaders(App* pApp);
+void build_scene_pipelines(App* pApp);
+void reload_pipelines(App* pApp);
+VkPipeline create_pipeline(App* pApp, VkShaderModule vert_module, VkShaderModule frag_module,
+                           const VertexLayout* vertex_layout, DepthMode depth_mode, const ShaderConstants* constants);
+void create_framebuffers(App* pApp);
+void create_commandpool(App* pApp);
+void create_commandbuffers(App* pApp);
+void create_sync_objects(App* pApp);
+void create_timestamp_queries(App* pApp);
+void read_frame_timestamps(App* pApp, u32 frame);
+void wait_timeline_value(App* pApp, u64 value);
+u64 get_completed_timeline_value(App* pApp);
+
+void record_commandbuffer(App* pApp, VkCommandBuffer command_buffer, u32 image_index);
+void record_bucket(App* pApp, VkCommandBuffer command_buffer, CommandBucketId bucket);
+void record_draws(App* pApp, VkCommandBuffer command_buffer);
+void draw_frame(App* pApp);
+
+// deferred destruction (deletion_queue.c)
+void retire_handle(App* pApp, RetiredKind kind, RetiredObject object, u64 timeline_value);
+void retire_buffer(App* pApp, VkBuffer buffer);
+void retire_image(App* pApp, VkImage image);
+void retire_image_view(App* pApp, VkImageView image_view);
+void retire_memory(App* pApp, VkDeviceMemory memory);
+void retire_pipeline(App* pApp, VkPipeline pipeline);
+void retire_framebuffer(App* pApp, VkFramebuffer framebuffer);
+void collect_retired(App* pApp);
+void destroy_deletion_queue(App* pApp);
+
+// shader variants (shader_variants.c)
+VkShaderModule find_shader_module(App* pApp, const char* filename);
+VkShaderModule add_shader_module(App* pApp, const char* filename, Shader* binary);
+VkPipeline get_pipeline_variant(App* pApp, VkShaderModule vert_module, VkShaderModule frag_module,
+                                const VertexLayout* vertex_layout, DepthMode depth_mode,
+                                const ShaderConstants* constants);
+void pin_pipeline_variant(App* pApp, VkPipeline pipeline);
+void unpin_pipeline_variant(App* pApp, VkPipeline pipeline);
+void clear_shader_variants(App* pApp);
+void trim_shader_variants(App* pApp, u32 heap_index, MemoryPressure pressure, const MemoryStats* stats,
+                          void* user_data);
+void destroy_shader_variants(App* pApp);
+
+// command cache (command_cache.c)
+void create_command_cache(App* pApp);
+void invalidate_commands(App* pApp, CacheContent content);
+void execute_cached_commands(App* pApp, VkCommandBuffer command_buffer);
+void trim_command_cache(App* pApp, u32 heap_index, MemoryPressure pressure, const MemoryStats* stats,
+                        void* user_data);
+
+#endif // ENGINE_H
@@ -0,0 +1,170 @@
+#include "engine.h"
+#include "mesh.h"
+
+// The startup is a small dependency graph instead of one long sequence. The main thread keeps what has to be there
+// (GLFW wants the window on it) and what the device needs in order: instance, device, swapchain, attachments. The file
+// reads and the pipeline compilation, the slow parts, run next to it on their own threads:
+//
+//     main:       window -> instance -> ... -> device -> render pass -> mesh upload -> swapchain -> ... -> join
+//     mesh io:    map the mesh file                                     ^                                  ^
+//     shader io:  (after mesh io) read the shaders                      |                                  |
+//     pipelines:  (after shader io and the render pass) modules and pipelines ------------------------------'
+
+const char* init_task_names[INIT_TASK_COUNT] = {
+    "mesh_io",
+    "shader_io",
+    "pipelines",
+};
+
+void* run_init_task(void* arg)
+{
+    InitTask* task = (InitTask*)arg;
+    App* pApp = task->pApp;
+    for (u32 i = 0; i < INIT_TASK_COUNT; i += 1) {
+        if (task->depends & (1u << i)) {
+            wait_init_task(pApp, (InitTaskId)i);
+        }
+    }
+
+    task->start_ms = now_ms() - pApp->init_start_ms;
+    task->run(pApp);
+    f64 end_ms = now_ms() - pApp->init_start_ms;
+
+    pthread_mutex_lock(&pApp->init_mutex);
+    task->end_ms = end_ms;
+    task->done = true;
+    pthread_cond_broadcast(&pApp->init_cond);
+    pthread_mutex_unlock(&pApp->init_mutex);
+    return NULL;
+}
+
+// Starts the startup work that needs no device: the mesh file and the shaders are read while the window and the
+// device are created. main calls it before init_window, init_vulkan does when nobody did
+void start_init_tasks(App* pApp)
+{
+    if (pApp->init_started) {
+        return;
+    }
+    pApp->init_started = true;
+    pApp->init_start_ms = now_ms();
+    pthread_mutex_init(&pApp->init_mutex, NULL);
+    pthread_cond_init(&pApp->init_cond, NULL);
+
+    start_init_task(pApp, INIT_TASK_MESH_IO, run_mesh_io_task, 0, -1);
+    start_init_task(pApp, INIT_TASK_SHADER_IO, run_shader_io_task, 1u << INIT_TASK_MESH_IO, -1);
+}
+
+void start_init_task(App* pApp, InitTaskId id, void (*run)(App* pApp), u32 depends, i32 after_stage)
+{
+    InitTask* task = &pApp->init_tasks[id];
+    task->run = run;
+    task->pApp = pApp;
+    task->depends = depends;
+    task->after_stage = after_stage;
+    if (pthread_create(&task->thread, NULL, run_init_task, task) != 0) {
+        printf("Failed to start the %s init task!\n", init_task_names[id]);
+        exit(1);
+    }
+    task->started = true;
+}
+
+void wait_init_task(App* pApp, InitTaskId id)
+{
+    pthread_mutex_lock(&pApp->init_mutex);
+    while (!pApp->init_tasks[id].done) {
+        pthread_cond_wait(&pApp->init_cond, &pApp->init_mutex);
+    }
+    pthread_mutex_unlock(&pApp->init_mutex);
+}
+
+// the main thread waiting in one of its stages: the time blocked is not the stage's own work
+void wait_init_task_in_stage(App* pApp, InitStage stage, InitTaskId id)
+{
+    f64 start_ms = now_ms();
+    wait_init_task(pApp, id);
+    pApp->init_wait_ms[stage] += now_ms() - start_ms;
+    pApp->init_stage_waits[stage] |= 1u << id;
+}
+
+// joins the threads and drops what the tasks handed over. Everything they made is in the App by now
+void finish_init_tasks(App* pApp)
+{
+    for (u32 i = 0; i < INIT_TASK_COUNT; i += 1) {
+        if (pApp->init_tasks[i].started) {
+            pthread_join(pApp->init_tasks[i].thread, NULL);
+        }
+    }
+    pthread_cond_destroy(&pApp->init_cond);
+    pthread_mutex_destroy(&pApp->init_mutex);
+    free(pApp->mesh_file);
+    pApp->mesh_file = NULL;
+}
+
+// The earliest init_vulkan could be done with the measured durations if nothing ever waited for a core: the longest
+// chain of dependent work through the stages and the tasks. The startup can't beat it, it is what to compare to
+f64 compute_init_critical_path(App* pApp)
+{
+    f64 stage_end[INIT_STAGE_COUNT] = {0};
+    f64 task_end[INIT_TASK_COUNT] = {0};
+    bool task_placed[INIT_TASK_COUNT] = {0};
+
+    f64 main_end = 0.0;
+    for (i32 stage = -1; stage < INIT_STAGE_COUNT; stage += 1) {
+        // the tasks that can go once this stage is done. Tasks only depend on the tasks before them
+        for (u32 i = 0; i < INIT_TASK_COUNT; i += 1) {
+            const InitTask* task = &pApp->init_tasks[i];
+            if (task_placed[i] || !task->started || task->after_stage > stage) {
+                continue;
+            }
+            f64 ready = task->after_stage >= 0 ? stage_end[task->after_stage] : 0.0;
+            for (u32 j = 0; j < i; j += 1) {
+                if ((task->depends & (1u << j)) && task_end[j] > ready) {
+                    ready = task_end[j];
+                }
+            }
+            task_end[i] = ready + (task->end_ms - task->start_ms);
+            task_placed[i] = true;
+        }
+        if (stage + 1 == INIT_STAGE_COUNT) {
+            break;
+        }
+
+        u32 next = (u32)(stage + 1);
+        f64 ready = main_end;
+        for (u32 i = 0; i < INIT_TASK_COUNT; i += 1) {
+            if ((pApp->init_stage_waits[next] & (1u << i)) && task_placed[i] && task_end[i] > ready) {
+                ready = task_end[i];
+            }
+        }
+        stage_end[next] = ready + (pApp->init_stage_ms[next] - pApp->init_wait_ms[next]);
+        main_end = stage_end[next];
+    }
+
+    f64 critical_path = main_end;
+    for (u32 i = 0; i < INIT_TASK_COUNT; i += 1) {
+        if (task_placed[i] && task_end[i] > critical_path) {
+            critical_path = task_end[i];
+        }
+    }
+    return critical_path;
+}
+
+void run_mesh_io_task(App* pApp)
+{
+    if (pApp->mesh_filename == NULL) {
+        return;
+    }
+    MeshFile* file = (MeshFile*)malloc(sizeof(MeshFile));
+    map_mesh_file(pApp->mesh_filename, file);
+    pApp->mesh_file = file;
+}
+
+void run_shader_io_task(App* pApp)
+{
+    read_scene_shaders(pApp);
+}
+
+void run_pipelines_task(App* pApp)
+{
+    build_scene_pipelines(pApp);
+}
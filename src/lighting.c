@@ -0,0 +1,327 @@
+#include "lighting.h"
+#include "capture.h"
+
+#include <math.h>
+
+// xorshift32, the same lights on every run
+f32 next_light_random(u32* state)
+{
+    u32 x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return (f32)(x >> 8) / 16777216.0f; // [0, 1)
+}
+
+// a saturated color from a hue in [0, 1)
+void hue_to_rgb(f32 hue, f32* rgb)
+{
+    const f32 offsets[3] = {0.0f, 4.0f, 2.0f};
+    for (u32 c = 0; c < 3; c += 1) {
+        f32 k = fmodf(hue * 6.0f + offsets[c], 6.0f);
+        rgb[c] = fminf(fmaxf(fabsf(k - 3.0f) - 1.0f, 0.0f), 1.0f);
+    }
+}
+
+// The demo lights: each one orbits its own point of the view volume
+void create_light_orbits(Lighting* lighting)
+{
+    u32 state = 0x9e3779b9u;
+    for (u32 i = 0; i < lighting->count; i += 1) {
+        LightOrbit* orbit = &lighting->orbits[i];
+        for (u32 k = 0; k < 3; k += 1) {
+            orbit->center[k] = next_light_random(&state) * 2.0f - 1.0f;
+        }
+        orbit->orbit = lighting->radius * (0.5f + next_light_random(&state));
+        orbit->speed = (next_light_random(&state) - 0.5f) * 4.0f;
+        orbit->phase = next_light_random(&state) * 6.2831853f;
+        hue_to_rgb(next_light_random(&state), orbit->color);
+        for (u32 c = 0; c < 3; c += 1) {
+            orbit->color[c] *= LIGHT_INTENSITY;
+        }
+    }
+}
+
+void create_light_buffers(App* pApp, Lighting* lighting)
+{
+    VkDeviceSize size = (VkDeviceSize)MAX_FRAMES_IN_FLIGHT * LIGHT_MAX_COUNT * sizeof(PointLight);
+    VkBufferCreateInfo buffer_info = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = size,
+        .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+    if (vkCreateBuffer(pApp->vk_device, &buffer_info, NULL, &lighting->light_buffer) != VK_SUCCESS) {
+        printf("Failed to create the light buffer!\n");
+        exit(1);
+    }
+
+    // written by the CPU every frame and read once by the binning (and by the fragments, from the cache): host
+    // visible VRAM when there is some
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(pApp->vk_device, lighting->light_buffer, &requirements);
+    VkMemoryPropertyFlags host = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    u32 memory_type;
+    if (!try_find_memory_type(pApp, requirements.memoryTypeBits, host | VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                              &memory_type)) {
+        memory_type = find_memory_type(pApp, requirements.memoryTypeBits, host);
+    }
+    lighting->light_memory = allocate_memory(pApp, requirements.size, memory_type, MEMORY_CATEGORY_STREAMING);
+    vkBindBufferMemory(pApp->vk_device, lighting->light_buffer, lighting->light_memory, 0);
+    if (vkMapMemory(pApp->vk_device, lighting->light_memory, 0, size, 0, (void**)&lighting->mapped) != VK_SUCCESS) {
+        printf("Failed to map the light buffer!\n");
+        exit(1);
+    }
+
+    create_buffer(pApp, CLUSTER_BUFFER_SIZE, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                  MEMORY_CATEGORY_BUFFER, &lighting->cluster_buffer, &lighting->cluster_memory);
+}
+
+// One set per frame in flight: binding 0 is its region of the lights, binding 1 the cluster grid
+void create_lighting_descriptors(App* pApp, Lighting* lighting)
+{
+    VkShaderStageFlags stages = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+    VkDescriptorSetLayoutBinding bindings[] = {
+        {0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, stages, NULL},
+        {1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, stages, NULL},
+    };
+    VkDescriptorSetLayoutCreateInfo layout_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = sizeof(bindings) / sizeof(bindings[0]),
+        .pBindings = bindings,
+    };
+    if (vkCreateDescriptorSetLayout(pApp->vk_device, &layout_info, NULL, &lighting->descriptor_set_layout) !=
+        VK_SUCCESS) {
+        printf("Failed to create the lighting descriptor set layout!\n");
+        exit(1);
+    }
+
+    VkDescriptorPoolSize pool_size = {
+        .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .descriptorCount = 2 * MAX_FRAMES_IN_FLIGHT,
+    };
+    VkDescriptorPoolCreateInfo pool_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .maxSets = MAX_FRAMES_IN_FLIGHT,
+        .poolSizeCount = 1,
+        .pPoolSizes = &pool_size,
+    };
+    if (vkCreateDescriptorPool(pApp->vk_device, &pool_info, NULL, &lighting->descriptor_pool) != VK_SUCCESS) {
+        printf("Failed to create the lighting descriptor pool!\n");
+        exit(1);
+    }
+
+    VkDescriptorSetLayout set_layouts[MAX_FRAMES_IN_FLIGHT];
+    for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; i += 1) {
+        set_layouts[i] = lighting->descriptor_set_layout;
+    }
+    VkDescriptorSetAllocateInfo alloc_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = lighting->descriptor_pool,
+        .descriptorSetCount = MAX_FRAMES_IN_FLIGHT,
+        .pSetLayouts = set_layouts,
+    };
+    if (vkAllocateDescriptorSets(pApp->vk_device, &alloc_info, lighting->descriptor_sets) != VK_SUCCESS) {
+        printf("Failed to allocate the lighting descriptor sets!\n");
+        exit(1);
+    }
+
+    // the regions are 1 MB, far past minStorageBufferOffsetAlignment
+    VkDeviceSize region_size = (VkDeviceSize)LIGHT_MAX_COUNT * sizeof(PointLight);
+    for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; i += 1) {
+        VkDescriptorBufferInfo light_info = {
+            .buffer = lighting->light_buffer,
+            .offset = i * region_size,
+            .range = region_size,
+        };
+        VkDescriptorBufferInfo cluster_info = {
+            .buffer = lighting->cluster_buffer,
+            .offset = 0,
+            .range = CLUSTER_BUFFER_SIZE,
+        };
+        VkWriteDescriptorSet writes[] = {
+            {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = lighting->descriptor_sets[i],
+                .dstBinding = 0,
+                .descriptorCount = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .pBufferInfo = &light_info,
+            },
+            {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = lighting->descriptor_sets[i],
+                .dstBinding = 1,
+                .descriptorCount = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .pBufferInfo = &cluster_info,
+            },
+        };
+        vkUpdateDescriptorSets(pApp->vk_device, sizeof(writes) / sizeof(writes[0]), writes, 0, NULL);
+    }
+
+    VkPushConstantRange push_constant_range = {
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        .offset = 0,
+        .size = sizeof(ClusterPushConstants),
+    };
+    VkPipelineLayoutCreateInfo pipeline_layout_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 1,
+        .pSetLayouts = &lighting->descriptor_set_layout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &push_constant_range,
+    };
+    if (vkCreatePipelineLayout(pApp->vk_device, &pipeline_layout_info, NULL, &lighting->pipeline_layout) !=
+        VK_SUCCESS) {
+        printf("Failed to create the light binning pipeline layout!\n");
+        exit(1);
+    }
+}
+
+// Before the scene pipeline layout, it takes the descriptor set layout. The binning pipeline comes later, once the
+// pipelines task is done with the shader variants
+void create_lighting(App* pApp)
+{
+    Lighting* lighting = (Lighting*)calloc(1, sizeof(Lighting));
+    pApp->lighting = lighting;
+    lighting->count = pApp->light_count > 0 ? pApp->light_count : LIGHT_DEFAULT_COUNT;
+    if (lighting->count > LIGHT_MAX_COUNT) {
+        printf("%u lights asked for, %u is the most.\n", lighting->count, LIGHT_MAX_COUNT);
+        lighting->count = LIGHT_MAX_COUNT;
+    }
+    // about one light over any point of the volume (8 units): count * 4/3 pi r^3 ~ 8
+    lighting->radius = fminf(fmaxf(1.2f / cbrtf((f32)lighting->count), 0.03f), 0.5f);
+    lighting->orbits = (LightOrbit*)malloc(lighting->count * sizeof(LightOrbit));
+    lighting->start_ms = now_ms();
+    create_light_orbits(lighting);
+
+    create_light_buffers(pApp, lighting);
+    create_lighting_descriptors(pApp, lighting);
+    printf("Lighting created: %u point lights of radius %.3f, %u clusters (%ux%ux%u).\n", lighting->count,
+           lighting->radius, CLUSTER_COUNT, CLUSTER_X, CLUSTER_Y, CLUSTER_Z);
+}
+
+// the module goes through the shader variants, so a reload (F5) reads it again
+void create_lighting_pipeline(App* pApp)
+{
+    Lighting* lighting = pApp->lighting;
+    const char* filename = "build/shaders/cluster_lights.spv";
+    VkShaderModule module = find_shader_module(pApp, filename);
+    if (module == VK_NULL_HANDLE) {
+        Shader binary = read_file(filename);
+        module = add_shader_module(pApp, filename, &binary);
+    }
+    lighting->module = module;
+    lighting->pipeline = build_light_binning_pipeline(pApp, module);
+}
+
+// the replay builds it from the shader of the capture
+VkPipeline build_light_binning_pipeline(App* pApp, VkShaderModule module)
+{
+    VkComputePipelineCreateInfo pipeline_info = {
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .stage =
+            {
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+                .module = module,
+                .pName = "main",
+            },
+        .layout = pApp->lighting->pipeline_layout,
+    };
+    VkPipeline pipeline;
+    if (vkCreateComputePipelines(pApp->vk_device, VK_NULL_HANDLE, 1, &pipeline_info, NULL, &pipeline) != VK_SUCCESS) {
+        printf("Failed to create the light binning pipeline!\n");
+        exit(1);
+    }
+    return pipeline;
+}
+
+void destroy_lighting(App* pApp)
+{
+    Lighting* lighting = pApp->lighting;
+    VkDevice device = pApp->vk_device;
+    vkDestroyPipeline(device, lighting->pipeline, NULL);
+    vkDestroyPipelineLayout(device, lighting->pipeline_layout, NULL);
+    vkDestroyDescriptorPool(device, lighting->descriptor_pool, NULL);
+    vkDestroyDescriptorSetLayout(device, lighting->descriptor_set_layout, NULL);
+    vkDestroyBuffer(device, lighting->cluster_buffer, NULL);
+    free_memory(pApp, lighting->cluster_memory);
+    vkUnmapMemory(device, lighting->light_memory);
+    vkDestroyBuffer(device, lighting->light_buffer, NULL);
+    free_memory(pApp, lighting->light_memory);
+    free(lighting->orbits);
+    free(lighting);
+    pApp->lighting = NULL;
+}
+
+// The lights of this frame, into its region of the ring. draw_frame already waited for the frame slot, the GPU is
+// done with the region
+void write_lights(App* pApp)
+{
+    Lighting* lighting = pApp->lighting;
+    u32 frame = pApp->current_frame;
+    PointLight* lights = lighting->mapped + (u64)frame * LIGHT_MAX_COUNT;
+    f32 t = (f32)((now_ms() - lighting->start_ms) / 1000.0);
+    for (u32 i = 0; i < lighting->count; i += 1) {
+        const LightOrbit* orbit = &lighting->orbits[i];
+        f32 angle = orbit->phase + orbit->speed * t;
+        f32 r = orbit->orbit;
+        lights[i] = (PointLight){
+            .position = {orbit->center[0] + r * cosf(angle), orbit->center[1] + r * sinf(angle),
+                         orbit->center[2] + 0.5f * r * sinf(0.7f * angle)},
+            .radius = lighting->radius,
+            .color = {orbit->color[0], orbit->color[1], orbit->color[2]},
+        };
+    }
+    lighting->frame_counts[frame] = lighting->count;
+}
+
+// Before the render pass. The cluster grid is shared by the frames: the previous frame's fragments must be done
+// reading it before the binning writes it again, and the binning done before this frame's fragments read it
+void record_light_binning(App* pApp, VkCommandBuffer command_buffer)
+{
+    Lighting* lighting = pApp->lighting;
+    if (pApp->capture != NULL) {
+        capture_light_binning(pApp);
+    }
+    record_light_dispatch(pApp, command_buffer, lighting->pipeline, lighting->frame_counts[pApp->current_frame]);
+}
+
+// the binning of the lights in this frame slot's region, also what the replay records
+void record_light_dispatch(App* pApp, VkCommandBuffer command_buffer, VkPipeline pipeline, u32 light_count)
+{
+    Lighting* lighting = pApp->lighting;
+    u32 frame = pApp->current_frame;
+
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0, 0, NULL, 0, NULL, 0, NULL);
+
+    ClusterPushConstants push_constants = {.light_count = light_count};
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, lighting->pipeline_layout, 0, 1,
+                            &lighting->descriptor_sets[frame], 0, NULL);
+    vkCmdPushConstants(command_buffer, lighting->pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                       sizeof(push_constants), &push_constants);
+    // one workgroup per column of clusters
+    vkCmdDispatch(command_buffer, CLUSTER_X, CLUSTER_Y, 1);
+
+    VkMemoryBarrier barrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+    };
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+                         1, &barrier, 0, NULL, 0, NULL);
+}
+
+// set 0 of the scene pipelines, in every bucket that draws the scene (secondaries do not inherit it). The bucket of
+// a frame slot always binds the set of that slot
+void bind_lighting(App* pApp, VkCommandBuffer command_buffer)
+{
+    Lighting* lighting = pApp->lighting;
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pApp->vk_pipeline_layout, 0, 1,
+                            &lighting->descriptor_sets[pApp->current_frame], 0, NULL);
+}
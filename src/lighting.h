@@ -0,0 +1,97 @@
+#ifndef LIGHTING_H
+#define LIGHTING_H
+
+#include "engine.h"
+
+// Clustered forward lighting for thousands of dynamic point lights. The view volume is cut into a grid of
+// CLUSTER_X x CLUSTER_Y x CLUSTER_Z clusters (froxels: the camera is orthographic, so they are boxes and the depth
+// slices are linear), and every frame a compute pass bins the lights into the clusters they touch:
+//
+//     write_lights (CPU, the frame's region of the ring) -> cluster_lights.comp -> the render pass
+//
+// The binning runs one workgroup per column of clusters: it culls all the lights against the column once, keeps the
+// survivors in shared memory, and splits them between the depth slices of the column. shader.frag then loops over
+// the lights of its own cluster only, at most CLUSTER_MAX_LIGHTS of them, whatever the total.
+//
+// Everything is in the space the scene is placed in (the mesh push constants): x, y and z in [-1, 1], z towards the
+// viewer. The constants below are repeated in the shaders.
+
+#define LIGHT_MAX_COUNT 32768 // per frame
+#define LIGHT_DEFAULT_COUNT 1024
+#define LIGHT_INTENSITY 4.0f
+
+#define CLUSTER_X 16
+#define CLUSTER_Y 12
+#define CLUSTER_Z 16
+#define CLUSTER_COUNT (CLUSTER_X * CLUSTER_Y * CLUSTER_Z)
+#define CLUSTER_MAX_LIGHTS 128         // per cluster, the bound on the cost of a fragment
+#define CLUSTER_COLUMN_MAX_LIGHTS 2048 // the lights of a column the binning keeps in shared memory
+#define CLUSTER_GROUP_SIZE 256
+
+_Static_assert(CLUSTER_GROUP_SIZE % CLUSTER_Z == 0, "the binning splits its workgroup between the depth slices");
+
+// one light as the shaders read it (std430)
+typedef struct PointLight PointLight;
+struct PointLight {
+    f32 position[3];
+    f32 radius; // nothing past it
+    f32 color[3];
+    f32 pad;
+};
+
+_Static_assert(sizeof(PointLight) == 32, "PointLight must match the shaders");
+
+// what write_lights animates a light from
+typedef struct LightOrbit LightOrbit;
+struct LightOrbit {
+    f32 center[3];
+    f32 orbit;
+    f32 speed; // radians per second
+    f32 phase;
+    f32 color[3];
+};
+
+// the cluster grid in one buffer: the count of every cluster, then its CLUSTER_MAX_LIGHTS light indices
+#define CLUSTER_BUFFER_SIZE ((VkDeviceSize)CLUSTER_COUNT * (1 + CLUSTER_MAX_LIGHTS) * sizeof(u32))
+
+typedef struct ClusterPushConstants ClusterPushConstants;
+struct ClusterPushConstants {
+    u32 light_count;
+};
+
+struct Lighting {
+    LightOrbit* orbits;
+    u32 count;
+    f32 radius; // of every light, so that about the same number of them covers a point whatever the count
+    f64 start_ms;
+
+    // the lights: one region of LIGHT_MAX_COUNT per frame in flight, mapped for good. A region is written again only
+    // after the GPU is past the frame that read it
+    VkBuffer light_buffer;
+    VkDeviceMemory light_memory;
+    PointLight* mapped;
+    u32 frame_counts[MAX_FRAMES_IN_FLIGHT];
+
+    // written by the binning, read by the fragments. One for all the frames, the binning waits for the previous ones
+    VkBuffer cluster_buffer;
+    VkDeviceMemory cluster_memory;
+
+    // set 0 of the scene pipeline layout and of the binning, one set per frame in flight (its region of the lights)
+    VkDescriptorSetLayout descriptor_set_layout;
+    VkDescriptorPool descriptor_pool;
+    VkDescriptorSet descriptor_sets[MAX_FRAMES_IN_FLIGHT];
+    VkPipelineLayout pipeline_layout;
+    VkPipeline pipeline;
+    VkShaderModule module; // of the pipeline, for the capture
+};
+
+void create_lighting(App* pApp);
+void create_lighting_pipeline(App* pApp);
+VkPipeline build_light_binning_pipeline(App* pApp, VkShaderModule module);
+void destroy_lighting(App* pApp);
+void write_lights(App* pApp);
+void record_light_binning(App* pApp, VkCommandBuffer command_buffer);
+void record_light_dispatch(App* pApp, VkCommandBuffer command_buffer, VkPipeline pipeline, u32 light_count);
+void bind_lighting(App* pApp, VkCommandBuffer command_buffer);
+
+#endif // LIGHTING_H
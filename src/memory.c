@@ -0,0 +1,205 @@
+#include "memory.h"
+#include "engine.h"
+
+const char* memory_category_names[MEMORY_CATEGORY_COUNT] = {
+    "buffer",
+    "image",
+    "staging",
+    "transient",
+    "streaming",
+};
+
+const char* memory_pressure_names[] = {"none", "high", "critical"};
+
+// needs the physical device, call it once it is picked
+void init_memory_tracker(App* pApp)
+{
+    MemoryTracker* tracker = &pApp->memory;
+
+    vkGetPhysicalDeviceMemoryProperties(pApp->vk_physical_device, &tracker->properties);
+    if (tracker->has_properties2) {
+        // the core name when both the instance and the device are 1.1+, the extension one otherwise: a 1.0 device
+        // must not be used through core 1.1 functions, even from a 1.1+ instance
+        VkPhysicalDeviceProperties device_properties;
+        vkGetPhysicalDeviceProperties(pApp->vk_physical_device, &device_properties);
+        bool core = pApp->vk_api_version >= VK_API_VERSION_1_1 && device_properties.apiVersion >= VK_API_VERSION_1_1;
+        const char* name = core ? "vkGetPhysicalDeviceMemoryProperties2" : "vkGetPhysicalDeviceMemoryProperties2KHR";
+        tracker->get_memory_properties2 =
+            (PFN_vkGetPhysicalDeviceMemoryProperties2KHR)vkGetInstanceProcAddr(pApp->vk_instance, name);
+    }
+    if (tracker->get_memory_properties2 == NULL) {
+        tracker->budget_supported = false;
+    }
+
+    tracker->stats.budget_supported = tracker->budget_supported;
+    tracker->stats.heap_count = tracker->properties.memoryHeapCount;
+    for (u32 i = 0; i < tracker->properties.memoryHeapCount; i += 1) {
+        tracker->stats.heaps[i].size = tracker->properties.memoryHeaps[i].size;
+        tracker->stats.heaps[i].device_local =
+            (tracker->properties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+    }
+    update_memory_stats(pApp);
+
+    printf("Memory budget tracking: %s\n",
+           tracker->budget_supported ? "VK_EXT_memory_budget" : "estimated (no VK_EXT_memory_budget)");
+}
+
+void destroy_memory_tracker(App* pApp)
+{
+    MemoryTracker* tracker = &pApp->memory;
+    for (u32 i = 0; i < tracker->allocation_count; i += 1) {
+        printf("Leaked %llu bytes of %s memory!\n", (unsigned long long)tracker->allocations[i].size,
+               memory_category_names[tracker->allocations[i].category]);
+    }
+    free(tracker->allocations);
+    tracker->allocations = NULL;
+    tracker->allocation_count = 0;
+    tracker->allocation_capacity = 0;
+}
+
+VkDeviceMemory allocate_memory(App* pApp, VkDeviceSize size, u32 memory_type, MemoryCategory category)
+{
+    MemoryTracker* tracker = &pApp->memory;
+
+    VkMemoryAllocateInfo alloc_info = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .allocationSize = size,
+        .memoryTypeIndex = memory_type,
+    };
+    VkDeviceMemory memory;
+    if (vkAllocateMemory(pApp->vk_device, &alloc_info, NULL, &memory) != VK_SUCCESS) {
+        printf("Failed to allocate %llu bytes of %s memory!\n", (unsigned long long)size,
+               memory_category_names[category]);
+        print_memory_stats(&tracker->stats);
+        exit(1);
+    }
+
+    if (tracker->allocation_count == tracker->allocation_capacity) {
+        tracker->allocation_capacity = tracker->allocation_capacity > 0 ? tracker->allocation_capacity * 2 : 32;
+        tracker->allocations = (MemoryAllocation*)realloc(tracker->allocations,
+                                                          tracker->allocation_capacity * sizeof(MemoryAllocation));
+    }
+    u32 heap_index = tracker->properties.memoryTypes[memory_type].heapIndex;
+    tracker->allocations[tracker->allocation_count++] = (MemoryAllocation){
+        .memory = memory,
+        .size = size,
+        .heap_index = heap_index,
+        .category = category,
+    };
+    tracker->stats.heaps[heap_index].engine_usage[category] += size;
+    tracker->stats.heaps[heap_index].allocation_count += 1;
+
+    return memory;
+}
+
+void free_memory(App* pApp, VkDeviceMemory memory)
+{
+    if (memory == VK_NULL_HANDLE) {
+        return;
+    }
+    vkFreeMemory(pApp->vk_device, memory, NULL);
+
+    MemoryTracker* tracker = &pApp->memory;
+    for (u32 i = 0; i < tracker->allocation_count; i += 1) {
+        MemoryAllocation* allocation = &tracker->allocations[i];
+        if (allocation->memory == memory) {
+            tracker->stats.heaps[allocation->heap_index].engine_usage[allocation->category] -= allocation->size;
+            tracker->stats.heaps[allocation->heap_index].allocation_count -= 1;
+            // swap remove, the order does not matter
+            *allocation = tracker->allocations[--tracker->allocation_count];
+            return;
+        }
+    }
+    printf("Freed memory that was not allocated with allocate_memory!\n");
+}
+
+VkDeviceSize engine_heap_usage(const MemoryHeapStats* heap)
+{
+    VkDeviceSize total = 0;
+    for (u32 c = 0; c < MEMORY_CATEGORY_COUNT; c += 1) {
+        total += heap->engine_usage[c];
+    }
+    return total;
+}
+
+// Refreshes the budget and the usage of every heap and fires the callbacks of the heaps whose pressure changed.
+// Called once per frame by draw_frame, the budget query is cheap
+void update_memory_stats(App* pApp)
+{
+    MemoryTracker* tracker = &pApp->memory;
+    MemoryStats* stats = &tracker->stats;
+    stats->frame = pApp->frame_count;
+
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budget = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT,
+    };
+    if (tracker->budget_supported) {
+        VkPhysicalDeviceMemoryProperties2 properties2 = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2,
+            .pNext = &budget,
+        };
+        tracker->get_memory_properties2(pApp->vk_physical_device, &properties2);
+    }
+
+    for (u32 i = 0; i < stats->heap_count; i += 1) {
+        MemoryHeapStats* heap = &stats->heaps[i];
+        VkDeviceSize engine_usage = engine_heap_usage(heap);
+        if (tracker->budget_supported) {
+            heap->budget = budget.heapBudget[i];
+            heap->usage = budget.heapUsage[i];
+        } else {
+            heap->budget = (VkDeviceSize)((f64)heap->size * MEMORY_FALLBACK_BUDGET_FRACTION);
+            heap->usage = engine_usage;
+        }
+
+        f64 fraction = heap->budget > 0 ? (f64)heap->usage / (f64)heap->budget : 0.0;
+        MemoryPressure pressure = MEMORY_PRESSURE_LEVEL_NONE;
+        if (fraction >= MEMORY_PRESSURE_CRITICAL) {
+            pressure = MEMORY_PRESSURE_LEVEL_CRITICAL;
+        } else if (fraction >= MEMORY_PRESSURE_HIGH) {
+            pressure = MEMORY_PRESSURE_LEVEL_HIGH;
+        }
+        if (pressure == heap->pressure) {
+            continue;
+        }
+
+        heap->pressure = pressure;
+        printf("Memory heap %u pressure: %s (%.1f of %.1f MB used, %.1f MB by the engine)\n", i,
+               memory_pressure_names[pressure], (f64)heap->usage / (1024.0 * 1024.0),
+               (f64)heap->budget / (1024.0 * 1024.0), (f64)engine_usage / (1024.0 * 1024.0));
+        for (u32 c = 0; c < tracker->callback_count; c += 1) {
+            tracker->callbacks[c](pApp, i, pressure, stats, tracker->callbacks_user_data[c]);
+        }
+    }
+}
+
+// the callback gets every pressure change of every heap, NONE included when it goes back to normal
+void add_memory_pressure_callback(App* pApp, MemoryPressureCallback callback, void* user_data)
+{
+    MemoryTracker* tracker = &pApp->memory;
+    if (tracker->callback_count == MEMORY_MAX_PRESSURE_CALLBACKS) {
+        printf("Too many memory pressure callbacks!\n");
+        exit(1);
+    }
+    tracker->callbacks[tracker->callback_count] = callback;
+    tracker->callbacks_user_data[tracker->callback_count] = user_data;
+    tracker->callback_count += 1;
+}
+
+void print_memory_stats(const MemoryStats* stats)
+{
+    printf("Memory at frame %llu (%s):\n", (unsigned long long)stats->frame,
+           stats->budget_supported ? "VK_EXT_memory_budget" : "estimated");
+    for (u32 i = 0; i < stats->heap_count; i += 1) {
+        const MemoryHeapStats* heap = &stats->heaps[i];
+        printf("\theap %u%s: %.1f / %.1f MB budget (%.1f MB heap), pressure %s\n", i,
+               heap->device_local ? " (device local)" : "", (f64)heap->usage / (1024.0 * 1024.0),
+               (f64)heap->budget / (1024.0 * 1024.0), (f64)heap->size / (1024.0 * 1024.0),
+               memory_pressure_names[heap->pressure]);
+        printf("\t\tengine: %u allocations,", heap->allocation_count);
+        for (u32 c = 0; c < MEMORY_CATEGORY_COUNT; c += 1) {
+            printf(" %s %.2f MB%s", memory_category_names[c], (f64)heap->engine_usage[c] / (1024.0 * 1024.0),
+                   c + 1 < MEMORY_CATEGORY_COUNT ? "," : "\n");
+        }
+    }
+}
@@ -0,0 +1,101 @@
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <stdbool.h>
+#include <vulkan/vulkan_core.h>
+
+#include "types.h"
+
+// Device memory telemetry. Every allocation of the engine goes through allocate_memory, so we know what we use per
+// heap and per category. With VK_EXT_memory_budget we also know the budget of each heap and what the whole process
+// uses (other allocators, the driver), without it the budget is a guess like VMA does it. The snapshot is refreshed
+// every frame and the pressure callbacks fire when a heap crosses a threshold, so the caches and the streaming can
+// give memory back before the driver starts paging. On HIGH and CRITICAL the command cache releases its idle buckets
+// (trim_command_cache) and the shader variants retire the pipelines the scene does not use (trim_shader_variants).
+
+#define MEMORY_MAX_PRESSURE_CALLBACKS 8
+#define MEMORY_PRESSURE_HIGH 0.80         // fraction of the budget
+#define MEMORY_PRESSURE_CRITICAL 0.95
+#define MEMORY_FALLBACK_BUDGET_FRACTION 0.8 // of the heap size, without VK_EXT_memory_budget
+
+typedef struct App App;
+
+typedef enum MemoryCategory
+{
+    MEMORY_CATEGORY_BUFFER,    // vertex, index, storage buffers
+    MEMORY_CATEGORY_IMAGE,     // images that outlive a pass (swapchain stand-ins, textures)
+    MEMORY_CATEGORY_STAGING,   // host visible upload buffers, short lived
+    MEMORY_CATEGORY_TRANSIENT, // attachments that live inside a pass, maybe never backed on tilers
+    MEMORY_CATEGORY_STREAMING, // persistently mapped buffers rewritten every frame (the sprite ring)
+    MEMORY_CATEGORY_COUNT,
+} MemoryCategory;
+
+extern const char* memory_category_names[MEMORY_CATEGORY_COUNT];
+
+typedef enum MemoryPressure
+{
+    MEMORY_PRESSURE_LEVEL_NONE,
+    MEMORY_PRESSURE_LEVEL_HIGH,     // time to trim the caches
+    MEMORY_PRESSURE_LEVEL_CRITICAL, // the next allocations may page or fail
+} MemoryPressure;
+
+extern const char* memory_pressure_names[];
+
+typedef struct MemoryHeapStats MemoryHeapStats;
+struct MemoryHeapStats {
+    VkDeviceSize size;
+    VkDeviceSize budget; // what the process can use before the driver starts paging
+    VkDeviceSize usage;  // what the whole process uses, the engine included
+    VkDeviceSize engine_usage[MEMORY_CATEGORY_COUNT];
+    u32 allocation_count;
+    bool device_local;
+    MemoryPressure pressure;
+};
+
+// the per frame snapshot
+typedef struct MemoryStats MemoryStats;
+struct MemoryStats {
+    u64 frame;
+    bool budget_supported; // false: budget and usage are estimates
+    u32 heap_count;
+    MemoryHeapStats heaps[VK_MAX_MEMORY_HEAPS];
+};
+
+typedef void (*MemoryPressureCallback)(App* pApp, u32 heap_index, MemoryPressure pressure, const MemoryStats* stats,
+                                       void* user_data);
+
+typedef struct MemoryAllocation MemoryAllocation;
+struct MemoryAllocation {
+    VkDeviceMemory memory;
+    VkDeviceSize size;
+    u32 heap_index;
+    MemoryCategory category;
+};
+
+typedef struct MemoryTracker MemoryTracker;
+struct MemoryTracker {
+    bool has_properties2;  // a 1.1+ instance or VK_KHR_get_physical_device_properties2, set by create_instance
+    bool budget_supported; // and VK_EXT_memory_budget on the device, set by pick_graphics_card
+    PFN_vkGetPhysicalDeviceMemoryProperties2KHR get_memory_properties2;
+    VkPhysicalDeviceMemoryProperties properties;
+
+    MemoryAllocation* allocations;
+    u32 allocation_count;
+    u32 allocation_capacity;
+
+    MemoryStats stats;
+
+    MemoryPressureCallback callbacks[MEMORY_MAX_PRESSURE_CALLBACKS];
+    void* callbacks_user_data[MEMORY_MAX_PRESSURE_CALLBACKS];
+    u32 callback_count;
+};
+
+void init_memory_tracker(App* pApp);
+void destroy_memory_tracker(App* pApp);
+VkDeviceMemory allocate_memory(App* pApp, VkDeviceSize size, u32 memory_type, MemoryCategory category);
+void free_memory(App* pApp, VkDeviceMemory memory);
+void update_memory_stats(App* pApp);
+void add_memory_pressure_callback(App* pApp, MemoryPressureCallback callback, void* user_data);
+void print_memory_stats(const MemoryStats* stats);
+
+#endif // MEMORY_H
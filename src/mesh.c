@@ -0,0 +1,286 @@
+#include "mesh.h"
+#include "capture.h"
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+Mesh* load_mesh(App* pApp, const char* filename)
+{
+    MeshFile file;
+    map_mesh_file(filename, &file);
+    return upload_mesh(pApp, &file);
+}
+
+// a section must be aligned, after the header and inside the file. Overflow safe, the counts come from the file
+void check_mesh_section(const char* filename, const char* name, u64 offset, u64 size, u64 file_size)
+{
+    if (offset % MESH_SECTION_ALIGNMENT != 0 || offset < sizeof(MeshFileHeader) || offset > file_size ||
+        size > file_size - offset) {
+        printf("The %s of the mesh %s are out of the file!\n", name, filename);
+        exit(1);
+    }
+}
+
+// Everything the GPU will fetch through: the sections, the fields that size them, and the indices, which must stay
+// inside the vertices (and the meshlet ones inside their meshlet). A corrupt file stops here instead of reading out
+// of bounds on the GPU. The indices are one linear pass over the mapped file
+void validate_mesh_file(const char* filename, const MeshFileHeader* header, const u8* data, u64 file_size)
+{
+    u32 format = header->vertex_format;
+    u32 expected_stride = 0;
+    if (format == MESH_VERTEX_FORMAT_F32) {
+        expected_stride = sizeof(MeshVertexF32);
+    } else if (format == MESH_VERTEX_FORMAT_SNORM16 || format == MESH_VERTEX_FORMAT_HALF) {
+        expected_stride = sizeof(MeshVertexPacked);
+    } else {
+        printf("The mesh %s has an unknown vertex format %u!\n", filename, format);
+        exit(1);
+    }
+    if (header->vertex_stride != expected_stride) {
+        printf("The mesh %s has vertices of %u bytes, its format has %u!\n", filename, header->vertex_stride,
+               expected_stride);
+        exit(1);
+    }
+    if ((header->index_size != 2 && header->index_size != 4) || header->index_count % 3 != 0) {
+        printf("The mesh %s has bad indices (%u of %u bytes)!\n", filename, header->index_count, header->index_size);
+        exit(1);
+    }
+
+    check_mesh_section(filename, "vertices", header->vertices_offset,
+                       (u64)header->vertex_count * header->vertex_stride, file_size);
+    check_mesh_section(filename, "indices", header->indices_offset, (u64)header->index_count * header->index_size,
+                       file_size);
+    if (header->meshlet_count > 0) {
+        check_mesh_section(filename, "meshlets", header->meshlets_offset,
+                           (u64)header->meshlet_count * sizeof(MeshMeshlet), file_size);
+        check_mesh_section(filename, "meshlet vertices", header->meshlet_vertices_offset,
+                           (u64)header->meshlet_vertex_count * sizeof(u32), file_size);
+        check_mesh_section(filename, "meshlet triangles", header->meshlet_triangles_offset,
+                           (u64)header->meshlet_triangle_count * 3, file_size);
+    }
+
+    u32 max_index = 0;
+    if (header->index_size == 2) {
+        const u16* indices = (const u16*)(data + header->indices_offset);
+        for (u32 i = 0; i < header->index_count; i += 1) {
+            max_index = indices[i] > max_index ? indices[i] : max_index;
+        }
+    } else {
+        const u32* indices = (const u32*)(data + header->indices_offset);
+        for (u32 i = 0; i < header->index_count; i += 1) {
+            max_index = indices[i] > max_index ? indices[i] : max_index;
+        }
+    }
+    if (header->index_count > 0 && max_index >= header->vertex_count) {
+        printf("The mesh %s has index %u past its %u vertices!\n", filename, max_index, header->vertex_count);
+        exit(1);
+    }
+
+    const MeshMeshlet* meshlets = (const MeshMeshlet*)(data + header->meshlets_offset);
+    const u32* meshlet_vertices = (const u32*)(data + header->meshlet_vertices_offset);
+    const u8* meshlet_triangles = data + header->meshlet_triangles_offset;
+    for (u32 m = 0; m < header->meshlet_count; m += 1) {
+        const MeshMeshlet* meshlet = &meshlets[m];
+        if (meshlet->vertex_count > MESHLET_MAX_VERTICES || meshlet->triangle_count > MESHLET_MAX_TRIANGLES ||
+            meshlet->vertex_offset > header->meshlet_vertex_count ||
+            meshlet->vertex_count > header->meshlet_vertex_count - meshlet->vertex_offset ||
+            meshlet->triangle_offset > header->meshlet_triangle_count ||
+            meshlet->triangle_count > header->meshlet_triangle_count - meshlet->triangle_offset) {
+            printf("The meshlet %u of the mesh %s is out of its sections!\n", m, filename);
+            exit(1);
+        }
+        for (u32 v = 0; v < meshlet->vertex_count; v += 1) {
+            if (meshlet_vertices[meshlet->vertex_offset + v] >= header->vertex_count) {
+                printf("The meshlet %u of the mesh %s has a vertex past the vertices!\n", m, filename);
+                exit(1);
+            }
+        }
+        const u8* triangles = meshlet_triangles + (u64)meshlet->triangle_offset * 3;
+        for (u32 t = 0; t < meshlet->triangle_count * 3; t += 1) {
+            if (triangles[t] >= meshlet->vertex_count) {
+                printf("The meshlet %u of the mesh %s has a triangle past its vertices!\n", m, filename);
+                exit(1);
+            }
+        }
+    }
+}
+
+void map_mesh_file(const char* filename, MeshFile* file)
+{
+    // map the file instead of reading it, the only copy on the CPU side is the one into the staging buffer
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        printf("The mesh %s couldn't be opened!\n", filename);
+        exit(1);
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || (u64)file_stat.st_size < sizeof(MeshFileHeader)) {
+        printf("The mesh %s is too small!\n", filename);
+        exit(1);
+    }
+    u64 file_size = (u64)file_stat.st_size;
+    void* data = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        printf("The mesh %s couldn't be mapped!\n", filename);
+        exit(1);
+    }
+    madvise(data, file_size, MADV_SEQUENTIAL);
+
+    const MeshFileHeader* header = (const MeshFileHeader*)data;
+    if (header->magic != MESH_MAGIC || header->version != MESH_VERSION) {
+        printf("%s is not a mesh of version %u (cook it again with meshcook)\n", filename, MESH_VERSION);
+        exit(1);
+    }
+    if (header->file_size != file_size) {
+        printf("The mesh %s is truncated!\n", filename);
+        exit(1);
+    }
+    validate_mesh_file(filename, header, (const u8*)data, file_size);
+
+    file->filename = filename;
+    file->data = data;
+    file->size = file_size;
+    file->vertex_format = header->vertex_format;
+}
+
+// copies a mapped file to the GPU and unmaps it. It records and submits commands, so only from the main thread
+Mesh* upload_mesh(App* pApp, MeshFile* file)
+{
+    f64 start_ms = now_ms();
+
+    const MeshFileHeader* header = (const MeshFileHeader*)file->data;
+    u64 file_size = file->size;
+    u32 vertex_stride = header->vertex_stride;
+    Mesh* mesh = (Mesh*)malloc(sizeof(Mesh));
+    mesh->vertices_offset = header->vertices_offset;
+    mesh->indices_offset = header->indices_offset;
+    mesh->meshlets_offset = header->meshlets_offset;
+    mesh->index_type = header->index_size == 2 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+    mesh->vertex_format = header->vertex_format;
+    mesh->vertex_count = header->vertex_count;
+    mesh->index_count = header->index_count;
+    mesh->meshlet_count = header->meshlet_count;
+    memcpy(mesh->bounds_min, header->bounds_min, sizeof(mesh->bounds_min));
+    memcpy(mesh->bounds_max, header->bounds_max, sizeof(mesh->bounds_max));
+    memcpy(mesh->position_offset, header->position_offset, sizeof(mesh->position_offset));
+    memcpy(mesh->position_scale, header->position_scale, sizeof(mesh->position_scale));
+
+    // through a staging buffer into device local memory
+    VkBuffer staging_buffer;
+    VkDeviceMemory staging_memory;
+    create_buffer(pApp, file_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MEMORY_CATEGORY_STAGING,
+                  &staging_buffer, &staging_memory);
+    void* mapped;
+    vkMapMemory(pApp->vk_device, staging_memory, 0, file_size, 0, &mapped);
+    memcpy(mapped, file->data, file_size);
+    vkUnmapMemory(pApp->vk_device, staging_memory);
+
+    // the meshlets are read as storage buffers
+    VkBufferUsageFlags usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+                               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    create_buffer(pApp, file_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                  MEMORY_CATEGORY_BUFFER, &mesh->buffer, &mesh->memory);
+    copy_buffer(pApp, staging_buffer, mesh->buffer, file_size);
+    if (pApp->capture != NULL) {
+        capture_buffer(pApp, mesh->buffer, usage, file->data, file_size);
+    }
+    munmap(file->data, file_size);
+    file->data = NULL;
+
+    vkDestroyBuffer(pApp->vk_device, staging_buffer, NULL);
+    free_memory(pApp, staging_memory);
+
+    f64 elapsed_ms = now_ms() - start_ms;
+    printf("Loaded mesh %s: %u vertices (%u bytes each), %u triangles, %u meshlets, %.2f MB in %.2f ms\n",
+           file->filename, mesh->vertex_count, vertex_stride, mesh->index_count / 3, mesh->meshlet_count,
+           (f64)file_size / (1024.0 * 1024.0), elapsed_ms);
+    return mesh;
+}
+
+void destroy_mesh(App* pApp, Mesh* mesh)
+{
+    vkDestroyBuffer(pApp->vk_device, mesh->buffer, NULL);
+    free_memory(pApp, mesh->memory);
+    free(mesh);
+}
+
+void set_vertex_attribute(VertexLayout* layout, u32 location, VkFormat format, u32 offset)
+{
+    layout->attributes[layout->attribute_count] = (VkVertexInputAttributeDescription){
+        .location = location,
+        .binding = 0,
+        .format = format,
+        .offset = offset,
+    };
+    layout->attribute_count += 1;
+}
+
+// the vertex input of mesh.vert for each vertex format of the file. The fetch does the unpacking: snorm and half
+// positions come in as floats, rgba8 colors as [0, 1]
+VertexLayout mesh_vertex_layout(u32 vertex_format)
+{
+    VertexLayout layout = {0};
+
+    switch (vertex_format) {
+    case MESH_VERTEX_FORMAT_F32:
+        layout.binding.stride = sizeof(MeshVertexF32);
+        set_vertex_attribute(&layout, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(MeshVertexF32, position));
+        set_vertex_attribute(&layout, 1, VK_FORMAT_R32G32B32_SFLOAT, offsetof(MeshVertexF32, normal));
+        set_vertex_attribute(&layout, 2, VK_FORMAT_R32G32B32_SFLOAT, offsetof(MeshVertexF32, color));
+        break;
+    case MESH_VERTEX_FORMAT_SNORM16:
+    case MESH_VERTEX_FORMAT_HALF:
+        layout.binding.stride = sizeof(MeshVertexPacked);
+        set_vertex_attribute(&layout, 0,
+                             vertex_format == MESH_VERTEX_FORMAT_SNORM16 ? VK_FORMAT_R16G16B16A16_SNORM
+                                                                         : VK_FORMAT_R16G16B16A16_SFLOAT,
+                             offsetof(MeshVertexPacked, position));
+        set_vertex_attribute(&layout, 1, VK_FORMAT_R16G16_SNORM, offsetof(MeshVertexPacked, normal));
+        set_vertex_attribute(&layout, 2, VK_FORMAT_R8G8B8A8_UNORM, offsetof(MeshVertexPacked, color));
+        break;
+    default:
+        printf("Unknown mesh vertex format %u!\n", vertex_format);
+        exit(1);
+    }
+    layout.binding.binding = 0;
+    layout.binding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+    return layout;
+}
+
+// the packed formats need the octahedral decode of the normals, mesh.vert is specialized for it
+bool mesh_octahedral_normals(u32 vertex_format)
+{
+    return vertex_format != MESH_VERTEX_FORMAT_F32;
+}
+
+void record_mesh_draws(App* pApp, VkCommandBuffer command_buffer, VkPipelineLayout pipeline_layout, const Mesh* mesh,
+                       const DrawParams* draw)
+{
+    // fit the bounds in the view: (position_offset + position * position_scale - center) / radius
+    f32 radius = 0.0f;
+    for (u32 k = 0; k < 3; k += 1) {
+        f32 half_extent = (mesh->bounds_max[k] - mesh->bounds_min[k]) * 0.5f;
+        radius = half_extent > radius ? half_extent : radius;
+    }
+    f32 inverse_radius = radius > 0.0f ? 1.0f / radius : 1.0f;
+    MeshPushConstants push_constants = {0};
+    for (u32 k = 0; k < 3; k += 1) {
+        f32 center = (mesh->bounds_max[k] + mesh->bounds_min[k]) * 0.5f;
+        push_constants.scale[k] = mesh->position_scale[k] * inverse_radius;
+        push_constants.bias[k] = (mesh->position_offset[k] - center) * inverse_radius;
+    }
+    cmd_push_constants(pApp, command_buffer, pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(push_constants),
+                       &push_constants);
+
+    cmd_bind_vertex_buffer(pApp, command_buffer, mesh->buffer, mesh->vertices_offset);
+    cmd_bind_index_buffer(pApp, command_buffer, mesh->buffer, mesh->indices_offset, mesh->index_type);
+    for (u32 i = 0; i < draw->draw_call_count; i += 1) {
+        cmd_draw_indexed(pApp, command_buffer, mesh->index_count, draw->instance_count, 0, 0, 0);
+    }
+}
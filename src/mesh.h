@@ -0,0 +1,52 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include "engine.h"
+#include "mesh_format.h"
+
+// A mesh cooked by tools/meshcook, on the GPU. The whole file goes into one buffer as it is, so the sections are
+// bound at their file offsets
+struct Mesh {
+    VkBuffer buffer;
+    VkDeviceMemory memory;
+    VkDeviceSize vertices_offset;
+    VkDeviceSize indices_offset;
+    VkDeviceSize meshlets_offset; // meshlets, meshlet vertices and meshlet triangles follow, if meshlet_count > 0
+    VkIndexType index_type;
+    u32 vertex_format; // MeshVertexFormat
+    u32 vertex_count;
+    u32 index_count;
+    u32 meshlet_count;
+    f32 bounds_min[3];
+    f32 bounds_max[3];
+    f32 position_offset[3]; // dequantization, see MeshVertexPacked
+    f32 position_scale[3];
+};
+
+// what mesh.vert gets: position * scale + bias puts the mesh in the view. It folds the dequantization of the
+// positions and the fit of the bounds in [-1, 1] together
+typedef struct MeshPushConstants MeshPushConstants;
+struct MeshPushConstants {
+    f32 scale[4];
+    f32 bias[4];
+};
+
+// The file side of load_mesh: mapped and checked, nothing on the GPU yet. It needs no device, so the startup does it
+// on a worker thread while the device is created
+struct MeshFile {
+    const char* filename;
+    void* data; // the whole file, starting with the MeshFileHeader
+    u64 size;
+    u32 vertex_format; // MeshVertexFormat
+};
+
+Mesh* load_mesh(App* pApp, const char* filename);
+void map_mesh_file(const char* filename, MeshFile* file);
+Mesh* upload_mesh(App* pApp, MeshFile* file);
+void destroy_mesh(App* pApp, Mesh* mesh);
+VertexLayout mesh_vertex_layout(u32 vertex_format);
+bool mesh_octahedral_normals(u32 vertex_format);
+void record_mesh_draws(App* pApp, VkCommandBuffer command_buffer, VkPipelineLayout pipeline_layout, const Mesh* mesh,
+                       const DrawParams* draw);
+
+#endif // MESH_H
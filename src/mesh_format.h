@@ -0,0 +1,88 @@
+#ifndef MESH_FORMAT_H
+#define MESH_FORMAT_H
+
+#include "types.h"
+
+// The packed binary mesh format written by tools/meshcook and read by load_mesh. It is laid out exactly like the GPU
+// wants it: the loader maps the file and copies the sections into a buffer as they are, no per-vertex work.
+//
+//     MeshFileHeader
+//     vertices           vertex_count * vertex_stride bytes
+//     indices            index_count * index_size bytes (u16 when the vertices fit, u32 otherwise)
+//     meshlets           meshlet_count * MeshMeshlet (optional)
+//     meshlet vertices   meshlet_vertex_count * u32, indices into the vertices
+//     meshlet triangles  meshlet_triangle_count * 3 * u8, indices into the meshlet vertices
+//
+// Every section starts at a MESH_SECTION_ALIGNMENT aligned offset, so they can be bound straight from one buffer.
+// Everything is little endian.
+
+#define MESH_MAGIC 0x4853454d // "MESH"
+#define MESH_VERSION 2
+#define MESH_SECTION_ALIGNMENT 16
+
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+typedef enum MeshVertexFormat
+{
+    MESH_VERTEX_FORMAT_F32 = 0,     // MeshVertexF32
+    MESH_VERTEX_FORMAT_SNORM16 = 1, // MeshVertexPacked, positions as snorm16
+    MESH_VERTEX_FORMAT_HALF = 2,    // MeshVertexPacked, positions as half floats
+} MeshVertexFormat;
+
+typedef struct MeshVertexF32 MeshVertexF32;
+struct MeshVertexF32 {
+    f32 position[3];
+    f32 normal[3];
+    f32 color[3];
+};
+
+// 16 bytes instead of 36. The positions are normalized to [-1, 1] in the bounds of the mesh and the header has what
+// undoes it: position = position_offset + position * position_scale. Normals are octahedral encoded
+typedef struct MeshVertexPacked MeshVertexPacked;
+struct MeshVertexPacked {
+    u16 position[4]; // xyz as snorm16 or half, w is padding: 3 component 16-bit vertex formats are barely supported
+    i16 normal[2];   // snorm16, octahedral
+    u8 color[4];     // unorm8, a is 255
+};
+
+typedef struct MeshMeshlet MeshMeshlet;
+struct MeshMeshlet {
+    u32 vertex_offset;   // first entry in the meshlet vertices
+    u32 triangle_offset; // first triangle in the meshlet triangles
+    u32 vertex_count;
+    u32 triangle_count;
+    f32 center[3]; // bounding sphere, for culling
+    f32 radius;
+};
+
+typedef struct MeshFileHeader MeshFileHeader;
+struct MeshFileHeader {
+    u32 magic;
+    u32 version;
+    u32 vertex_format; // MeshVertexFormat
+    u32 vertex_stride;
+    u32 vertex_count;
+    u32 index_count;
+    u32 index_size; // 2 or 4
+    u32 meshlet_count;
+    u32 meshlet_vertex_count;
+    u32 meshlet_triangle_count;
+    f32 bounds_min[3];
+    f32 bounds_max[3];
+    f32 position_offset[3]; // the dequantization of the positions, 0 and 1 for MESH_VERTEX_FORMAT_F32
+    f32 position_scale[3];
+    u64 vertices_offset;
+    u64 indices_offset;
+    u64 meshlets_offset;
+    u64 meshlet_vertices_offset;
+    u64 meshlet_triangles_offset;
+    u64 file_size;
+};
+
+_Static_assert(sizeof(MeshVertexF32) == 36, "MeshVertexF32 must be tightly packed");
+_Static_assert(sizeof(MeshVertexPacked) == 16, "MeshVertexPacked must be tightly packed");
+_Static_assert(sizeof(MeshMeshlet) == 32, "MeshMeshlet must be tightly packed");
+_Static_assert(sizeof(MeshFileHeader) == 136, "MeshFileHeader layout changed, bump MESH_VERSION");
+
+#endif // MESH_FORMAT_H
@@ -0,0 +1,325 @@
+#include "engine.h"
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+const char* metric_names[METRIC_COUNT] = {
+    "frame_time_seconds",
+    "cpu_frame_time_seconds",
+    "gpu_frame_time_seconds",
+    "gpu_post_time_seconds",
+    "fence_wait_seconds",
+    "acquire_wait_seconds",
+    "present_seconds",
+};
+
+const char* metric_help[METRIC_COUNT] = {
+    "Time between two frames.",
+    "CPU time of a frame, without the waits.",
+    "GPU time of the frame command buffer, from timestamp queries.",
+    "GPU time of the compute post processing chain, from timestamp queries.",
+    "Time blocked until the GPU was done with the frame slot.",
+    "Time blocked in vkAcquireNextImageKHR.",
+    "Time spent in vkQueuePresentKHR.",
+};
+
+const char* counter_names[COUNTER_COUNT] = {
+    "frames_total",
+    "submissions_total",
+};
+
+// the quantiles of the summaries. 1 is the max
+const f64 metric_quantiles[] = {0.5, 0.9, 0.99, 0.999, 1.0};
+
+void init_metrics(App* pApp)
+{
+    Metrics* metrics = &pApp->metrics;
+    metrics->histograms = (MetricsHistogram*)calloc(METRIC_COUNT, sizeof(MetricsHistogram));
+    metrics->listen_socket = -1;
+}
+
+void destroy_metrics(App* pApp)
+{
+    Metrics* metrics = &pApp->metrics;
+    stop_metrics_exporter(pApp);
+    free(metrics->histograms);
+    metrics->histograms = NULL;
+}
+
+// the middle of a bucket, what a sample in it is reported as
+u64 metrics_bucket_value(u32 index)
+{
+    u32 k = index >> (METRICS_SUB_BUCKET_BITS - 1);
+    if (k <= 1) {
+        return index;
+    }
+    u32 shift = k - 1;
+    u64 lower = (u64)(index - (shift << (METRICS_SUB_BUCKET_BITS - 1))) << shift;
+    return lower + ((1ull << shift) >> 1);
+}
+
+// nearest rank over a snapshot of the counts
+u64 metrics_histogram_quantile(const u64* counts, u64 total, f64 quantile)
+{
+    if (total == 0) {
+        return 0;
+    }
+    u64 rank = (u64)(quantile * (f64)total);
+    if ((f64)rank < quantile * (f64)total) {
+        rank += 1;
+    }
+    if (rank == 0) {
+        rank = 1;
+    }
+    u64 seen = 0;
+    for (u32 i = 0; i < METRICS_HISTOGRAM_BUCKETS; i += 1) {
+        seen += counts[i];
+        if (seen >= rank) {
+            return metrics_bucket_value(i);
+        }
+    }
+    return metrics_bucket_value(METRICS_HISTOGRAM_BUCKETS - 1);
+}
+
+// appends to the export, drops what does not fit
+void append_metrics(char* buffer, u32 size, u32* length, const char* format, ...)
+{
+    if (*length >= size) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    i32 written = vsnprintf(buffer + *length, size - *length, format, args);
+    va_end(args);
+    if (written > 0) {
+        *length += (u32)written;
+        if (*length > size - 1) {
+            *length = size - 1;
+        }
+    }
+}
+
+// Everything in the Prometheus text format (version 0.0.4). The histograms go out as summaries: the quantiles come
+// from the HDR buckets, a handful of lines instead of thousands of le buckets
+u32 format_metrics(App* pApp, char* buffer, u32 size)
+{
+    Metrics* metrics = &pApp->metrics;
+    u32 length = 0;
+    buffer[0] = '\0';
+
+    static u64 counts[METRICS_HISTOGRAM_BUCKETS]; // only the exporter thread formats
+    for (u32 m = 0; m < METRIC_COUNT; m += 1) {
+        const MetricsHistogram* histogram = &metrics->histograms[m];
+        u64 total = 0;
+        for (u32 i = 0; i < METRICS_HISTOGRAM_BUCKETS; i += 1) {
+            counts[i] = atomic_load_explicit(&histogram->counts[i], memory_order_relaxed);
+            total += counts[i];
+        }
+        u64 sum_ns = atomic_load_explicit(&histogram->sum_ns, memory_order_relaxed);
+
+        append_metrics(buffer, size, &length, "# HELP engine_%s %s\n", metric_names[m], metric_help[m]);
+        append_metrics(buffer, size, &length, "# TYPE engine_%s summary\n", metric_names[m]);
+        for (u32 q = 0; q < sizeof(metric_quantiles) / sizeof(metric_quantiles[0]); q += 1) {
+            u64 value_ns = metrics_histogram_quantile(counts, total, metric_quantiles[q]);
+            append_metrics(buffer, size, &length, "engine_%s{quantile=\"%g\"} %.9f\n", metric_names[m],
+                           metric_quantiles[q], (f64)value_ns / 1e9);
+        }
+        append_metrics(buffer, size, &length, "engine_%s_sum %.9f\n", metric_names[m], (f64)sum_ns / 1e9);
+        append_metrics(buffer, size, &length, "engine_%s_count %llu\n", metric_names[m], (unsigned long long)total);
+    }
+
+    for (u32 c = 0; c < COUNTER_COUNT; c += 1) {
+        append_metrics(buffer, size, &length, "# TYPE engine_%s counter\n", counter_names[c]);
+        append_metrics(buffer, size, &length, "engine_%s %llu\n", counter_names[c],
+                       (unsigned long long)atomic_load_explicit(&metrics->counters[c], memory_order_relaxed));
+    }
+
+    // the startup. The exporter starts after init_vulkan, these do not change anymore
+    append_metrics(buffer, size, &length, "# TYPE engine_init_stage_seconds gauge\n");
+    for (u32 i = 0; i < INIT_STAGE_COUNT; i += 1) {
+        append_metrics(buffer, size, &length, "engine_init_stage_seconds{stage=\"%s\"} %.6f\n", init_stage_names[i],
+                       pApp->init_stage_ms[i] / 1000.0);
+    }
+    append_metrics(buffer, size, &length, "# TYPE engine_init_task_seconds gauge\n");
+    for (u32 i = 0; i < INIT_TASK_COUNT; i += 1) {
+        const InitTask* task = &pApp->init_tasks[i];
+        append_metrics(buffer, size, &length, "engine_init_task_seconds{task=\"%s\"} %.6f\n", init_task_names[i],
+                       (task->end_ms - task->start_ms) / 1000.0);
+    }
+    append_metrics(buffer, size, &length, "# TYPE engine_init_seconds gauge\nengine_init_seconds %.6f\n",
+                   pApp->init_ms / 1000.0);
+    append_metrics(buffer, size, &length,
+                   "# TYPE engine_init_critical_path_seconds gauge\nengine_init_critical_path_seconds %.6f\n",
+                   pApp->init_critical_path_ms / 1000.0);
+    u64 first_frame_ns = atomic_load_explicit(&metrics->first_frame_ns, memory_order_relaxed);
+    if (first_frame_ns > 0) {
+        append_metrics(buffer, size, &length,
+                       "# TYPE engine_first_frame_seconds gauge\nengine_first_frame_seconds %.6f\n",
+                       (f64)first_frame_ns / 1e9);
+    }
+    return length;
+}
+
+void send_all(i32 socket, const char* data, u32 size)
+{
+    while (size > 0) {
+        ssize_t sent = send(socket, data, size, MSG_NOSIGNAL);
+        if (sent <= 0) {
+            if (sent < 0 && errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        data += sent;
+        size -= (u32)sent;
+    }
+}
+
+// One request per connection, GET /metrics (or /). Scrapes are rare, nothing fancier is needed
+void serve_metrics_request(App* pApp, i32 client)
+{
+    Metrics* metrics = &pApp->metrics;
+    struct timeval timeout = {.tv_sec = 0, .tv_usec = 200000};
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    char request[1024];
+    ssize_t received = recv(client, request, sizeof(request) - 1, 0);
+    if (received <= 0) {
+        return;
+    }
+    request[received] = '\0';
+
+    char header[256];
+    if (strncmp(request, "GET /metrics", strlen("GET /metrics")) != 0 && strncmp(request, "GET / ", 6) != 0) {
+        const char* not_found = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+        send_all(client, not_found, (u32)strlen(not_found));
+        return;
+    }
+    u32 length = format_metrics(pApp, metrics->buffer, METRICS_BUFFER_SIZE);
+    i32 header_length = snprintf(header, sizeof(header),
+                                 "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                                 "Content-Length: %u\r\nConnection: close\r\n\r\n",
+                                 length);
+    send_all(client, header, (u32)header_length);
+    send_all(client, metrics->buffer, length);
+}
+
+// written next to it and renamed, a reader never sees half a file
+void write_metrics_file(App* pApp)
+{
+    Metrics* metrics = &pApp->metrics;
+    char temp_filename[1024];
+    snprintf(temp_filename, sizeof(temp_filename), "%s.tmp", metrics->filename);
+    FILE* file = fopen(temp_filename, "w");
+    if (file == NULL) {
+        return;
+    }
+    u32 length = format_metrics(pApp, metrics->buffer, METRICS_BUFFER_SIZE);
+    fwrite(metrics->buffer, 1, length, file);
+    fclose(file);
+    rename(temp_filename, metrics->filename);
+}
+
+void* run_metrics_exporter(void* arg)
+{
+    App* pApp = (App*)arg;
+    Metrics* metrics = &pApp->metrics;
+    f64 next_write_ms = now_ms();
+
+    while (!atomic_load(&metrics->stop)) {
+        if (metrics->filename != NULL && now_ms() >= next_write_ms) {
+            write_metrics_file(pApp);
+            next_write_ms += METRICS_FILE_INTERVAL_MS;
+        }
+
+        // short timeouts, so the thread sees the stop soon enough
+        if (metrics->listen_socket < 0) {
+            usleep(100 * 1000);
+            continue;
+        }
+        struct pollfd listen_poll = {.fd = metrics->listen_socket, .events = POLLIN};
+        if (poll(&listen_poll, 1, 100) <= 0) {
+            continue;
+        }
+        i32 client = accept(metrics->listen_socket, NULL, NULL);
+        if (client >= 0) {
+            serve_metrics_request(pApp, client);
+            close(client);
+        }
+    }
+
+    // the last numbers, for a file read after the exit
+    if (metrics->filename != NULL) {
+        write_metrics_file(pApp);
+    }
+    return NULL;
+}
+
+// Only on loopback: the numbers are for this machine's scraper, not for the network
+void open_metrics_socket(Metrics* metrics)
+{
+    i32 listen_socket = socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_socket < 0) {
+        printf("Failed to create the metrics socket!\n");
+        exit(1);
+    }
+    i32 reuse = 1;
+    setsockopt(listen_socket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    struct sockaddr_in address = {
+        .sin_family = AF_INET,
+        .sin_port = htons((u16)metrics->port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    if (bind(listen_socket, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(listen_socket, 4) != 0) {
+        printf("Failed to listen on 127.0.0.1:%u for the metrics!\n", metrics->port);
+        exit(1);
+    }
+    metrics->listen_socket = listen_socket;
+}
+
+// After init_vulkan, so the startup numbers are final. Does nothing without a port or a file
+void start_metrics_exporter(App* pApp)
+{
+    Metrics* metrics = &pApp->metrics;
+    if (metrics->port == 0 && metrics->filename == NULL) {
+        return;
+    }
+    metrics->buffer = (char*)malloc(METRICS_BUFFER_SIZE);
+    if (metrics->port != 0) {
+        open_metrics_socket(metrics);
+    }
+    atomic_store(&metrics->stop, false);
+    if (pthread_create(&metrics->thread, NULL, run_metrics_exporter, pApp) != 0) {
+        printf("Failed to start the metrics exporter!\n");
+        exit(1);
+    }
+    metrics->running = true;
+    if (metrics->port != 0) {
+        printf("Metrics on http://127.0.0.1:%u/metrics\n", metrics->port);
+    }
+    if (metrics->filename != NULL) {
+        printf("Metrics written to %s every %u ms\n", metrics->filename, METRICS_FILE_INTERVAL_MS);
+    }
+}
+
+void stop_metrics_exporter(App* pApp)
+{
+    Metrics* metrics = &pApp->metrics;
+    if (!metrics->running) {
+        return;
+    }
+    atomic_store(&metrics->stop, true);
+    pthread_join(metrics->thread, NULL);
+    metrics->running = false;
+    if (metrics->listen_socket >= 0) {
+        close(metrics->listen_socket);
+        metrics->listen_socket = -1;
+    }
+    free(metrics->buffer);
+    metrics->buffer = NULL;
+}
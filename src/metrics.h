@@ -0,0 +1,113 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "types.h"
+
+// Frame metrics for a running process, without a profiler. The frame loop records into HDR histograms (log-linear
+// buckets, about 0.4% relative error from 1 ns to 17 s) and a few counters, and an exporter thread serves them in the
+// Prometheus text format on 127.0.0.1:<port>/metrics, or writes them to a file every second (the node exporter
+// textfile collector reads that). Recording is a bucket index and two relaxed adds: each histogram has a single writer
+// (the main thread), the exporter only reads, nothing locks.
+
+#define METRICS_SUB_BUCKET_BITS 8 // 128 sub buckets per power of two
+#define METRICS_MAX_VALUE_BITS 34 // 2^34 ns, 17 s. Bigger values land in the last bucket
+#define METRICS_HISTOGRAM_BUCKETS                                                                                      \
+    ((METRICS_MAX_VALUE_BITS - METRICS_SUB_BUCKET_BITS + 2) << (METRICS_SUB_BUCKET_BITS - 1))
+#define METRICS_FILE_INTERVAL_MS 1000
+#define METRICS_BUFFER_SIZE (64 * 1024)
+
+typedef struct App App;
+
+typedef enum MetricId
+{
+    METRIC_FRAME_TIME,     // between two frames, all of it
+    METRIC_CPU_FRAME_TIME, // the frame without the waits below
+    METRIC_GPU_FRAME_TIME, // the frame's command buffer on the GPU, from timestamps
+    METRIC_GPU_POST_TIME,  // the post processing part of it
+    METRIC_FENCE_WAIT,     // blocked until the GPU was done with the frame slot
+    METRIC_ACQUIRE_WAIT,   // in vkAcquireNextImageKHR
+    METRIC_PRESENT,        // in vkQueuePresentKHR, it blocks on some drivers and present modes
+    METRIC_COUNT,
+} MetricId;
+
+extern const char* metric_names[METRIC_COUNT];
+extern const char* metric_help[METRIC_COUNT];
+
+typedef enum CounterId
+{
+    COUNTER_FRAMES,
+    COUNTER_SUBMISSIONS, // vkQueueSubmit calls, the frames and the uploads
+    COUNTER_COUNT,
+} CounterId;
+
+extern const char* counter_names[COUNTER_COUNT];
+
+typedef struct MetricsHistogram MetricsHistogram;
+struct MetricsHistogram {
+    _Atomic u64 counts[METRICS_HISTOGRAM_BUCKETS]; // the total count is their sum
+    _Atomic u64 sum_ns;
+};
+
+typedef struct Metrics Metrics;
+struct Metrics {
+    MetricsHistogram* histograms; // METRIC_COUNT of them, too big to live in the App
+    _Atomic u64 counters[COUNTER_COUNT];
+    _Atomic u64 first_frame_ns; // 0 until the first frame is presented
+
+    // the exporter, set before start_metrics_exporter. Neither set: no thread
+    u32 port;
+    const char* filename;
+    pthread_t thread;
+    bool running;
+    atomic_bool stop;
+    i32 listen_socket;
+    char* buffer; // the text of the last export
+};
+
+void init_metrics(App* pApp);
+void destroy_metrics(App* pApp);
+void start_metrics_exporter(App* pApp);
+void stop_metrics_exporter(App* pApp);
+u32 format_metrics(App* pApp, char* buffer, u32 size);
+u64 metrics_histogram_quantile(const u64* counts, u64 total, f64 quantile);
+
+// the bucket of a value: linear below 2^SUB_BUCKET_BITS, then 128 buckets per power of two
+static inline u32 metrics_bucket_index(u64 value)
+{
+    if (value >> METRICS_MAX_VALUE_BITS) {
+        return METRICS_HISTOGRAM_BUCKETS - 1;
+    }
+    u32 top = 63 - (u32)__builtin_clzll(value | 1);
+    u32 shift = top >= METRICS_SUB_BUCKET_BITS ? top - METRICS_SUB_BUCKET_BITS + 1 : 0;
+    return (shift << (METRICS_SUB_BUCKET_BITS - 1)) + (u32)(value >> shift);
+}
+
+// Single writer: a relaxed load and store instead of a locked add. The reader may see the count of a sample before
+// its sum, a scrape is off by one frame at most
+static inline void metrics_add(_Atomic u64* value, u64 amount)
+{
+    atomic_store_explicit(value, atomic_load_explicit(value, memory_order_relaxed) + amount, memory_order_relaxed);
+}
+
+static inline void record_metric(Metrics* metrics, MetricId id, u64 value_ns)
+{
+    MetricsHistogram* histogram = &metrics->histograms[id];
+    metrics_add(&histogram->counts[metrics_bucket_index(value_ns)], 1);
+    metrics_add(&histogram->sum_ns, value_ns);
+}
+
+static inline void record_metric_ms(Metrics* metrics, MetricId id, f64 value_ms)
+{
+    record_metric(metrics, id, value_ms > 0.0 ? (u64)(value_ms * 1000000.0) : 0);
+}
+
+static inline void count_metric(Metrics* metrics, CounterId id)
+{
+    metrics_add(&metrics->counters[id], 1);
+}
+
+#endif // METRICS_H
@@ -0,0 +1,598 @@
+#include "post.h"
+
+const char* post_kernel_filenames[POST_KERNEL_COUNT] = {
+    "build/shaders/post_downsample.spv",
+    "build/shaders/post_blur.spv",
+    "build/shaders/post_upsample.spv",
+    "build/shaders/post_tonemap.spv",
+};
+
+// Subgroup arithmetic in compute (Vulkan 1.1), compute on the graphics queue, and storage image writes without a
+// format: the tonemap writes whatever the swapchain format is
+bool check_post_support(App* pApp)
+{
+    VkPhysicalDeviceProperties device_properties;
+    vkGetPhysicalDeviceProperties(pApp->vk_physical_device, &device_properties);
+    if (pApp->vk_api_version < VK_API_VERSION_1_1 || device_properties.apiVersion < VK_API_VERSION_1_1) {
+        printf("Post processing needs Vulkan 1.1, it is disabled.\n");
+        return false;
+    }
+
+    PFN_vkGetPhysicalDeviceProperties2 get_properties2 = (PFN_vkGetPhysicalDeviceProperties2)vkGetInstanceProcAddr(
+        pApp->vk_instance, "vkGetPhysicalDeviceProperties2");
+    if (get_properties2 == NULL) {
+        return false;
+    }
+    VkPhysicalDeviceSubgroupProperties subgroup_properties = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES,
+    };
+    VkPhysicalDeviceProperties2 properties2 = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+        .pNext = &subgroup_properties,
+    };
+    get_properties2(pApp->vk_physical_device, &properties2);
+    VkSubgroupFeatureFlags operations = VK_SUBGROUP_FEATURE_BASIC_BIT | VK_SUBGROUP_FEATURE_ARITHMETIC_BIT;
+    if (!(subgroup_properties.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT) ||
+        (subgroup_properties.supportedOperations & operations) != operations) {
+        printf("No subgroup arithmetic in compute shaders, post processing is disabled.\n");
+        return false;
+    }
+
+    u32 queue_family_count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(pApp->vk_physical_device, &queue_family_count, NULL);
+    VkQueueFamilyProperties queue_families[queue_family_count];
+    vkGetPhysicalDeviceQueueFamilyProperties(pApp->vk_physical_device, &queue_family_count, queue_families);
+    if (!(queue_families[pApp->vk_queue_family_indices.graphics_family].queueFlags & VK_QUEUE_COMPUTE_BIT)) {
+        printf("The graphics queue has no compute, post processing is disabled.\n");
+        return false;
+    }
+
+    VkPhysicalDeviceFeatures features;
+    vkGetPhysicalDeviceFeatures(pApp->vk_physical_device, &features);
+    if (!features.shaderStorageImageWriteWithoutFormat) {
+        printf("No shaderStorageImageWriteWithoutFormat, post processing is disabled.\n");
+        return false;
+    }
+    printf("Post processing in compute, subgroups of %u.\n", subgroup_properties.subgroupSize);
+    return true;
+}
+
+// the scene has no alpha: B10G11R11 is half the bandwidth of RGBA16F, for the render pass and every read after it
+VkFormat choose_hdr_format(App* pApp)
+{
+    VkFormatFeatureFlags needed = VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(pApp->vk_physical_device, VK_FORMAT_B10G11R11_UFLOAT_PACK32, &properties);
+    if ((properties.optimalTilingFeatures & needed) == needed) {
+        return VK_FORMAT_B10G11R11_UFLOAT_PACK32;
+    }
+    return VK_FORMAT_R16G16B16A16_SFLOAT;
+}
+
+bool is_srgb_format(VkFormat format)
+{
+    return format == VK_FORMAT_B8G8R8A8_SRGB || format == VK_FORMAT_R8G8B8A8_SRGB ||
+           format == VK_FORMAT_A8B8G8R8_SRGB_PACK32;
+}
+
+// The swapchain images are written by the tonemap when they can be storage images, or blitted from an image of ours.
+// Decided before the swapchain exists, it needs the usage. Without a way to get there the chain is disabled
+void choose_post_output(App* pApp)
+{
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(pApp->vk_physical_device, pApp->vk_format, &properties);
+    bool storage = (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT) != 0;
+    if (!pApp->headless) {
+        VkSurfaceCapabilitiesKHR capabilities;
+        vkGetPhysicalDeviceSurfaceCapabilitiesKHR(pApp->vk_physical_device, pApp->vk_surface, &capabilities);
+        storage = storage && (capabilities.supportedUsageFlags & VK_IMAGE_USAGE_STORAGE_BIT);
+    }
+    if (!storage && !(properties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT)) {
+        printf("The swapchain format %u is neither a storage nor a blit target, post processing is disabled.\n",
+               pApp->vk_format);
+        pApp->post_processing = false;
+        return;
+    }
+    pApp->post_storage_output = storage;
+    printf("Post processing: the tonemap writes %s.\n",
+           storage ? "the swapchain images" : "an image blitted into the swapchain images");
+}
+
+// what the swapchain (or offscreen) images need on top of being color attachments
+VkImageUsageFlags post_target_usage(App* pApp)
+{
+    if (!pApp->post_processing) {
+        return 0;
+    }
+    return pApp->post_storage_output ? VK_IMAGE_USAGE_STORAGE_BIT : VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+}
+
+VkExtent2D post_half_extent(VkExtent2D extent)
+{
+    VkExtent2D half = {extent.width / 2, extent.height / 2};
+    half.width = half.width > 0 ? half.width : 1;
+    half.height = half.height > 0 ? half.height : 1;
+    return half;
+}
+
+u32 post_group_count(u32 size, u32 group_size)
+{
+    return (size + group_size - 1) / group_size;
+}
+
+// the images only compute touches stay in GENERAL for good
+void transition_post_images(App* pApp, PostChain* post)
+{
+    VkImage images[POST_BLOOM_LEVELS + 2];
+    u32 image_count = 0;
+    for (u32 i = 0; i < POST_BLOOM_LEVELS; i += 1) {
+        images[image_count++] = post->bloom_images[i];
+    }
+    images[image_count++] = post->blur_image;
+    if (post->output_image != VK_NULL_HANDLE) {
+        images[image_count++] = post->output_image;
+    }
+
+    VkImageMemoryBarrier barriers[POST_BLOOM_LEVELS + 2];
+    for (u32 i = 0; i < image_count; i += 1) {
+        barriers[i] = (VkImageMemoryBarrier){
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .srcAccessMask = 0,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+            .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            .newLayout = VK_IMAGE_LAYOUT_GENERAL,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = images[i],
+            .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
+        };
+    }
+    VkCommandBuffer command_buffer = begin_single_time_commands(pApp);
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0,
+                         NULL, 0, NULL, image_count, barriers);
+    end_single_time_commands(pApp, command_buffer);
+}
+
+void create_post_targets(App* pApp, PostChain* post)
+{
+    // sampled by the kernels after the render pass. Not transient: it outlives the pass
+    create_image(pApp, pApp->vk_extent, pApp->vk_scene_format, VK_SAMPLE_COUNT_1_BIT,
+                 VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, &post->hdr_image, &post->hdr_memory);
+    post->hdr_view = create_image_view(pApp, post->hdr_image, pApp->vk_scene_format, VK_IMAGE_ASPECT_COLOR_BIT);
+
+    // rgba16f is a storage format everywhere, B10G11R11 is not
+    VkExtent2D extent = post_half_extent(pApp->vk_extent);
+    VkImageUsageFlags usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    for (u32 i = 0; i < POST_BLOOM_LEVELS; i += 1) {
+        post->bloom_extents[i] = extent;
+        create_image(pApp, extent, VK_FORMAT_R16G16B16A16_SFLOAT, VK_SAMPLE_COUNT_1_BIT, usage, &post->bloom_images[i],
+                     &post->bloom_memories[i]);
+        post->bloom_views[i] = create_image_view(pApp, post->bloom_images[i], VK_FORMAT_R16G16B16A16_SFLOAT,
+                                                 VK_IMAGE_ASPECT_COLOR_BIT);
+        extent = post_half_extent(extent);
+    }
+    create_image(pApp, post->bloom_extents[POST_BLOOM_LEVELS - 1], VK_FORMAT_R16G16B16A16_SFLOAT,
+                 VK_SAMPLE_COUNT_1_BIT, usage, &post->blur_image, &post->blur_memory);
+    post->blur_view =
+        create_image_view(pApp, post->blur_image, VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT);
+
+    // The blit does the swizzle (and the sRGB encoding for an SRGB swapchain, from linear half floats). A UNORM
+    // swapchain gets values the tonemap already encoded
+    post->encode_srgb = !is_srgb_format(pApp->vk_format);
+    if (!pApp->post_storage_output) {
+        post->output_format = post->encode_srgb ? VK_FORMAT_R8G8B8A8_UNORM : VK_FORMAT_R16G16B16A16_SFLOAT;
+        create_image(pApp, pApp->vk_extent, post->output_format, VK_SAMPLE_COUNT_1_BIT,
+                     VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, &post->output_image,
+                     &post->output_memory);
+        post->output_view =
+            create_image_view(pApp, post->output_image, post->output_format, VK_IMAGE_ASPECT_COLOR_BIT);
+    }
+
+    create_buffer(pApp, sizeof(PostExposure), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MEMORY_CATEGORY_BUFFER, &post->exposure_buffer,
+                  &post->exposure_memory);
+
+    transition_post_images(pApp, post);
+
+    // bilinear, for the bloom levels. The HDR and the tiles are read with texelFetch, the sampler is ignored there
+    VkSamplerCreateInfo sampler_info = {
+        .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+        .magFilter = VK_FILTER_LINEAR,
+        .minFilter = VK_FILTER_LINEAR,
+        .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+        .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .maxLod = 0.0f,
+    };
+    if (vkCreateSampler(pApp->vk_device, &sampler_info, NULL, &post->sampler) != VK_SUCCESS) {
+        printf("Failed to create the post processing sampler!\n");
+        exit(1);
+    }
+}
+
+// One layout for all the kernels: 0 the source, 1 the bloom (tonemap), 2 the destination, 3 the exposure
+void create_post_layouts(App* pApp, PostChain* post)
+{
+    VkDescriptorSetLayoutBinding bindings[] = {
+        {0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT, NULL},
+        {1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT, NULL},
+        {2, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT, NULL},
+        {3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, NULL},
+    };
+    VkDescriptorSetLayoutCreateInfo layout_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = sizeof(bindings) / sizeof(bindings[0]),
+        .pBindings = bindings,
+    };
+    if (vkCreateDescriptorSetLayout(pApp->vk_device, &layout_info, NULL, &post->descriptor_set_layout) !=
+        VK_SUCCESS) {
+        printf("Failed to create the post processing descriptor set layout!\n");
+        exit(1);
+    }
+
+    VkPushConstantRange push_constant_range = {
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        .offset = 0,
+        .size = sizeof(PostPushConstants),
+    };
+    VkPipelineLayoutCreateInfo pipeline_layout_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 1,
+        .pSetLayouts = &post->descriptor_set_layout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &push_constant_range,
+    };
+    if (vkCreatePipelineLayout(pApp->vk_device, &pipeline_layout_info, NULL, &post->pipeline_layout) != VK_SUCCESS) {
+        printf("Failed to create the post processing pipeline layout!\n");
+        exit(1);
+    }
+
+    u32 set_count = POST_MAX_PASSES + (pApp->post_storage_output ? pApp->vk_image_count : 1);
+    VkDescriptorPoolSize pool_sizes[] = {
+        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2 * set_count},
+        {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, set_count},
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, set_count},
+    };
+    VkDescriptorPoolCreateInfo pool_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .maxSets = set_count,
+        .poolSizeCount = sizeof(pool_sizes) / sizeof(pool_sizes[0]),
+        .pPoolSizes = pool_sizes,
+    };
+    if (vkCreateDescriptorPool(pApp->vk_device, &pool_info, NULL, &post->descriptor_pool) != VK_SUCCESS) {
+        printf("Failed to create the post processing descriptor pool!\n");
+        exit(1);
+    }
+}
+
+// A set with its four bindings. The HDR is sampled in SHADER_READ_ONLY_OPTIMAL (the render pass leaves it there),
+// everything else is in GENERAL. Unused bindings still point at something valid
+VkDescriptorSet create_post_set(App* pApp, PostChain* post, VkImageView source, VkImageView destination)
+{
+    VkDescriptorSet set;
+    VkDescriptorSetAllocateInfo alloc_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = post->descriptor_pool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &post->descriptor_set_layout,
+    };
+    if (vkAllocateDescriptorSets(pApp->vk_device, &alloc_info, &set) != VK_SUCCESS) {
+        printf("Failed to allocate a post processing descriptor set!\n");
+        exit(1);
+    }
+
+    VkDescriptorImageInfo source_info = {
+        .sampler = post->sampler,
+        .imageView = source,
+        .imageLayout =
+            source == post->hdr_view ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL,
+    };
+    VkDescriptorImageInfo bloom_info = {
+        .sampler = post->sampler,
+        .imageView = post->bloom_views[0],
+        .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
+    };
+    VkDescriptorImageInfo destination_info = {
+        .imageView = destination,
+        .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
+    };
+    VkDescriptorBufferInfo exposure_info = {
+        .buffer = post->exposure_buffer,
+        .offset = 0,
+        .range = sizeof(PostExposure),
+    };
+    VkWriteDescriptorSet writes[] = {
+        {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = set,
+            .dstBinding = 0,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .pImageInfo = &source_info,
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = set,
+            .dstBinding = 1,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .pImageInfo = &bloom_info,
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = set,
+            .dstBinding = 2,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+            .pImageInfo = &destination_info,
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = set,
+            .dstBinding = 3,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .pBufferInfo = &exposure_info,
+        },
+    };
+    vkUpdateDescriptorSets(pApp->vk_device, sizeof(writes) / sizeof(writes[0]), writes, 0, NULL);
+    return set;
+}
+
+void add_post_pass(App* pApp, PostChain* post, PostKernel kernel, VkImageView source, VkExtent2D source_extent,
+                   VkImageView destination, VkExtent2D destination_extent)
+{
+    PostPass* pass = &post->passes[post->pass_count++];
+    pass->kernel = kernel;
+    pass->descriptor_set = create_post_set(pApp, post, source, destination);
+    pass->push_constants = (PostPushConstants){
+        .src_size = {(i32)source_extent.width, (i32)source_extent.height},
+        .dst_size = {(i32)destination_extent.width, (i32)destination_extent.height},
+    };
+    pass->group_count[0] = post_group_count(destination_extent.width, POST_TILE_SIZE);
+    pass->group_count[1] = post_group_count(destination_extent.height, POST_TILE_SIZE);
+}
+
+// The whole chain is known up front, only the tonemap target changes with the swapchain image
+void create_post_passes(App* pApp, PostChain* post)
+{
+    const VkExtent2D* extents = post->bloom_extents;
+    u32 last = POST_BLOOM_LEVELS - 1;
+
+    add_post_pass(pApp, post, POST_KERNEL_DOWNSAMPLE, post->hdr_view, pApp->vk_extent, post->bloom_views[0],
+                  extents[0]);
+    post->passes[post->pass_count - 1].push_constants.threshold = POST_BLOOM_THRESHOLD;
+    for (u32 i = 1; i < POST_BLOOM_LEVELS; i += 1) {
+        add_post_pass(pApp, post, POST_KERNEL_DOWNSAMPLE, post->bloom_views[i - 1], extents[i - 1],
+                      post->bloom_views[i], extents[i]);
+    }
+
+    // one workgroup per POST_BLUR_GROUP_SIZE pixels of a row (or of a column)
+    for (u32 vertical = 0; vertical < 2; vertical += 1) {
+        VkImageView source = vertical ? post->blur_view : post->bloom_views[last];
+        VkImageView destination = vertical ? post->bloom_views[last] : post->blur_view;
+        add_post_pass(pApp, post, POST_KERNEL_BLUR, source, extents[last], destination, extents[last]);
+        PostPass* pass = &post->passes[post->pass_count - 1];
+        pass->push_constants.direction[0] = vertical ? 0 : 1;
+        pass->push_constants.direction[1] = vertical ? 1 : 0;
+        u32 length = vertical ? extents[last].height : extents[last].width;
+        pass->group_count[0] = post_group_count(length, POST_BLUR_GROUP_SIZE);
+        pass->group_count[1] = vertical ? extents[last].width : extents[last].height;
+    }
+
+    for (i32 i = (i32)last - 1; i >= 0; i -= 1) {
+        add_post_pass(pApp, post, POST_KERNEL_UPSAMPLE, post->bloom_views[i + 1], extents[i + 1],
+                      post->bloom_views[i], extents[i]);
+    }
+
+    post->tonemap_set_count = pApp->post_storage_output ? pApp->vk_image_count : 1;
+    post->tonemap_sets = (VkDescriptorSet*)malloc(post->tonemap_set_count * sizeof(VkDescriptorSet));
+    for (u32 i = 0; i < post->tonemap_set_count; i += 1) {
+        VkImageView target = pApp->post_storage_output ? pApp->vk_imageviews[i] : post->output_view;
+        post->tonemap_sets[i] = create_post_set(pApp, post, post->hdr_view, target);
+    }
+}
+
+// the kernels are modules of the shader variants, so F5 reloads them like the rest
+void create_post_pipelines(App* pApp)
+{
+    PostChain* post = pApp->post;
+
+    // the tonemap encodes to sRGB itself only for a UNORM target (constant_id = 0)
+    VkSpecializationMapEntry map_entry = {.constantID = 0, .offset = 0, .size = sizeof(u32)};
+    u32 encode_srgb = post->encode_srgb;
+    VkSpecializationInfo specialization_info = {
+        .mapEntryCount = 1,
+        .pMapEntries = &map_entry,
+        .dataSize = sizeof(u32),
+        .pData = &encode_srgb,
+    };
+
+    VkComputePipelineCreateInfo pipeline_infos[POST_KERNEL_COUNT];
+    for (u32 i = 0; i < POST_KERNEL_COUNT; i += 1) {
+        VkShaderModule module = find_shader_module(pApp, post_kernel_filenames[i]);
+        if (module == VK_NULL_HANDLE) {
+            Shader binary = read_file(post_kernel_filenames[i]);
+            module = add_shader_module(pApp, post_kernel_filenames[i], &binary);
+        }
+        pipeline_infos[i] = (VkComputePipelineCreateInfo){
+            .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+            .stage =
+                {
+                    .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                    .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+                    .module = module,
+                    .pName = "main",
+                    .pSpecializationInfo = i == POST_KERNEL_TONEMAP ? &specialization_info : NULL,
+                },
+            .layout = post->pipeline_layout,
+        };
+    }
+    if (vkCreateComputePipelines(pApp->vk_device, VK_NULL_HANDLE, POST_KERNEL_COUNT, pipeline_infos, NULL,
+                                 post->pipelines) != VK_SUCCESS) {
+        printf("Failed to create the post processing pipelines!\n");
+        exit(1);
+    }
+}
+
+// After the swapchain image views (the tonemap may write them) and before the framebuffers (they draw into the HDR).
+// The pipelines come later, once the scene pipelines task is done with the shader variants
+void create_post_chain(App* pApp)
+{
+    if (!pApp->post_processing) {
+        return;
+    }
+    PostChain* post = (PostChain*)calloc(1, sizeof(PostChain));
+    pApp->post = post;
+    create_post_targets(pApp, post);
+    create_post_layouts(pApp, post);
+    create_post_passes(pApp, post);
+    printf("Post processing chain created: HDR format %u, %u bloom levels, %u dispatches a frame.\n",
+           pApp->vk_scene_format, POST_BLOOM_LEVELS, post->pass_count + 1);
+}
+
+void destroy_post_chain(App* pApp)
+{
+    PostChain* post = pApp->post;
+    VkDevice device = pApp->vk_device;
+    for (u32 i = 0; i < POST_KERNEL_COUNT; i += 1) {
+        vkDestroyPipeline(device, post->pipelines[i], NULL);
+    }
+    vkDestroyPipelineLayout(device, post->pipeline_layout, NULL);
+    vkDestroyDescriptorPool(device, post->descriptor_pool, NULL);
+    vkDestroyDescriptorSetLayout(device, post->descriptor_set_layout, NULL);
+    vkDestroySampler(device, post->sampler, NULL);
+    vkDestroyBuffer(device, post->exposure_buffer, NULL);
+    free_memory(pApp, post->exposure_memory);
+    if (post->output_image != VK_NULL_HANDLE) {
+        vkDestroyImageView(device, post->output_view, NULL);
+        vkDestroyImage(device, post->output_image, NULL);
+        free_memory(pApp, post->output_memory);
+    }
+    vkDestroyImageView(device, post->blur_view, NULL);
+    vkDestroyImage(device, post->blur_image, NULL);
+    free_memory(pApp, post->blur_memory);
+    for (u32 i = 0; i < POST_BLOOM_LEVELS; i += 1) {
+        vkDestroyImageView(device, post->bloom_views[i], NULL);
+        vkDestroyImage(device, post->bloom_images[i], NULL);
+        free_memory(pApp, post->bloom_memories[i]);
+    }
+    vkDestroyImageView(device, post->hdr_view, NULL);
+    vkDestroyImage(device, post->hdr_image, NULL);
+    free_memory(pApp, post->hdr_memory);
+    free(post->tonemap_sets);
+    free(post);
+    pApp->post = NULL;
+}
+
+void post_memory_barrier(VkCommandBuffer command_buffer, VkPipelineStageFlags src_stage, VkAccessFlags src_access,
+                         VkPipelineStageFlags dst_stage, VkAccessFlags dst_access)
+{
+    VkMemoryBarrier barrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = src_access,
+        .dstAccessMask = dst_access,
+    };
+    vkCmdPipelineBarrier(command_buffer, src_stage, dst_stage, 0, 1, &barrier, 0, NULL, 0, NULL);
+}
+
+VkImageMemoryBarrier post_image_barrier(VkImage image, VkImageLayout old_layout, VkImageLayout new_layout,
+                                        VkAccessFlags src_access, VkAccessFlags dst_access)
+{
+    return (VkImageMemoryBarrier){
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = src_access,
+        .dstAccessMask = dst_access,
+        .oldLayout = old_layout,
+        .newLayout = new_layout,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = image,
+        .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
+    };
+}
+
+// After the render pass, in the primary command buffer. The frame submission waits for the acquire at the compute
+// and transfer stages, where the swapchain image is first written
+void record_post(App* pApp, VkCommandBuffer command_buffer, u32 image_index)
+{
+    PostChain* post = pApp->post;
+    VkCommandBuffer cb = command_buffer;
+    VkPipelineStageFlags compute = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    VkAccessFlags shader_access = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+    // The levels, the exposure and the output are shared by the frames in flight: the previous chain (and its blit)
+    // must be done with them. The HDR target is covered by the render pass dependencies
+    post_memory_barrier(cb, compute | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                        compute | VK_PIPELINE_STAGE_TRANSFER_BIT, shader_access | VK_ACCESS_TRANSFER_WRITE_BIT);
+    vkCmdFillBuffer(cb, post->exposure_buffer, 0, sizeof(PostExposure), 0);
+    post_memory_barrier(cb, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, compute, shader_access);
+
+    // each pass reads what the one before wrote
+    PostKernel bound = POST_KERNEL_COUNT;
+    for (u32 i = 0; i < post->pass_count; i += 1) {
+        const PostPass* pass = &post->passes[i];
+        if (pass->kernel != bound) {
+            vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_COMPUTE, post->pipelines[pass->kernel]);
+            bound = pass->kernel;
+        }
+        vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_COMPUTE, post->pipeline_layout, 0, 1,
+                                &pass->descriptor_set, 0, NULL);
+        vkCmdPushConstants(cb, post->pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PostPushConstants),
+                           &pass->push_constants);
+        vkCmdDispatch(cb, pass->group_count[0], pass->group_count[1], 1);
+        post_memory_barrier(cb, compute, VK_ACCESS_SHADER_WRITE_BIT, compute, shader_access);
+    }
+
+    // the tonemap, into the swapchain image itself or into the output image
+    VkImageLayout final_layout =
+        pApp->headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    VkImage target = pApp->vk_images[image_index];
+    if (pApp->post_storage_output) {
+        VkImageMemoryBarrier barrier = post_image_barrier(target, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+                                                          0, VK_ACCESS_SHADER_WRITE_BIT);
+        vkCmdPipelineBarrier(cb, compute, compute, 0, 0, NULL, 0, NULL, 1, &barrier);
+    }
+    PostPushConstants push_constants = {
+        .src_size = {(i32)pApp->vk_extent.width, (i32)pApp->vk_extent.height},
+        .dst_size = {(i32)pApp->vk_extent.width, (i32)pApp->vk_extent.height},
+        .strength = POST_BLOOM_STRENGTH,
+    };
+    VkDescriptorSet tonemap_set = post->tonemap_sets[pApp->post_storage_output ? image_index : 0];
+    vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_COMPUTE, post->pipelines[POST_KERNEL_TONEMAP]);
+    vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_COMPUTE, post->pipeline_layout, 0, 1, &tonemap_set, 0, NULL);
+    vkCmdPushConstants(cb, post->pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_constants),
+                       &push_constants);
+    vkCmdDispatch(cb, post_group_count(pApp->vk_extent.width, POST_TILE_SIZE),
+                  post_group_count(pApp->vk_extent.height, POST_TILE_SIZE), 1);
+
+    if (pApp->post_storage_output) {
+        VkImageMemoryBarrier barrier =
+            post_image_barrier(target, VK_IMAGE_LAYOUT_GENERAL, final_layout, VK_ACCESS_SHADER_WRITE_BIT, 0);
+        vkCmdPipelineBarrier(cb, compute, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, NULL, 0, NULL, 1, &barrier);
+        return;
+    }
+
+    // the output stays in GENERAL, the swapchain image goes to TRANSFER_DST for the blit
+    VkImageMemoryBarrier barriers[2] = {
+        post_image_barrier(post->output_image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL,
+                           VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT),
+        post_image_barrier(target, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0,
+                           VK_ACCESS_TRANSFER_WRITE_BIT),
+    };
+    vkCmdPipelineBarrier(cb, compute | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0,
+                         NULL, 2, barriers);
+    VkImageBlit blit = {
+        .srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+        .srcOffsets = {{0, 0, 0}, {(i32)pApp->vk_extent.width, (i32)pApp->vk_extent.height, 1}},
+        .dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+        .dstOffsets = {{0, 0, 0}, {(i32)pApp->vk_extent.width, (i32)pApp->vk_extent.height, 1}},
+    };
+    vkCmdBlitImage(cb, post->output_image, VK_IMAGE_LAYOUT_GENERAL, target, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
+                   &blit, VK_FILTER_NEAREST);
+    VkImageMemoryBarrier present_barrier = post_image_barrier(target, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                                              final_layout, VK_ACCESS_TRANSFER_WRITE_BIT, 0);
+    vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, NULL, 0, NULL,
+                         1, &present_barrier);
+}
@@ -0,0 +1,113 @@
+#ifndef POST_H
+#define POST_H
+
+#include "engine.h"
+
+// The post processing chain, all compute. With it the render pass draws the scene into an HDR target instead of the
+// swapchain image, and after the pass a chain of dispatches writes the final image:
+//
+//     HDR -> downsample (threshold, average luminance) -> downsample * (POST_BLOOM_LEVELS - 1)
+//         -> blur horizontal, blur vertical (the smallest level) -> upsample and add, back up to the first level
+//         -> tonemap (HDR + bloom, exposure from the luminance) -> the swapchain image
+//
+// The kernels load their tile of the source once into shared memory and filter from there, the luminance is reduced
+// with subgroup adds and one atomic per workgroup. The tonemap writes the swapchain image as a storage image when
+// its format allows it, otherwise an image of ours that is blitted into it. No render pass, no full screen
+// triangles, no framebuffers per level.
+//
+// It needs Vulkan 1.1 (subgroup arithmetic in compute shaders) and shaderStorageImageWriteWithoutFormat, without
+// them the scene renders straight into the swapchain as before.
+
+#define POST_BLOOM_LEVELS 5
+#define POST_TILE_SIZE 16 // the workgroups of the 2D kernels are POST_TILE_SIZE x POST_TILE_SIZE
+#define POST_BLUR_GROUP_SIZE 128
+#define POST_BLOOM_THRESHOLD 1.0f
+#define POST_BLOOM_STRENGTH 0.05f
+
+typedef enum PostKernel
+{
+    POST_KERNEL_DOWNSAMPLE,
+    POST_KERNEL_BLUR,
+    POST_KERNEL_UPSAMPLE,
+    POST_KERNEL_TONEMAP,
+    POST_KERNEL_COUNT,
+} PostKernel;
+
+// the same push constants for all the kernels, each reads what it needs
+typedef struct PostPushConstants PostPushConstants;
+struct PostPushConstants {
+    i32 src_size[2];
+    i32 dst_size[2];
+    i32 direction[2]; // blur: (1, 0) or (0, 1)
+    f32 threshold;    // downsample: > 0 for the first level, which also measures the luminance
+    f32 strength;     // tonemap: how much bloom is added
+};
+
+// what the downsample of the first level accumulates, read by the tonemap. Reset every frame
+typedef struct PostExposure PostExposure;
+struct PostExposure {
+    u32 log_luminance_sum; // per workgroup: its mean log2 luminance, fixed point (see post_downsample.comp)
+    u32 workgroup_count;
+};
+
+// one dispatch of the chain
+typedef struct PostPass PostPass;
+struct PostPass {
+    PostKernel kernel;
+    VkDescriptorSet descriptor_set;
+    PostPushConstants push_constants;
+    u32 group_count[2];
+};
+
+#define POST_MAX_PASSES (2 * POST_BLOOM_LEVELS + 1)
+
+struct PostChain {
+    // the scene target, what the render pass draws (and resolves) into
+    VkImage hdr_image;
+    VkDeviceMemory hdr_memory;
+    VkImageView hdr_view;
+
+    // the bloom levels, each half the size of the one above (the first is half the HDR), and the scratch of the blur
+    // (the size of the smallest level). Always in the GENERAL layout, read and written by compute only
+    VkImage bloom_images[POST_BLOOM_LEVELS];
+    VkDeviceMemory bloom_memories[POST_BLOOM_LEVELS];
+    VkImageView bloom_views[POST_BLOOM_LEVELS];
+    VkExtent2D bloom_extents[POST_BLOOM_LEVELS];
+    VkImage blur_image;
+    VkDeviceMemory blur_memory;
+    VkImageView blur_view;
+
+    // where the tonemap writes when the swapchain images are not storage images, blitted into them
+    VkImage output_image;
+    VkDeviceMemory output_memory;
+    VkImageView output_view;
+    VkFormat output_format;
+    bool encode_srgb; // the target is UNORM, the tonemap encodes. An SRGB target encodes on its own
+
+    VkBuffer exposure_buffer;
+    VkDeviceMemory exposure_memory;
+
+    VkSampler sampler;
+    VkDescriptorSetLayout descriptor_set_layout;
+    VkDescriptorPool descriptor_pool;
+    VkPipelineLayout pipeline_layout;
+    VkPipeline pipelines[POST_KERNEL_COUNT];
+
+    // everything up to the tonemap, the same every frame
+    PostPass passes[POST_MAX_PASSES];
+    u32 pass_count;
+    // the tonemap, one per swapchain image when it writes them directly
+    VkDescriptorSet* tonemap_sets;
+    u32 tonemap_set_count;
+};
+
+bool check_post_support(App* pApp);
+VkFormat choose_hdr_format(App* pApp);
+void choose_post_output(App* pApp);
+VkImageUsageFlags post_target_usage(App* pApp);
+void create_post_chain(App* pApp);
+void create_post_pipelines(App* pApp);
+void destroy_post_chain(App* pApp);
+void record_post(App* pApp, VkCommandBuffer command_buffer, u32 image_index);
+
+#endif // POST_H
@@ -0,0 +1,175 @@
+#include "engine.h"
+
+// the module of a SPIR-V file added before, or VK_NULL_HANDLE
+VkShaderModule find_shader_module(App* pApp, const char* filename)
+{
+    ShaderVariants* variants = &pApp->shader_variants;
+    for (u32 i = 0; i < variants->module_count; i += 1) {
+        if (strcmp(variants->modules[i].filename, filename) == 0) {
+            return variants->modules[i].module;
+        }
+    }
+    return VK_NULL_HANDLE;
+}
+
+// Registers the module of a SPIR-V file, or returns the one already there. Takes the binary either way
+VkShaderModule add_shader_module(App* pApp, const char* filename, Shader* binary)
+{
+    VkShaderModule module = find_shader_module(pApp, filename);
+    if (module != VK_NULL_HANDLE) {
+        free(binary->binary);
+        binary->binary = NULL;
+        return module;
+    }
+
+    ShaderVariants* variants = &pApp->shader_variants;
+
+    if (variants->module_count == variants->module_capacity) {
+        variants->module_capacity = variants->module_capacity > 0 ? variants->module_capacity * 2 : 8;
+        variants->modules =
+            (ShaderModuleEntry*)realloc(variants->modules, variants->module_capacity * sizeof(ShaderModuleEntry));
+    }
+    ShaderModuleEntry* entry = &variants->modules[variants->module_count++];
+    entry->filename = strdup(filename);
+    entry->module = create_shader_module(pApp, binary->binary, binary->size);
+    free(binary->binary);
+    binary->binary = NULL;
+    return entry->module;
+}
+
+// The pipeline specialized with the given constants, created the first time it is asked for. The variants are owned
+// here, the App only borrows the handles
+VkPipeline get_pipeline_variant(App* pApp, VkShaderModule vert_module, VkShaderModule frag_module,
+                                const VertexLayout* vertex_layout, DepthMode depth_mode,
+                                const ShaderConstants* constants)
+{
+    // the whole key is compared as bytes, so it starts zeroed (VertexLayout and ShaderConstants have no padding)
+    PipelineVariant key;
+    memset(&key, 0, sizeof(key));
+    key.vert_module = vert_module;
+    key.frag_module = frag_module;
+    key.has_vertex_input = vertex_layout != NULL;
+    if (vertex_layout != NULL) {
+        key.vertex_layout = *vertex_layout;
+    }
+    key.depth_mode = depth_mode;
+    key.constants = *constants;
+
+    ShaderVariants* variants = &pApp->shader_variants;
+    for (u32 i = 0; i < variants->pipeline_count; i += 1) {
+        const PipelineVariant* variant = &variants->pipelines[i];
+        if (variant->vert_module == key.vert_module && variant->frag_module == key.frag_module &&
+            variant->has_vertex_input == key.has_vertex_input && variant->depth_mode == key.depth_mode &&
+            memcmp(&variant->vertex_layout, &key.vertex_layout, sizeof(VertexLayout)) == 0 &&
+            memcmp(&variant->constants, &key.constants, sizeof(ShaderConstants)) == 0) {
+            variants->hits += 1;
+            return variant->pipeline;
+        }
+    }
+
+    key.pipeline = create_pipeline(pApp, vert_module, frag_module, vertex_layout, depth_mode, constants);
+    if (variants->pipeline_count == variants->pipeline_capacity) {
+        variants->pipeline_capacity = variants->pipeline_capacity > 0 ? variants->pipeline_capacity * 2 : 16;
+        variants->pipelines =
+            (PipelineVariant*)realloc(variants->pipelines, variants->pipeline_capacity * sizeof(PipelineVariant));
+    }
+    variants->pipelines[variants->pipeline_count++] = key;
+    printf("Pipeline variant %u created (depth mode %u, constants", variants->pipeline_count, (u32)depth_mode);
+    for (u32 i = 0; i < SHADER_CONSTANT_COUNT; i += 1) {
+        printf(" %u", constants->values[i]);
+    }
+    printf(")\n");
+    return key.pipeline;
+}
+
+// the variant of a pipeline handed out by get_pipeline_variant, or NULL
+PipelineVariant* find_pipeline_variant(App* pApp, VkPipeline pipeline)
+{
+    ShaderVariants* variants = &pApp->shader_variants;
+    for (u32 i = 0; i < variants->pipeline_count; i += 1) {
+        if (variants->pipelines[i].pipeline == pipeline) {
+            return &variants->pipelines[i];
+        }
+    }
+    return NULL;
+}
+
+// For a handle kept somewhere the trim does not look (the bench keeps the engine's aside while it swaps in its own):
+// pinned, the variant survives the memory pressure. Handles that are not variants are ignored
+void pin_pipeline_variant(App* pApp, VkPipeline pipeline)
+{
+    PipelineVariant* variant = find_pipeline_variant(pApp, pipeline);
+    if (variant != NULL) {
+        variant->pins += 1;
+    }
+}
+
+void unpin_pipeline_variant(App* pApp, VkPipeline pipeline)
+{
+    PipelineVariant* variant = find_pipeline_variant(pApp, pipeline);
+    if (variant != NULL && variant->pins > 0) {
+        variant->pins -= 1;
+    }
+}
+
+// Drops every module and variant while frames may still be in flight: the pipelines are retired, the modules are not
+// used by the GPU and go right away. For the reload, the next lookups build everything again from the new files
+void clear_shader_variants(App* pApp)
+{
+    ShaderVariants* variants = &pApp->shader_variants;
+    for (u32 i = 0; i < variants->pipeline_count; i += 1) {
+        retire_pipeline(pApp, variants->pipelines[i].pipeline);
+    }
+    variants->pipeline_count = 0;
+    for (u32 i = 0; i < variants->module_count; i += 1) {
+        vkDestroyShaderModule(pApp->vk_device, variants->modules[i].module, NULL);
+        free(variants->modules[i].filename);
+    }
+    variants->module_count = 0;
+}
+
+// Memory pressure: the variants the scene does not use right now (the other side of a toggle) and nobody pinned are
+// retired, the next toggle creates them again. The modules stay, the reload and the toggles need them
+void trim_shader_variants(App* pApp, u32 heap_index, MemoryPressure pressure, const MemoryStats* stats,
+                          void* user_data)
+{
+    UNUSED(heap_index);
+    UNUSED(stats);
+    UNUSED(user_data);
+    if (pressure == MEMORY_PRESSURE_LEVEL_NONE) {
+        return;
+    }
+
+    ShaderVariants* variants = &pApp->shader_variants;
+    u32 kept = 0;
+    for (u32 i = 0; i < variants->pipeline_count; i += 1) {
+        VkPipeline pipeline = variants->pipelines[i].pipeline;
+        if (pipeline == pApp->vk_pipeline || pipeline == pApp->vk_depth_prepass_pipeline ||
+            pipeline == pApp->vk_equal_pipeline || variants->pipelines[i].pins > 0) {
+            variants->pipelines[kept++] = variants->pipelines[i];
+        } else {
+            retire_pipeline(pApp, pipeline);
+        }
+    }
+    if (kept < variants->pipeline_count) {
+        printf("Shader variants: %u unused pipelines retired\n", variants->pipeline_count - kept);
+    }
+    variants->pipeline_count = kept;
+}
+
+void destroy_shader_variants(App* pApp)
+{
+    ShaderVariants* variants = &pApp->shader_variants;
+    printf("%u pipeline variants from %u shader modules (%llu lookups reused one)\n", variants->pipeline_count,
+           variants->module_count, (unsigned long long)variants->hits);
+    for (u32 i = 0; i < variants->pipeline_count; i += 1) {
+        vkDestroyPipeline(pApp->vk_device, variants->pipelines[i].pipeline, NULL);
+    }
+    for (u32 i = 0; i < variants->module_count; i += 1) {
+        vkDestroyShaderModule(pApp->vk_device, variants->modules[i].module, NULL);
+        free(variants->modules[i].filename);
+    }
+    free(variants->pipelines);
+    free(variants->modules);
+    *variants = (ShaderVariants){0};
+}
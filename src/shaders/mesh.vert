@@ -0,0 +1,43 @@
+#version 450
+
+// One module for every vertex format, specialized for it (see ShaderConstantId). The vertex fetch already unpacks the
+// snorm16/half positions and the rgba8 colors
+layout(constant_id = 0) const bool OCTAHEDRAL_NORMALS = false;
+
+// position * scale + bias dequantizes the positions and fits the mesh in the view, see MeshPushConstants
+layout(push_constant) uniform MeshPushConstants {
+    vec4 scale;
+    vec4 bias;
+} pc;
+
+layout(location = 0) in vec3 inPosition;
+// xyz for MESH_VERTEX_FORMAT_F32. The packed formats fetch two components, the octahedral encoding, and z is 0
+layout(location = 1) in vec3 inNormal;
+layout(location = 2) in vec3 inColor;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec3 fragPosition; // see shader.frag
+layout(location = 2) out vec3 fragNormal;
+
+// the depth prepass and the EQUAL pass must compute the exact same depth
+invariant gl_Position;
+
+vec3 oct_decode(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+void main() {
+    vec3 p = inPosition * pc.scale.xyz + pc.bias.xyz;
+
+    // orthographic, looking down -z with y up. Reversed-Z: nearer (bigger z) gets the bigger depth
+    gl_Position = vec4(p.x, -p.y, 0.5 + 0.5 * p.z, 1.0);
+    fragPosition = p;
+    fragColor = inColor;
+
+    // a constant branch, the driver folds it away. The lighting is per fragment
+    fragNormal = OCTAHEDRAL_NORMALS ? oct_decode(inNormal.xy) : normalize(inNormal);
+}
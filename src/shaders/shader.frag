@@ -1,9 +1,64 @@
 #version 450
 
+// Clustered forward shading: the fragment finds its cluster from its position and loops over the lights that
+// cluster_lights.comp binned there, at most CLUSTER_MAX_LIGHTS whatever the number of lights (see lighting.h)
+layout(constant_id = 1) const bool LIGHTING = true;
+
+#define CLUSTER_X 16
+#define CLUSTER_Y 12
+#define CLUSTER_Z 16
+#define CLUSTER_COUNT (CLUSTER_X * CLUSTER_Y * CLUSTER_Z)
+#define CLUSTER_MAX_LIGHTS 128
+
+struct PointLight {
+    vec4 position_radius;
+    vec4 color;
+};
+
+layout(set = 0, binding = 0) readonly buffer Lights {
+    PointLight lights[];
+};
+layout(set = 0, binding = 1) readonly buffer Clusters {
+    uint light_counts[CLUSTER_COUNT];
+    uint light_indices[];
+};
+
+// Every vertex shader of the scene writes these. The position is in the space of the scene and of the clusters: x, y
+// and z in [-1, 1], y up and z towards the viewer. The shaders without normals give one facing the viewer
 layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec3 fragPosition;
+layout(location = 2) in vec3 fragNormal;
 
 layout(location = 0) out vec4 outColor;
 
 void main() {
-    outColor = vec4(fragColor, 1.0);
+    // a constant branch, the driver folds it away
+    if (!LIGHTING) {
+        outColor = vec4(fragColor, 1.0);
+        return;
+    }
+
+    vec3 normal = normalize(fragNormal);
+    // a dim sun, so the point lights show
+    vec3 light = vec3(0.1 + 0.4 * max(dot(normal, normalize(vec3(0.3, 0.6, 0.7))), 0.0));
+
+    ivec3 dims = ivec3(CLUSTER_X, CLUSTER_Y, CLUSTER_Z);
+    ivec3 c = clamp(ivec3((fragPosition + 1.0) * 0.5 * vec3(dims)), ivec3(0), dims - 1);
+    uint cluster = uint((c.z * CLUSTER_Y + c.y) * CLUSTER_X + c.x);
+    uint count = light_counts[cluster];
+    for (uint i = 0; i < count; i += 1) {
+        PointLight point = lights[light_indices[cluster * CLUSTER_MAX_LIGHTS + i]];
+        vec3 to_light = point.position_radius.xyz - fragPosition;
+        float d2 = dot(to_light, to_light);
+        float r2 = point.position_radius.w * point.position_radius.w;
+        if (d2 >= r2) {
+            continue;
+        }
+        // smooth falloff to 0 at the radius, the binning drops nothing that still lights
+        float falloff = 1.0 - d2 / r2;
+        float diffuse = max(dot(normal, to_light * inversesqrt(max(d2, 1e-8))), 0.0);
+        light += point.color.rgb * (falloff * falloff * diffuse);
+    }
+
+    outColor = vec4(fragColor * light, 1.0);
 }
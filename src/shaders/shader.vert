@@ -1,6 +1,10 @@
 #version 450
 
 layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec3 fragPosition; // see shader.frag
+layout(location = 2) out vec3 fragNormal;
+
+invariant gl_Position; // see mesh.vert
 
 vec2 positions[3] = vec2[](
         vec2(0.0, -0.5),
@@ -16,6 +20,9 @@ vec3 colors[3] = vec3[](
 
 // the entry point
 void main() {
-    gl_Position = vec4(positions[gl_VertexIndex], 0.0, 1.0);
-    fragColor = colors[gl_VertexIndex];
+    // modulo, so several triangles (or draws with a firstVertex) reuse the same three corners
+    gl_Position = vec4(positions[gl_VertexIndex % 3], 0.0, 1.0);
+    fragColor = colors[gl_VertexIndex % 3];
+    fragPosition = vec3(gl_Position.x, -gl_Position.y, -1.0); // depth 0 is z = -1
+    fragNormal = vec3(0.0, 0.0, 1.0);
 }
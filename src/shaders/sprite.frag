@@ -0,0 +1,14 @@
+#version 450
+
+// all the sprite textures are layers of this array, the quad says which one
+layout(set = 0, binding = 0) uniform sampler2DArray textures;
+
+layout(location = 0) in vec2 fragUv;
+layout(location = 1) in vec4 fragColor;
+layout(location = 2) flat in uint fragTexture;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    outColor = fragColor * texture(textures, vec3(fragUv, float(fragTexture)));
+}
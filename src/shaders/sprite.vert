@@ -0,0 +1,32 @@
+#version 450
+
+// One instance per quad, see SpriteInstance. No vertex buffer for the corners: the six vertices of the two triangles
+// come from gl_VertexIndex
+layout(push_constant) uniform SpritePushConstants {
+    vec2 scale; // pixels to NDC, 2 / extent
+} pc;
+
+layout(location = 0) in vec4 inRect; // x, y, width, height in pixels
+layout(location = 1) in vec4 inUv;   // u0, v0, u1, v1
+layout(location = 2) in vec4 inColor;
+layout(location = 3) in uint inTexture;
+
+layout(location = 0) out vec2 fragUv;
+layout(location = 1) out vec4 fragColor;
+layout(location = 2) flat out uint fragTexture;
+
+const vec2 corners[6] = vec2[](
+    vec2(0.0, 0.0), vec2(1.0, 0.0), vec2(1.0, 1.0),
+    vec2(0.0, 0.0), vec2(1.0, 1.0), vec2(0.0, 1.0)
+);
+
+void main() {
+    vec2 corner = corners[gl_VertexIndex];
+    vec2 pixel = inRect.xy + corner * inRect.zw;
+
+    // y down in pixels and in Vulkan's NDC. Depth is not tested
+    gl_Position = vec4(pixel * pc.scale - 1.0, 0.0, 1.0);
+    fragUv = mix(inUv.xy, inUv.zw, corner);
+    fragColor = inColor;
+    fragTexture = inTexture;
+}
@@ -0,0 +1,611 @@
+#include "sprites.h"
+
+#include <math.h>
+#include <stddef.h>
+
+// the procedural textures, one per layer: soft discs, rings, rounded boxes and checkers in different colors. There is
+// no image loader, this is enough to see the batching work
+void fill_sprite_texture(u8* pixels, u32 layer)
+{
+    f32 hue = (f32)layer / (f32)SPRITE_TEXTURE_LAYERS * 6.0f;
+    f32 rgb[3] = {
+        fminf(fmaxf(fabsf(hue - 3.0f) - 1.0f, 0.0f), 1.0f),
+        fminf(fmaxf(2.0f - fabsf(hue - 2.0f), 0.0f), 1.0f),
+        fminf(fmaxf(2.0f - fabsf(hue - 4.0f), 0.0f), 1.0f),
+    };
+
+    for (u32 y = 0; y < SPRITE_TEXTURE_SIZE; y += 1) {
+        for (u32 x = 0; x < SPRITE_TEXTURE_SIZE; x += 1) {
+            // -1..1 from the center
+            f32 u = ((f32)x + 0.5f) / (f32)SPRITE_TEXTURE_SIZE * 2.0f - 1.0f;
+            f32 v = ((f32)y + 0.5f) / (f32)SPRITE_TEXTURE_SIZE * 2.0f - 1.0f;
+            f32 r = sqrtf(u * u + v * v);
+            f32 alpha;
+            switch (layer % 4) {
+            case 0:
+                alpha = fminf(fmaxf((1.0f - r) * 4.0f, 0.0f), 1.0f);
+                break;
+            case 1:
+                alpha = fminf(fmaxf(1.0f - fabsf(r - 0.7f) * 8.0f, 0.0f), 1.0f);
+                break;
+            case 2:
+                alpha = fmaxf(fabsf(u), fabsf(v)) < 0.85f ? 1.0f : 0.0f;
+                break;
+            default:
+                alpha = ((x / 8 + y / 8) % 2 == 0) ? 1.0f : 0.5f;
+                break;
+            }
+            u8* pixel = &pixels[(y * SPRITE_TEXTURE_SIZE + x) * 4];
+            for (u32 k = 0; k < 3; k += 1) {
+                pixel[k] = (u8)(rgb[k] * 255.0f + 0.5f);
+            }
+            pixel[3] = (u8)(alpha * 255.0f + 0.5f);
+        }
+    }
+}
+
+void transition_sprite_texture(VkCommandBuffer command_buffer, VkImage image, VkImageLayout old_layout,
+                               VkImageLayout new_layout, VkAccessFlags src_access, VkAccessFlags dst_access,
+                               VkPipelineStageFlags src_stage, VkPipelineStageFlags dst_stage)
+{
+    VkImageMemoryBarrier barrier = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = src_access,
+        .dstAccessMask = dst_access,
+        .oldLayout = old_layout,
+        .newLayout = new_layout,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = image,
+        .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, SPRITE_TEXTURE_LAYERS},
+    };
+    vkCmdPipelineBarrier(command_buffer, src_stage, dst_stage, 0, 0, NULL, 0, NULL, 1, &barrier);
+}
+
+// All the sprite textures are layers of one array, so switching textures never breaks a batch. It works everywhere,
+// bindless (descriptor indexing) would lift the size limit but needs Vulkan 1.2 or the extension
+void create_sprite_textures(App* pApp, SpriteRenderer* sprites)
+{
+    VkImageCreateInfo image_info = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = VK_FORMAT_R8G8B8A8_UNORM,
+        .extent = {SPRITE_TEXTURE_SIZE, SPRITE_TEXTURE_SIZE, 1},
+        .mipLevels = 1,
+        .arrayLayers = SPRITE_TEXTURE_LAYERS,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+    };
+    if (vkCreateImage(pApp->vk_device, &image_info, NULL, &sprites->texture_image) != VK_SUCCESS) {
+        printf("Failed to create the sprite texture array!\n");
+        exit(1);
+    }
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements(pApp->vk_device, sprites->texture_image, &requirements);
+    u32 memory_type = find_memory_type(pApp, requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    sprites->texture_memory = allocate_memory(pApp, requirements.size, memory_type, MEMORY_CATEGORY_IMAGE);
+    vkBindImageMemory(pApp->vk_device, sprites->texture_image, sprites->texture_memory, 0);
+
+    // the layers one after the other in a staging buffer, one copy for all of them
+    VkDeviceSize layer_size = SPRITE_TEXTURE_SIZE * SPRITE_TEXTURE_SIZE * 4;
+    VkDeviceSize size = layer_size * SPRITE_TEXTURE_LAYERS;
+    VkBuffer staging_buffer;
+    VkDeviceMemory staging_memory;
+    create_buffer(pApp, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MEMORY_CATEGORY_STAGING,
+                  &staging_buffer, &staging_memory);
+    u8* mapped;
+    vkMapMemory(pApp->vk_device, staging_memory, 0, size, 0, (void**)&mapped);
+    for (u32 layer = 0; layer < SPRITE_TEXTURE_LAYERS; layer += 1) {
+        fill_sprite_texture(mapped + layer * layer_size, layer);
+    }
+    vkUnmapMemory(pApp->vk_device, staging_memory);
+
+    VkCommandBuffer command_buffer = begin_single_time_commands(pApp);
+    transition_sprite_texture(command_buffer, sprites->texture_image, VK_IMAGE_LAYOUT_UNDEFINED,
+                              VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, VK_ACCESS_TRANSFER_WRITE_BIT,
+                              VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+    VkBufferImageCopy region = {
+        .bufferOffset = 0,
+        .imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, SPRITE_TEXTURE_LAYERS},
+        .imageExtent = {SPRITE_TEXTURE_SIZE, SPRITE_TEXTURE_SIZE, 1},
+    };
+    vkCmdCopyBufferToImage(command_buffer, staging_buffer, sprites->texture_image,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+    transition_sprite_texture(command_buffer, sprites->texture_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                              VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT,
+                              VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                              VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    end_single_time_commands(pApp, command_buffer);
+
+    vkDestroyBuffer(pApp->vk_device, staging_buffer, NULL);
+    free_memory(pApp, staging_memory);
+
+    VkImageViewCreateInfo view_info = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .image = sprites->texture_image,
+        .viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY,
+        .format = VK_FORMAT_R8G8B8A8_UNORM,
+        .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, SPRITE_TEXTURE_LAYERS},
+    };
+    if (vkCreateImageView(pApp->vk_device, &view_info, NULL, &sprites->texture_view) != VK_SUCCESS) {
+        printf("Failed to create the sprite texture view!\n");
+        exit(1);
+    }
+
+    VkSamplerCreateInfo sampler_info = {
+        .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+        .magFilter = VK_FILTER_LINEAR,
+        .minFilter = VK_FILTER_LINEAR,
+        .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+        .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .maxLod = 0.0f,
+    };
+    if (vkCreateSampler(pApp->vk_device, &sampler_info, NULL, &sprites->sampler) != VK_SUCCESS) {
+        printf("Failed to create the sprite sampler!\n");
+        exit(1);
+    }
+}
+
+// one combined image sampler, the whole texture array
+void create_sprite_descriptors(App* pApp, SpriteRenderer* sprites)
+{
+    VkDescriptorSetLayoutBinding binding = {
+        .binding = 0,
+        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .descriptorCount = 1,
+        .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+    };
+    VkDescriptorSetLayoutCreateInfo layout_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = 1,
+        .pBindings = &binding,
+    };
+    if (vkCreateDescriptorSetLayout(pApp->vk_device, &layout_info, NULL, &sprites->descriptor_set_layout) !=
+        VK_SUCCESS) {
+        printf("Failed to create the sprite descriptor set layout!\n");
+        exit(1);
+    }
+
+    VkDescriptorPoolSize pool_size = {
+        .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .descriptorCount = 1,
+    };
+    VkDescriptorPoolCreateInfo pool_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .maxSets = 1,
+        .poolSizeCount = 1,
+        .pPoolSizes = &pool_size,
+    };
+    if (vkCreateDescriptorPool(pApp->vk_device, &pool_info, NULL, &sprites->descriptor_pool) != VK_SUCCESS) {
+        printf("Failed to create the sprite descriptor pool!\n");
+        exit(1);
+    }
+
+    VkDescriptorSetAllocateInfo alloc_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = sprites->descriptor_pool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &sprites->descriptor_set_layout,
+    };
+    if (vkAllocateDescriptorSets(pApp->vk_device, &alloc_info, &sprites->descriptor_set) != VK_SUCCESS) {
+        printf("Failed to allocate the sprite descriptor set!\n");
+        exit(1);
+    }
+
+    VkDescriptorImageInfo image_info = {
+        .sampler = sprites->sampler,
+        .imageView = sprites->texture_view,
+        .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+    };
+    VkWriteDescriptorSet write = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = sprites->descriptor_set,
+        .dstBinding = 0,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .pImageInfo = &image_info,
+    };
+    vkUpdateDescriptorSets(pApp->vk_device, 1, &write, 0, NULL);
+
+    VkPushConstantRange push_constant_range = {
+        .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+        .offset = 0,
+        .size = sizeof(SpritePushConstants),
+    };
+    VkPipelineLayoutCreateInfo pipeline_layout_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 1,
+        .pSetLayouts = &sprites->descriptor_set_layout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &push_constant_range,
+    };
+    if (vkCreatePipelineLayout(pApp->vk_device, &pipeline_layout_info, NULL, &sprites->pipeline_layout) !=
+        VK_SUCCESS) {
+        printf("Failed to create the sprite pipeline layout!\n");
+        exit(1);
+    }
+}
+
+// The vertex stream. Host visible device local memory when there is some (resizable BAR, unified memory), plain host
+// memory otherwise: the GPU reads each quad once, it is not worth a copy
+void create_sprite_ring_buffer(App* pApp, SpriteRenderer* sprites)
+{
+    VkDeviceSize size = (VkDeviceSize)MAX_FRAMES_IN_FLIGHT * SPRITE_MAX_QUADS * sizeof(SpriteInstance);
+    VkBufferCreateInfo buffer_info = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = size,
+        .usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+    if (vkCreateBuffer(pApp->vk_device, &buffer_info, NULL, &sprites->buffer) != VK_SUCCESS) {
+        printf("Failed to create the sprite ring buffer!\n");
+        exit(1);
+    }
+
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(pApp->vk_device, sprites->buffer, &requirements);
+    VkMemoryPropertyFlags host = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    u32 memory_type;
+    sprites->device_local = try_find_memory_type(pApp, requirements.memoryTypeBits,
+                                                 host | VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &memory_type);
+    if (!sprites->device_local) {
+        memory_type = find_memory_type(pApp, requirements.memoryTypeBits, host);
+    }
+    sprites->memory = allocate_memory(pApp, requirements.size, memory_type, MEMORY_CATEGORY_STREAMING);
+    vkBindBufferMemory(pApp->vk_device, sprites->buffer, sprites->memory, 0);
+
+    // mapped once, for as long as the renderer lives
+    if (vkMapMemory(pApp->vk_device, sprites->memory, 0, size, 0, (void**)&sprites->mapped) != VK_SUCCESS) {
+        printf("Failed to map the sprite ring buffer!\n");
+        exit(1);
+    }
+    printf("Sprite ring buffer: %.2f MB in %s memory (type %u)\n", (f64)size / (1024.0 * 1024.0),
+           sprites->device_local ? "host visible device local" : "host", memory_type);
+}
+
+void create_sprite_renderer(App* pApp)
+{
+    SpriteRenderer* sprites = (SpriteRenderer*)calloc(1, sizeof(SpriteRenderer));
+    sprites->instances = (SpriteInstance*)malloc(SPRITE_MAX_QUADS * sizeof(SpriteInstance));
+    sprites->keys = (u32*)malloc(SPRITE_MAX_QUADS * sizeof(u32));
+    sprites->order = (u32*)malloc(SPRITE_MAX_QUADS * sizeof(u32));
+    sprites->scratch_keys = (u32*)malloc(SPRITE_MAX_QUADS * sizeof(u32));
+    sprites->scratch_order = (u32*)malloc(SPRITE_MAX_QUADS * sizeof(u32));
+    pApp->sprites = sprites;
+
+    create_sprite_ring_buffer(pApp, sprites);
+    create_sprite_textures(pApp, sprites);
+    create_sprite_descriptors(pApp, sprites);
+    create_sprite_pipelines(pApp);
+    printf("Sprite renderer created (%u quads per frame, %u textures).\n", SPRITE_MAX_QUADS, SPRITE_TEXTURE_LAYERS);
+}
+
+void destroy_sprite_renderer(App* pApp)
+{
+    SpriteRenderer* sprites = pApp->sprites;
+    VkDevice device = pApp->vk_device;
+    for (u32 i = 0; i < SPRITE_BLEND_COUNT; i += 1) {
+        vkDestroyPipeline(device, sprites->pipelines[i], NULL);
+    }
+    vkDestroyPipelineLayout(device, sprites->pipeline_layout, NULL);
+    vkDestroyDescriptorPool(device, sprites->descriptor_pool, NULL);
+    vkDestroyDescriptorSetLayout(device, sprites->descriptor_set_layout, NULL);
+    vkDestroySampler(device, sprites->sampler, NULL);
+    vkDestroyImageView(device, sprites->texture_view, NULL);
+    vkDestroyImage(device, sprites->texture_image, NULL);
+    free_memory(pApp, sprites->texture_memory);
+    vkUnmapMemory(device, sprites->memory);
+    vkDestroyBuffer(device, sprites->buffer, NULL);
+    free_memory(pApp, sprites->memory);
+
+    free(sprites->instances);
+    free(sprites->keys);
+    free(sprites->order);
+    free(sprites->scratch_keys);
+    free(sprites->scratch_order);
+    free(sprites);
+    pApp->sprites = NULL;
+}
+
+// One pipeline per blend mode. The modules go through the shader variants, so a reload (F5) reads them again
+void create_sprite_pipelines(App* pApp)
+{
+    SpriteRenderer* sprites = pApp->sprites;
+    const char* vert_filename = "build/shaders/sprite_vertex.spv";
+    const char* frag_filename = "build/shaders/sprite_fragment.spv";
+    VkShaderModule vert_module = find_shader_module(pApp, vert_filename);
+    if (vert_module == VK_NULL_HANDLE) {
+        Shader binary = read_file(vert_filename);
+        vert_module = add_shader_module(pApp, vert_filename, &binary);
+    }
+    VkShaderModule frag_module = find_shader_module(pApp, frag_filename);
+    if (frag_module == VK_NULL_HANDLE) {
+        Shader binary = read_file(frag_filename);
+        frag_module = add_shader_module(pApp, frag_filename, &binary);
+    }
+
+    VkPipelineShaderStageCreateInfo shader_stages[] = {
+        {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_VERTEX_BIT,
+            .module = vert_module,
+            .pName = "main",
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+            .module = frag_module,
+            .pName = "main",
+        },
+    };
+
+    // one SpriteInstance per instance, nothing per vertex
+    VkVertexInputBindingDescription binding = {
+        .binding = 0,
+        .stride = sizeof(SpriteInstance),
+        .inputRate = VK_VERTEX_INPUT_RATE_INSTANCE,
+    };
+    VkVertexInputAttributeDescription attributes[] = {
+        {0, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(SpriteInstance, rect)},
+        {1, 0, VK_FORMAT_R16G16B16A16_UNORM, offsetof(SpriteInstance, uv)},
+        {2, 0, VK_FORMAT_R8G8B8A8_UNORM, offsetof(SpriteInstance, color)},
+        {3, 0, VK_FORMAT_R32_UINT, offsetof(SpriteInstance, texture)},
+    };
+    VkPipelineVertexInputStateCreateInfo vertex_input_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+        .vertexBindingDescriptionCount = 1,
+        .pVertexBindingDescriptions = &binding,
+        .vertexAttributeDescriptionCount = sizeof(attributes) / sizeof(attributes[0]),
+        .pVertexAttributeDescriptions = attributes,
+    };
+    VkPipelineInputAssemblyStateCreateInfo input_assembly = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+        .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+    };
+    VkDynamicState dynamic_states[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    VkPipelineDynamicStateCreateInfo dynamic_state = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+        .dynamicStateCount = 2,
+        .pDynamicStates = dynamic_states,
+    };
+    VkPipelineViewportStateCreateInfo viewport_state = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+        .viewportCount = 1,
+        .scissorCount = 1,
+    };
+    VkPipelineRasterizationStateCreateInfo rasterizer = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+        .polygonMode = VK_POLYGON_MODE_FILL,
+        .lineWidth = 1.0f,
+        .cullMode = VK_CULL_MODE_NONE,
+        .frontFace = VK_FRONT_FACE_CLOCKWISE,
+    };
+    VkPipelineMultisampleStateCreateInfo multisampling = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+        .rasterizationSamples = pApp->vk_msaa_samples,
+        .minSampleShading = 1.0f,
+    };
+    // on top of the scene, in the order they were sorted in
+    VkPipelineDepthStencilStateCreateInfo depth_stencil = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+        .depthTestEnable = VK_FALSE,
+        .depthWriteEnable = VK_FALSE,
+        .depthCompareOp = VK_COMPARE_OP_ALWAYS,
+    };
+
+    for (u32 blend = 0; blend < SPRITE_BLEND_COUNT; blend += 1) {
+        VkPipelineColorBlendAttachmentState color_blend_attachment = {
+            .blendEnable = VK_TRUE,
+            .srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA,
+            .dstColorBlendFactor =
+                blend == SPRITE_BLEND_ADDITIVE ? VK_BLEND_FACTOR_ONE : VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+            .colorBlendOp = VK_BLEND_OP_ADD,
+            .srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
+            .dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+            .alphaBlendOp = VK_BLEND_OP_ADD,
+            .colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT |
+                              VK_COLOR_COMPONENT_A_BIT,
+        };
+        VkPipelineColorBlendStateCreateInfo color_blending = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+            .attachmentCount = 1,
+            .pAttachments = &color_blend_attachment,
+        };
+
+        VkGraphicsPipelineCreateInfo pipeline_info = {
+            .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+            .stageCount = 2,
+            .pStages = shader_stages,
+            .pVertexInputState = &vertex_input_info,
+            .pInputAssemblyState = &input_assembly,
+            .pViewportState = &viewport_state,
+            .pRasterizationState = &rasterizer,
+            .pMultisampleState = &multisampling,
+            .pDepthStencilState = &depth_stencil,
+            .pColorBlendState = &color_blending,
+            .pDynamicState = &dynamic_state,
+            .layout = sprites->pipeline_layout,
+            .renderPass = pApp->vk_renderpass,
+            .subpass = 0,
+        };
+        if (vkCreateGraphicsPipelines(pApp->vk_device, VK_NULL_HANDLE, 1, &pipeline_info, NULL,
+                                      &sprites->pipelines[blend]) != VK_SUCCESS) {
+            printf("Failed to create the sprite pipelines!\n");
+            exit(1);
+        }
+    }
+    invalidate_commands(pApp, CACHE_CONTENT_SPRITES);
+}
+
+void begin_sprites(App* pApp)
+{
+    pApp->sprites->count = 0;
+    pApp->sprites->dropped = 0;
+}
+
+// The layer decides the draw order. Inside a layer the blend mode, then the texture: the texture array means the
+// texture never splits a batch, but the quads of one texture stay together in memory
+u32 sprite_sort_key(const Sprite* sprite)
+{
+    return ((u32)sprite->layer << 24) | ((u32)sprite->blend << 16) | (sprite->texture & 0xffff);
+}
+
+u16 to_unorm16(f32 value)
+{
+    value = value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+    return (u16)(value * 65535.0f + 0.5f);
+}
+
+void draw_sprite(App* pApp, const Sprite* sprite)
+{
+    SpriteRenderer* sprites = pApp->sprites;
+    if (sprites->count == SPRITE_MAX_QUADS) {
+        sprites->dropped += 1;
+        return;
+    }
+
+    u32 index = sprites->count++;
+    SpriteInstance* instance = &sprites->instances[index];
+    instance->rect[0] = sprite->x;
+    instance->rect[1] = sprite->y;
+    instance->rect[2] = sprite->width;
+    instance->rect[3] = sprite->height;
+    for (u32 k = 0; k < 4; k += 1) {
+        instance->uv[k] = to_unorm16(sprite->uv[k]);
+        instance->color[k] = (u8)(sprite->color >> (8 * k));
+    }
+    instance->texture = sprite->texture;
+    sprites->keys[index] = sprite_sort_key(sprite);
+}
+
+// LSD radix sort of the keys, 8 bits a pass, carrying the indices along. Stable, so equal keys keep the order they were
+// drawn in. A pass where every key has the same digit is skipped: with few layers and textures most of them are
+void radix_sort_keys(u32* keys, u32* order, u32* scratch_keys, u32* scratch_order, u32 count)
+{
+    u32* src_keys = keys;
+    u32* src_order = order;
+    u32* dst_keys = scratch_keys;
+    u32* dst_order = scratch_order;
+
+    for (u32 shift = 0; shift < 32; shift += 8) {
+        u32 offsets[256] = {0};
+        for (u32 i = 0; i < count; i += 1) {
+            offsets[(src_keys[i] >> shift) & 0xff] += 1;
+        }
+        if (count == 0 || offsets[(src_keys[0] >> shift) & 0xff] == count) {
+            continue;
+        }
+        u32 sum = 0;
+        for (u32 d = 0; d < 256; d += 1) {
+            u32 digit_count = offsets[d];
+            offsets[d] = sum;
+            sum += digit_count;
+        }
+        for (u32 i = 0; i < count; i += 1) {
+            u32 slot = offsets[(src_keys[i] >> shift) & 0xff]++;
+            dst_keys[slot] = src_keys[i];
+            dst_order[slot] = src_order[i];
+        }
+
+        u32* swap_keys = src_keys;
+        u32* swap_order = src_order;
+        src_keys = dst_keys;
+        src_order = dst_order;
+        dst_keys = swap_keys;
+        dst_order = swap_order;
+    }
+
+    if (src_keys != keys) {
+        memcpy(keys, src_keys, count * sizeof(u32));
+        memcpy(order, src_order, count * sizeof(u32));
+    }
+}
+
+// Sorts, writes the frame's region of the ring buffer and builds the batches. Call it before draw_frame
+void end_sprites(App* pApp)
+{
+    f64 start_ms = now_ms();
+    SpriteRenderer* sprites = pApp->sprites;
+    u32 count = sprites->count;
+
+    for (u32 i = 0; i < count; i += 1) {
+        sprites->order[i] = i;
+    }
+    radix_sort_keys(sprites->keys, sprites->order, sprites->scratch_keys, sprites->scratch_order, count);
+
+    // the region of this frame slot was last read by the frame draw_frame is about to wait for anyway. The sort above
+    // ran while the GPU was still on it
+    f64 wait_start_ms = now_ms();
+    wait_timeline_value(pApp, pApp->frame_timeline_values[pApp->current_frame]);
+    sprites->wait_ms = now_ms() - wait_start_ms;
+
+    // gathered in sorted order, so the writes to the mapped memory are sequential (it is often write combined)
+    SpriteInstance* region = sprites->mapped + (u64)pApp->current_frame * SPRITE_MAX_QUADS;
+    for (u32 i = 0; i < count; i += 1) {
+        region[i] = sprites->instances[sprites->order[i]];
+    }
+
+    // a new batch only where the blend mode, so the pipeline, changes
+    SpriteBatch batches[SPRITE_MAX_BATCHES];
+    u32 batch_count = 0;
+    for (u32 i = 0; i < count; i += 1) {
+        SpriteBlend blend = (SpriteBlend)((sprites->keys[i] >> 16) & 0xff);
+        if (batch_count > 0 && batches[batch_count - 1].blend == blend) {
+            batches[batch_count - 1].instance_count += 1;
+            continue;
+        }
+        if (batch_count == SPRITE_MAX_BATCHES) {
+            sprites->dropped += count - i;
+            break;
+        }
+        batches[batch_count++] = (SpriteBatch){.blend = blend, .first_instance = i, .instance_count = 1};
+    }
+
+    // the recorded draws only depend on the batches, not on the quads in the buffer: the cached secondary command
+    // buffers stay valid as long as the batches do
+    if (batch_count != sprites->batch_count ||
+        memcmp(batches, sprites->batches, batch_count * sizeof(SpriteBatch)) != 0) {
+        memcpy(sprites->batches, batches, batch_count * sizeof(SpriteBatch));
+        sprites->batch_count = batch_count;
+        invalidate_commands(pApp, CACHE_CONTENT_SPRITES);
+    }
+    sprites->end_ms = now_ms() - start_ms - sprites->wait_ms;
+}
+
+// whether the frame has a sprites bucket at all
+bool has_sprites(App* pApp)
+{
+    return pApp->sprites != NULL && pApp->sprites->batch_count > 0;
+}
+
+// in the render pass, after the scene. Reads the region of the current frame slot
+void record_sprites(App* pApp, VkCommandBuffer command_buffer)
+{
+    SpriteRenderer* sprites = pApp->sprites;
+
+    VkDeviceSize offset = (VkDeviceSize)pApp->current_frame * SPRITE_MAX_QUADS * sizeof(SpriteInstance);
+    vkCmdBindVertexBuffers(command_buffer, 0, 1, &sprites->buffer, &offset);
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, sprites->pipeline_layout, 0, 1,
+                            &sprites->descriptor_set, 0, NULL);
+    SpritePushConstants push_constants = {
+        .scale = {2.0f / (f32)pApp->vk_extent.width, 2.0f / (f32)pApp->vk_extent.height},
+    };
+    vkCmdPushConstants(command_buffer, sprites->pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(push_constants),
+                       &push_constants);
+
+    i32 bound_blend = -1;
+    for (u32 i = 0; i < sprites->batch_count; i += 1) {
+        const SpriteBatch* batch = &sprites->batches[i];
+        if ((i32)batch->blend != bound_blend) {
+            vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, sprites->pipelines[batch->blend]);
+            bound_blend = (i32)batch->blend;
+        }
+        vkCmdDraw(command_buffer, 6, batch->instance_count, 0, batch->first_instance);
+    }
+}
@@ -0,0 +1,111 @@
+#ifndef SPRITES_H
+#define SPRITES_H
+
+#include "engine.h"
+
+// The 2D batch renderer, for the UI and the overlays: tens of thousands of textured quads a frame in a handful of
+// draws. A frame of sprites goes
+//
+//     begin_sprites -> draw_sprite * N -> end_sprites -> draw_frame
+//
+// draw_sprite only appends to a CPU array. end_sprites radix sorts the quads by their key (layer, blend mode,
+// texture), gathers them in that order into the persistently mapped ring buffer and merges them into batches. All
+// the textures are layers of one texture array, so only a change of blend mode (of pipeline) starts a new draw. The
+// quads are drawn after the scene, in the same render pass, without depth test.
+
+#define SPRITE_MAX_QUADS 65536 // per frame
+#define SPRITE_MAX_BATCHES 256
+#define SPRITE_TEXTURE_SIZE 64
+#define SPRITE_TEXTURE_LAYERS 16
+
+typedef enum SpriteBlend
+{
+    SPRITE_BLEND_ALPHA,    // src * a + dst * (1 - a)
+    SPRITE_BLEND_ADDITIVE, // src * a + dst
+    SPRITE_BLEND_COUNT,
+} SpriteBlend;
+
+// what draw_sprite takes. Positions and sizes in pixels, y down
+typedef struct Sprite Sprite;
+struct Sprite {
+    f32 x;
+    f32 y;
+    f32 width;
+    f32 height;
+    f32 uv[4];   // u0, v0, u1, v1 in the texture
+    u32 color;   // rgba8, r in the low byte. Multiplies the texture
+    u32 texture; // a layer of the texture array, < SPRITE_TEXTURE_LAYERS
+    u8 layer;    // drawn in increasing layer order. In a layer, same blend and texture keep their order
+    SpriteBlend blend;
+};
+
+// one quad in the vertex stream, per instance: the six vertices of its two triangles come from gl_VertexIndex
+typedef struct SpriteInstance SpriteInstance;
+struct SpriteInstance {
+    f32 rect[4]; // x, y, width, height
+    u16 uv[4];   // unorm16
+    u8 color[4]; // unorm8
+    u32 texture;
+};
+
+_Static_assert(sizeof(SpriteInstance) == 32, "SpriteInstance must be tightly packed");
+
+typedef struct SpriteBatch SpriteBatch;
+struct SpriteBatch {
+    SpriteBlend blend;
+    u32 first_instance;
+    u32 instance_count;
+};
+
+typedef struct SpritePushConstants SpritePushConstants;
+struct SpritePushConstants {
+    f32 scale[2]; // pixels to NDC: 2 / extent
+};
+
+struct SpriteRenderer {
+    // the quads of the frame being built, in submission order, and their sort keys
+    SpriteInstance* instances;
+    u32* keys;
+    u32* order; // the sorted indices
+    u32* scratch_keys;
+    u32* scratch_order;
+    u32 count;
+    u32 dropped; // over SPRITE_MAX_QUADS this frame
+
+    SpriteBatch batches[SPRITE_MAX_BATCHES];
+    u32 batch_count;
+
+    // the vertex stream: one region of SPRITE_MAX_QUADS instances per frame in flight, mapped for good. A region is
+    // written again only after the GPU is past the frame that read it
+    VkBuffer buffer;
+    VkDeviceMemory memory;
+    SpriteInstance* mapped;
+    bool device_local; // host visible VRAM (resizable BAR or unified memory), written straight over the bus
+
+    VkImage texture_image;
+    VkDeviceMemory texture_memory;
+    VkImageView texture_view;
+    VkSampler sampler;
+    VkDescriptorSetLayout descriptor_set_layout;
+    VkDescriptorPool descriptor_pool;
+    VkDescriptorSet descriptor_set;
+    VkPipelineLayout pipeline_layout;
+    VkPipeline pipelines[SPRITE_BLEND_COUNT];
+
+    // the last end_sprites: the sort, gather and batch, and the wait for the frame slot
+    f64 end_ms;
+    f64 wait_ms;
+};
+
+void create_sprite_renderer(App* pApp);
+void destroy_sprite_renderer(App* pApp);
+void create_sprite_pipelines(App* pApp);
+void begin_sprites(App* pApp);
+void draw_sprite(App* pApp, const Sprite* sprite);
+void end_sprites(App* pApp);
+void record_sprites(App* pApp, VkCommandBuffer command_buffer);
+bool has_sprites(App* pApp);
+u32 sprite_sort_key(const Sprite* sprite);
+void radix_sort_keys(u32* keys, u32* order, u32* scratch_keys, u32* scratch_order, u32 count);
+
+#endif // SPRITES_H
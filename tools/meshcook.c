@@ -0,0 +1,1072 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+
+#include "mesh_format.h"
+
+// Offline mesh cooking. Reads a Wavefront OBJ and writes the packed binary format from src/mesh_format.h, with the
+// triangles and vertices reordered for the GPU:
+//   1. vertex cache optimization (Tom Forsyth's linear-speed vertex cache optimisation)
+//   2. overdraw optimization: the cache optimized triangles are split in clusters, and the clusters are sorted so the
+//      ones facing outwards (more likely to occlude the rest) are drawn first
+//   3. vertex fetch reordering: the vertices are sorted by first use, so the fetches walk the buffer forward
+//   4. optionally, meshlets (at most MESHLET_MAX_VERTICES vertices and MESHLET_MAX_TRIANGLES triangles each)
+//   5. optionally, compact vertices (MeshVertexPacked): snorm16 or half positions, octahedral normals, rgba8 colors
+//
+//     build/meshcook input.obj output.mesh [--meshlets] [--no-optimize] [--format f32|snorm16|half]
+
+#define CACHE_SIZE 32          // the post-transform cache we optimize for (and simulate for the stats)
+#define OVERDRAW_CACHE_SIZE 16 // smaller, to find more cluster boundaries
+#define OVERDRAW_THRESHOLD 1.05 // how much worse the ACMR of a cluster may get to split it
+#define OVERDRAW_MIN_CLUSTER 64 // triangles
+
+typedef struct MeshData MeshData;
+struct MeshData {
+    MeshVertexF32* vertices;
+    u32 vertex_count;
+    u32* indices;
+    u32 index_count;
+
+    MeshMeshlet* meshlets;
+    u32 meshlet_count;
+    u32* meshlet_vertices;
+    u32 meshlet_vertex_count;
+    u8* meshlet_triangles;
+    u32 meshlet_triangle_count;
+};
+
+void* checked_malloc(size_t size)
+{
+    void* memory = malloc(size > 0 ? size : 1);
+    if (memory == NULL) {
+        printf("Out of memory!\n");
+        exit(1);
+    }
+    return memory;
+}
+
+void* checked_realloc(void* memory, size_t size)
+{
+    memory = realloc(memory, size > 0 ? size : 1);
+    if (memory == NULL) {
+        printf("Out of memory!\n");
+        exit(1);
+    }
+    return memory;
+}
+
+// OBJ LOADING
+
+// one corner of a face: which position and which normal (the same position with two normals is two vertices)
+typedef struct ObjCorner ObjCorner;
+struct ObjCorner {
+    u32 position;
+    u32 normal; // UINT32_MAX when the file has none
+};
+
+u32 resolve_obj_index(long index, u32 count)
+{
+    // OBJ indices start at 1, negative ones are relative to the end
+    long resolved = index > 0 ? index - 1 : (long)count + index;
+    if (resolved < 0 || resolved >= (long)count) {
+        printf("OBJ index %ld out of range (%u elements)\n", index, count);
+        exit(1);
+    }
+    return (u32)resolved;
+}
+
+u64 hash_u64(u64 x)
+{
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ull;
+    x ^= x >> 33;
+    return x;
+}
+
+MeshData load_obj(const char* filename)
+{
+    FILE* file = fopen(filename, "r");
+    if (file == NULL) {
+        printf("The file %s couldn't be opened!\n", filename);
+        exit(1);
+    }
+
+    u32 position_count = 0, position_capacity = 1024;
+    f32* positions = checked_malloc(position_capacity * 3 * sizeof(f32));
+    f32* colors = checked_malloc(position_capacity * 3 * sizeof(f32));
+    u32 normal_count = 0, normal_capacity = 1024;
+    f32* normals = checked_malloc(normal_capacity * 3 * sizeof(f32));
+    u32 corner_count = 0, corner_capacity = 4096;
+    ObjCorner* corners = checked_malloc(corner_capacity * sizeof(ObjCorner));
+
+    char line[1024];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        if (line[0] == 'v' && line[1] == ' ') {
+            if (position_count == position_capacity) {
+                position_capacity *= 2;
+                positions = checked_realloc(positions, position_capacity * 3 * sizeof(f32));
+                colors = checked_realloc(colors, position_capacity * 3 * sizeof(f32));
+            }
+            f32* p = &positions[position_count * 3];
+            f32* c = &colors[position_count * 3];
+            // "v x y z" or the common extension with colors "v x y z r g b"
+            i32 read = sscanf(line + 2, "%f %f %f %f %f %f", &p[0], &p[1], &p[2], &c[0], &c[1], &c[2]);
+            if (read < 3) {
+                printf("Bad vertex line: %s", line);
+                exit(1);
+            }
+            if (read < 6) {
+                c[0] = c[1] = c[2] = 0.8f;
+            }
+            position_count += 1;
+        } else if (line[0] == 'v' && line[1] == 'n') {
+            if (normal_count == normal_capacity) {
+                normal_capacity *= 2;
+                normals = checked_realloc(normals, normal_capacity * 3 * sizeof(f32));
+            }
+            f32* n = &normals[normal_count * 3];
+            if (sscanf(line + 3, "%f %f %f", &n[0], &n[1], &n[2]) != 3) {
+                printf("Bad normal line: %s", line);
+                exit(1);
+            }
+            normal_count += 1;
+        } else if (line[0] == 'f' && line[1] == ' ') {
+            // polygons are triangulated as a fan around the first corner
+            ObjCorner face[64];
+            u32 face_count = 0;
+            char* cursor = line + 2;
+            while (face_count < 64) {
+                char* end;
+                long position = strtol(cursor, &end, 10);
+                if (end == cursor) {
+                    break;
+                }
+                cursor = end;
+                long normal = 0;
+                if (*cursor == '/') {
+                    cursor += 1;
+                    strtol(cursor, &end, 10); // the texture coordinate, unused
+                    cursor = end;
+                    if (*cursor == '/') {
+                        cursor += 1;
+                        normal = strtol(cursor, &end, 10);
+                        cursor = end;
+                    }
+                }
+                face[face_count].position = resolve_obj_index(position, position_count);
+                face[face_count].normal = normal != 0 ? resolve_obj_index(normal, normal_count) : UINT32_MAX;
+                face_count += 1;
+                while (*cursor != '\0' && *cursor != ' ' && *cursor != '\t' && *cursor != '\n' && *cursor != '\r') {
+                    cursor += 1;
+                }
+            }
+
+            for (u32 i = 2; i < face_count; i += 1) {
+                if (corner_count + 3 > corner_capacity) {
+                    corner_capacity *= 2;
+                    corners = checked_realloc(corners, corner_capacity * sizeof(ObjCorner));
+                }
+                corners[corner_count++] = face[0];
+                corners[corner_count++] = face[i - 1];
+                corners[corner_count++] = face[i];
+            }
+        }
+    }
+    fclose(file);
+    printf("Read %s: %u positions, %u normals, %u triangles\n", filename, position_count, normal_count,
+           corner_count / 3);
+
+    // without normals in the file, smooth normals per position from the (area weighted) face normals
+    f32* smooth_normals = NULL;
+    if (normal_count == 0) {
+        smooth_normals = checked_malloc(position_count * 3 * sizeof(f32));
+        memset(smooth_normals, 0, position_count * 3 * sizeof(f32));
+        for (u32 i = 0; i < corner_count; i += 3) {
+            const f32* a = &positions[corners[i + 0].position * 3];
+            const f32* b = &positions[corners[i + 1].position * 3];
+            const f32* c = &positions[corners[i + 2].position * 3];
+            f32 e1[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+            f32 e2[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+            f32 n[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+            for (u32 k = 0; k < 3; k += 1) {
+                f32* sn = &smooth_normals[corners[i + k].position * 3];
+                sn[0] += n[0];
+                sn[1] += n[1];
+                sn[2] += n[2];
+            }
+        }
+    }
+
+    // unique (position, normal) pairs become the vertices. Open addressing, the table is at least twice the corners
+    u32 table_size = 1;
+    while (table_size < corner_count * 2) {
+        table_size *= 2;
+    }
+    u64* table_keys = checked_malloc(table_size * sizeof(u64));
+    u32* table_values = checked_malloc(table_size * sizeof(u32));
+    memset(table_keys, 0xff, table_size * sizeof(u64));
+
+    MeshData mesh = {0};
+    mesh.vertices = checked_malloc(corner_count * sizeof(MeshVertexF32));
+    mesh.indices = checked_malloc(corner_count * sizeof(u32));
+    mesh.index_count = corner_count;
+
+    for (u32 i = 0; i < corner_count; i += 1) {
+        u64 key = ((u64)corners[i].position << 32) | corners[i].normal;
+        u32 slot = (u32)hash_u64(key) & (table_size - 1);
+        while (table_keys[slot] != UINT64_MAX && table_keys[slot] != key) {
+            slot = (slot + 1) & (table_size - 1);
+        }
+        if (table_keys[slot] == UINT64_MAX) {
+            table_keys[slot] = key;
+            table_values[slot] = mesh.vertex_count;
+
+            MeshVertexF32* v = &mesh.vertices[mesh.vertex_count++];
+            memcpy(v->position, &positions[corners[i].position * 3], 3 * sizeof(f32));
+            memcpy(v->color, &colors[corners[i].position * 3], 3 * sizeof(f32));
+            const f32* n = smooth_normals != NULL ? &smooth_normals[corners[i].position * 3]
+                           : corners[i].normal != UINT32_MAX ? &normals[corners[i].normal * 3]
+                                                             : (const f32[3]){0.0f, 0.0f, 1.0f};
+            f32 length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            f32 inv_length = length > 0.0f ? 1.0f / length : 0.0f;
+            v->normal[0] = n[0] * inv_length;
+            v->normal[1] = n[1] * inv_length;
+            v->normal[2] = n[2] * inv_length;
+        }
+        mesh.indices[i] = table_values[slot];
+    }
+
+    free(table_keys);
+    free(table_values);
+    free(smooth_normals);
+    free(corners);
+    free(normals);
+    free(colors);
+    free(positions);
+    return mesh;
+}
+
+// STATS
+
+// average cache miss ratio (misses per triangle, 0.5 is the ideal for big regular meshes) and average transform to
+// vertex ratio (misses per vertex, 1.0 is ideal) for a FIFO cache of the given size
+void analyze_vertex_cache(const u32* indices, u32 index_count, u32 vertex_count, u32 cache_size, f64* acmr,
+                          f64* atvr)
+{
+    u32* timestamps = checked_malloc(vertex_count * sizeof(u32));
+    memset(timestamps, 0, vertex_count * sizeof(u32));
+    u32 time = cache_size + 1;
+    u32 misses = 0;
+
+    for (u32 i = 0; i < index_count; i += 1) {
+        u32 v = indices[i];
+        // in the cache if it was pushed in the last cache_size misses
+        if (time - timestamps[v] > cache_size) {
+            timestamps[v] = time;
+            time += 1;
+            misses += 1;
+        }
+    }
+    free(timestamps);
+
+    *acmr = index_count > 0 ? (f64)misses / (f64)(index_count / 3) : 0.0;
+    *atvr = vertex_count > 0 ? (f64)misses / (f64)vertex_count : 0.0;
+}
+
+// 1. VERTEX CACHE OPTIMIZATION
+
+#define FORSYTH_CACHE_DECAY_POWER 1.5f
+#define FORSYTH_LAST_TRIANGLE_SCORE 0.75f
+#define FORSYTH_VALENCE_BOOST_SCALE 2.0f
+#define FORSYTH_VALENCE_BOOST_POWER 0.5f
+
+f32 forsyth_vertex_score(i32 cache_position, u32 remaining_valence)
+{
+    if (remaining_valence == 0) {
+        return -1.0f; // no triangle needs it anymore
+    }
+
+    f32 score = 0.0f;
+    if (cache_position >= 0) {
+        if (cache_position < 3) {
+            // used by the last triangle. A fixed score so it does not win just because it is in there
+            score = FORSYTH_LAST_TRIANGLE_SCORE;
+        } else {
+            f32 scaler = 1.0f / (f32)(CACHE_SIZE - 3);
+            score = powf(1.0f - (f32)(cache_position - 3) * scaler, FORSYTH_CACHE_DECAY_POWER);
+        }
+    }
+    // boost the vertices with few triangles left, to finish them and not leave lone triangles behind
+    score += FORSYTH_VALENCE_BOOST_SCALE * powf((f32)remaining_valence, -FORSYTH_VALENCE_BOOST_POWER);
+    return score;
+}
+
+void optimize_vertex_cache(u32* indices, u32 index_count, u32 vertex_count)
+{
+    u32 triangle_count = index_count / 3;
+
+    // vertex -> triangles adjacency
+    u32* valence = checked_malloc(vertex_count * sizeof(u32));
+    u32* adjacency_offsets = checked_malloc((vertex_count + 1) * sizeof(u32));
+    u32* adjacency = checked_malloc(index_count * sizeof(u32));
+    memset(valence, 0, vertex_count * sizeof(u32));
+    for (u32 i = 0; i < index_count; i += 1) {
+        valence[indices[i]] += 1;
+    }
+    adjacency_offsets[0] = 0;
+    for (u32 v = 0; v < vertex_count; v += 1) {
+        adjacency_offsets[v + 1] = adjacency_offsets[v] + valence[v];
+    }
+    u32* fill = checked_malloc(vertex_count * sizeof(u32));
+    memcpy(fill, adjacency_offsets, vertex_count * sizeof(u32));
+    for (u32 t = 0; t < triangle_count; t += 1) {
+        for (u32 k = 0; k < 3; k += 1) {
+            u32 v = indices[t * 3 + k];
+            adjacency[fill[v]++] = t;
+        }
+    }
+    free(fill);
+
+    i32* cache_position = checked_malloc(vertex_count * sizeof(i32));
+    f32* vertex_score = checked_malloc(vertex_count * sizeof(f32));
+    for (u32 v = 0; v < vertex_count; v += 1) {
+        cache_position[v] = -1;
+        vertex_score[v] = forsyth_vertex_score(-1, valence[v]);
+    }
+
+    f32* triangle_score = checked_malloc(triangle_count * sizeof(f32));
+    bool* emitted = checked_malloc(triangle_count * sizeof(bool));
+    for (u32 t = 0; t < triangle_count; t += 1) {
+        emitted[t] = false;
+        triangle_score[t] = vertex_score[indices[t * 3]] + vertex_score[indices[t * 3 + 1]] +
+                            vertex_score[indices[t * 3 + 2]];
+    }
+
+    u32* output = checked_malloc(index_count * sizeof(u32));
+    u32 cache[CACHE_SIZE + 3];
+    u32 cache_count = 0;
+    u32 scan_cursor = 0; // for when the cache has no candidates left, triangles before it are all emitted
+
+    i64 best_triangle = -1;
+    for (u32 emitted_count = 0; emitted_count < triangle_count; emitted_count += 1) {
+        if (best_triangle < 0) {
+            // nothing left around the cache, start again from the first triangle not emitted yet. Searching the best
+            // of all the rest would make the whole thing quadratic
+            best_triangle = scan_cursor;
+        }
+        u32 triangle = (u32)best_triangle;
+        emitted[triangle] = true;
+        while (scan_cursor < triangle_count && emitted[scan_cursor]) {
+            scan_cursor += 1;
+        }
+
+        u32* tri = &indices[triangle * 3];
+        output[emitted_count * 3 + 0] = tri[0];
+        output[emitted_count * 3 + 1] = tri[1];
+        output[emitted_count * 3 + 2] = tri[2];
+
+        // the triangle is done, remove it from its vertices adjacency
+        for (u32 k = 0; k < 3; k += 1) {
+            u32 v = tri[k];
+            u32* list = &adjacency[adjacency_offsets[v]];
+            for (u32 j = 0; j < valence[v]; j += 1) {
+                if (list[j] == triangle) {
+                    list[j] = list[valence[v] - 1];
+                    break;
+                }
+            }
+            valence[v] -= 1;
+        }
+
+        // LRU: the triangle vertices go to the front, the rest shift back
+        u32 new_cache[CACHE_SIZE + 3];
+        u32 new_cache_count = 0;
+        for (u32 k = 0; k < 3; k += 1) {
+            new_cache[new_cache_count++] = tri[k];
+        }
+        for (u32 j = 0; j < cache_count; j += 1) {
+            u32 v = cache[j];
+            if (v != tri[0] && v != tri[1] && v != tri[2]) {
+                new_cache[new_cache_count++] = v;
+            }
+        }
+
+        // rescore the vertices that moved (the evicted ones fall out of the cache) and their triangles
+        best_triangle = -1;
+        f32 best_score = -1e30f;
+        for (u32 j = 0; j < new_cache_count; j += 1) {
+            u32 v = new_cache[j];
+            cache_position[v] = j < CACHE_SIZE ? (i32)j : -1;
+            vertex_score[v] = forsyth_vertex_score(cache_position[v], valence[v]);
+        }
+        for (u32 j = 0; j < new_cache_count; j += 1) {
+            u32 v = new_cache[j];
+            const u32* list = &adjacency[adjacency_offsets[v]];
+            for (u32 a = 0; a < valence[v]; a += 1) {
+                u32 t = list[a];
+                const u32* other = &indices[t * 3];
+                triangle_score[t] = vertex_score[other[0]] + vertex_score[other[1]] + vertex_score[other[2]];
+                if (triangle_score[t] > best_score) {
+                    best_score = triangle_score[t];
+                    best_triangle = t;
+                }
+            }
+        }
+
+        cache_count = new_cache_count < CACHE_SIZE ? new_cache_count : CACHE_SIZE;
+        memcpy(cache, new_cache, cache_count * sizeof(u32));
+    }
+
+    memcpy(indices, output, index_count * sizeof(u32));
+    free(output);
+    free(emitted);
+    free(triangle_score);
+    free(vertex_score);
+    free(cache_position);
+    free(adjacency);
+    free(adjacency_offsets);
+    free(valence);
+}
+
+// 2. OVERDRAW OPTIMIZATION
+
+typedef struct Cluster Cluster;
+struct Cluster {
+    u32 first_triangle;
+    u32 triangle_count;
+    f32 sort_key;
+};
+
+int compare_clusters(const void* a, const void* b)
+{
+    const Cluster* x = (const Cluster*)a;
+    const Cluster* y = (const Cluster*)b;
+    // descending key, stable on the original order so the result does not depend on qsort
+    if (x->sort_key != y->sort_key) {
+        return x->sort_key > y->sort_key ? -1 : 1;
+    }
+    return (x->first_triangle > y->first_triangle) - (x->first_triangle < y->first_triangle);
+}
+
+u32 count_cache_misses(const u32* triangle, u32* timestamps, u32* time)
+{
+    u32 misses = 0;
+    for (u32 k = 0; k < 3; k += 1) {
+        u32 v = triangle[k];
+        if (*time - timestamps[v] > OVERDRAW_CACHE_SIZE) {
+            timestamps[v] = *time;
+            *time += 1;
+            misses += 1;
+        }
+    }
+    return misses;
+}
+
+// After the cache optimization the triangles come in runs that restart where all three vertices miss the cache (hard
+// boundaries), free places to cut. The runs are cut again where the ACMR of the part so far is within
+// OVERDRAW_THRESHOLD of the whole run (soft boundaries), so moving whole clusters around costs little in cache hits.
+// The clusters facing away from the center of the mesh are its outside, and drawn first they occlude the rest.
+void optimize_overdraw(u32* indices, u32 index_count, const MeshVertexF32* vertices, u32 vertex_count)
+{
+    u32 triangle_count = index_count / 3;
+    if (triangle_count == 0) {
+        return;
+    }
+
+    // mesh centroid
+    f64 center[3] = {0.0, 0.0, 0.0};
+    for (u32 v = 0; v < vertex_count; v += 1) {
+        for (u32 k = 0; k < 3; k += 1) {
+            center[k] += vertices[v].position[k];
+        }
+    }
+    for (u32 k = 0; k < 3; k += 1) {
+        center[k] /= (f64)(vertex_count > 0 ? vertex_count : 1);
+    }
+
+    // a small FIFO cache. Bumping the time past the cache size flushes it
+    u32* timestamps = checked_malloc(vertex_count * sizeof(u32));
+    memset(timestamps, 0, vertex_count * sizeof(u32));
+    u32 time = OVERDRAW_CACHE_SIZE + 1;
+
+    // hard boundaries
+    u32* hard = checked_malloc((triangle_count + 1) * sizeof(u32));
+    u32 hard_count = 0;
+    for (u32 t = 0; t < triangle_count; t += 1) {
+        if (count_cache_misses(&indices[t * 3], timestamps, &time) == 3) {
+            hard[hard_count++] = t;
+        }
+    }
+    if (hard_count == 0 || hard[0] != 0) {
+        // the first triangle always misses, but be safe
+        memmove(&hard[1], &hard[0], hard_count * sizeof(u32));
+        hard[0] = 0;
+        hard_count += 1;
+    }
+    hard[hard_count] = triangle_count;
+
+    // soft boundaries inside every hard cluster
+    Cluster* clusters = checked_malloc(triangle_count * sizeof(Cluster));
+    u32 cluster_count = 0;
+    for (u32 h = 0; h < hard_count; h += 1) {
+        u32 start = hard[h];
+        u32 end = hard[h + 1];
+
+        time += OVERDRAW_CACHE_SIZE + 1;
+        u32 run_misses = 0;
+        for (u32 t = start; t < end; t += 1) {
+            run_misses += count_cache_misses(&indices[t * 3], timestamps, &time);
+        }
+        f64 target_acmr = (f64)run_misses / (f64)(end - start) * OVERDRAW_THRESHOLD;
+
+        time += OVERDRAW_CACHE_SIZE + 1;
+        u32 cluster_start = start;
+        u32 cluster_misses = 0;
+        for (u32 t = start; t < end; t += 1) {
+            cluster_misses += count_cache_misses(&indices[t * 3], timestamps, &time);
+            u32 cluster_triangles = t - cluster_start + 1;
+            bool last = t + 1 == end;
+            if (last || (cluster_triangles >= OVERDRAW_MIN_CLUSTER &&
+                         (f64)cluster_misses <= target_acmr * (f64)cluster_triangles)) {
+                clusters[cluster_count].first_triangle = cluster_start;
+                clusters[cluster_count].triangle_count = cluster_triangles;
+                cluster_count += 1;
+                cluster_start = t + 1;
+                cluster_misses = 0;
+                time += OVERDRAW_CACHE_SIZE + 1;
+            }
+        }
+    }
+    free(hard);
+    free(timestamps);
+
+    // sort key: how much the cluster faces away from the center
+    for (u32 c = 0; c < cluster_count; c += 1) {
+        f64 centroid[3] = {0.0, 0.0, 0.0};
+        f64 normal[3] = {0.0, 0.0, 0.0};
+        f64 area_sum = 0.0;
+        for (u32 t = clusters[c].first_triangle; t < clusters[c].first_triangle + clusters[c].triangle_count; t += 1) {
+            const f32* a = vertices[indices[t * 3 + 0]].position;
+            const f32* b = vertices[indices[t * 3 + 1]].position;
+            const f32* p = vertices[indices[t * 3 + 2]].position;
+            f64 e1[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+            f64 e2[3] = {p[0] - a[0], p[1] - a[1], p[2] - a[2]};
+            f64 n[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+            f64 area = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            for (u32 k = 0; k < 3; k += 1) {
+                centroid[k] += (a[k] + b[k] + p[k]) / 3.0 * area;
+                normal[k] += n[k];
+            }
+            area_sum += area;
+        }
+        f64 normal_length = sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        f64 key = 0.0;
+        if (area_sum > 0.0 && normal_length > 0.0) {
+            for (u32 k = 0; k < 3; k += 1) {
+                key += (centroid[k] / area_sum - center[k]) * normal[k] / normal_length;
+            }
+        }
+        clusters[c].sort_key = (f32)key;
+    }
+
+    qsort(clusters, cluster_count, sizeof(Cluster), compare_clusters);
+
+    u32* output = checked_malloc(index_count * sizeof(u32));
+    u32 written = 0;
+    for (u32 c = 0; c < cluster_count; c += 1) {
+        u32 count = clusters[c].triangle_count * 3;
+        memcpy(&output[written], &indices[clusters[c].first_triangle * 3], count * sizeof(u32));
+        written += count;
+    }
+    memcpy(indices, output, index_count * sizeof(u32));
+    printf("Overdraw: sorted %u clusters\n", cluster_count);
+
+    free(output);
+    free(clusters);
+}
+
+// 3. VERTEX FETCH REORDERING
+
+// renumbers the vertices in the order the indices first use them. Unused vertices are dropped
+void optimize_vertex_fetch(MeshData* mesh)
+{
+    u32* remap = checked_malloc(mesh->vertex_count * sizeof(u32));
+    memset(remap, 0xff, mesh->vertex_count * sizeof(u32));
+    MeshVertexF32* vertices = checked_malloc(mesh->vertex_count * sizeof(MeshVertexF32));
+
+    u32 next = 0;
+    for (u32 i = 0; i < mesh->index_count; i += 1) {
+        u32 v = mesh->indices[i];
+        if (remap[v] == UINT32_MAX) {
+            remap[v] = next;
+            vertices[next] = mesh->vertices[v];
+            next += 1;
+        }
+        mesh->indices[i] = remap[v];
+    }
+
+    free(mesh->vertices);
+    mesh->vertices = vertices;
+    mesh->vertex_count = next;
+    free(remap);
+}
+
+// 4. MESHLETS
+
+void finish_meshlet(MeshData* mesh, MeshMeshlet* meshlet)
+{
+    // bounding sphere around the box center, good enough for culling
+    f32 box_min[3] = {INFINITY, INFINITY, INFINITY};
+    f32 box_max[3] = {-INFINITY, -INFINITY, -INFINITY};
+    for (u32 i = 0; i < meshlet->vertex_count; i += 1) {
+        const f32* p = mesh->vertices[mesh->meshlet_vertices[meshlet->vertex_offset + i]].position;
+        for (u32 k = 0; k < 3; k += 1) {
+            box_min[k] = p[k] < box_min[k] ? p[k] : box_min[k];
+            box_max[k] = p[k] > box_max[k] ? p[k] : box_max[k];
+        }
+    }
+    f32 radius = 0.0f;
+    for (u32 k = 0; k < 3; k += 1) {
+        meshlet->center[k] = (box_min[k] + box_max[k]) * 0.5f;
+    }
+    for (u32 i = 0; i < meshlet->vertex_count; i += 1) {
+        const f32* p = mesh->vertices[mesh->meshlet_vertices[meshlet->vertex_offset + i]].position;
+        f32 d[3] = {p[0] - meshlet->center[0], p[1] - meshlet->center[1], p[2] - meshlet->center[2]};
+        f32 distance = sqrtf(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+        radius = distance > radius ? distance : radius;
+    }
+    meshlet->radius = radius;
+}
+
+// Greedy, in index order: since the triangles are already cache optimized, neighbours land in the same meshlet
+void build_meshlets(MeshData* mesh)
+{
+    u32 triangle_count = mesh->index_count / 3;
+    mesh->meshlets = checked_malloc((triangle_count + 1) * sizeof(MeshMeshlet));
+    mesh->meshlet_vertices = checked_malloc(mesh->index_count * sizeof(u32));
+    mesh->meshlet_triangles = checked_malloc(mesh->index_count * sizeof(u8));
+    mesh->meshlet_count = 0;
+    mesh->meshlet_vertex_count = 0;
+    mesh->meshlet_triangle_count = 0;
+
+    // local index of each vertex in the current meshlet, 0xff when it is not in it
+    u8* local = checked_malloc(mesh->vertex_count * sizeof(u8));
+    memset(local, 0xff, mesh->vertex_count * sizeof(u8));
+
+    MeshMeshlet meshlet = {0};
+    for (u32 t = 0; t < triangle_count; t += 1) {
+        const u32* tri = &mesh->indices[t * 3];
+        u32 new_vertices = (local[tri[0]] == 0xff) + (local[tri[1]] == 0xff) + (local[tri[2]] == 0xff);
+        // tri[1] == tri[0] etc. are degenerate, the count above might be one too many, which is fine
+
+        if (meshlet.vertex_count + new_vertices > MESHLET_MAX_VERTICES ||
+            meshlet.triangle_count + 1 > MESHLET_MAX_TRIANGLES) {
+            for (u32 i = 0; i < meshlet.vertex_count; i += 1) {
+                local[mesh->meshlet_vertices[meshlet.vertex_offset + i]] = 0xff;
+            }
+            finish_meshlet(mesh, &meshlet);
+            mesh->meshlets[mesh->meshlet_count++] = meshlet;
+            meshlet = (MeshMeshlet){
+                .vertex_offset = mesh->meshlet_vertex_count,
+                .triangle_offset = mesh->meshlet_triangle_count,
+            };
+        }
+
+        for (u32 k = 0; k < 3; k += 1) {
+            u32 v = tri[k];
+            if (local[v] == 0xff) {
+                local[v] = (u8)meshlet.vertex_count;
+                mesh->meshlet_vertices[mesh->meshlet_vertex_count++] = v;
+                meshlet.vertex_count += 1;
+            }
+            mesh->meshlet_triangles[mesh->meshlet_triangle_count * 3 + k] = local[v];
+        }
+        mesh->meshlet_triangle_count += 1;
+        meshlet.triangle_count += 1;
+    }
+    if (meshlet.triangle_count > 0) {
+        finish_meshlet(mesh, &meshlet);
+        mesh->meshlets[mesh->meshlet_count++] = meshlet;
+    }
+    free(local);
+
+    printf("Meshlets: %u (%.1f triangles, %.1f vertices each on average)\n", mesh->meshlet_count,
+           mesh->meshlet_count > 0 ? (f64)mesh->meshlet_triangle_count / mesh->meshlet_count : 0.0,
+           mesh->meshlet_count > 0 ? (f64)mesh->meshlet_vertex_count / mesh->meshlet_count : 0.0);
+}
+
+// 5. VERTEX QUANTIZATION
+
+// f32 to IEEE half, rounding to nearest even. Out of range goes to infinity, tiny values to half denormals
+u16 f32_to_half(f32 value)
+{
+    u32 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    u32 sign = (bits >> 16) & 0x8000u;
+    u32 exponent = (bits >> 23) & 0xffu;
+    u32 mantissa = bits & 0x7fffffu;
+
+    if (exponent == 0xff) {
+        return (u16)(sign | 0x7c00u | (mantissa != 0 ? 0x200u : 0u));
+    }
+    i32 half_exponent = (i32)exponent - 127 + 15;
+    if (half_exponent >= 31) {
+        return (u16)(sign | 0x7c00u);
+    }
+    if (half_exponent <= 0) {
+        if (half_exponent < -10) {
+            return (u16)sign;
+        }
+        // denormal: shift the mantissa, with its implicit 1, into place
+        mantissa |= 0x800000u;
+        u32 shift = (u32)(14 - half_exponent);
+        u32 half_mantissa = mantissa >> shift;
+        u32 remainder = mantissa & ((1u << shift) - 1u);
+        u32 halfway = 1u << (shift - 1u);
+        if (remainder > halfway || (remainder == halfway && (half_mantissa & 1u))) {
+            half_mantissa += 1;
+        }
+        return (u16)(sign | half_mantissa);
+    }
+    u32 half = sign | ((u32)half_exponent << 10) | (mantissa >> 13);
+    u32 remainder = mantissa & 0x1fffu;
+    if (remainder > 0x1000u || (remainder == 0x1000u && (half & 1u))) {
+        half += 1; // may carry into the exponent, which is still the right rounding
+    }
+    return (u16)half;
+}
+
+f32 half_to_f32(u16 half)
+{
+    u32 sign = (u32)(half & 0x8000u) << 16;
+    u32 exponent = (half >> 10) & 0x1fu;
+    u32 mantissa = half & 0x3ffu;
+    if (exponent == 0) {
+        f32 value = (f32)mantissa * (1.0f / 16777216.0f); // 2^-24
+        return sign ? -value : value;
+    }
+    u32 bits = sign | (exponent == 31 ? 0x7f800000u : (exponent - 15 + 127) << 23) | (mantissa << 13);
+    f32 value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+i16 f32_to_snorm16(f32 value)
+{
+    value = value < -1.0f ? -1.0f : (value > 1.0f ? 1.0f : value);
+    return (i16)lrintf(value * 32767.0f);
+}
+
+// as the GPU reads it: -32768 and -32767 are both -1
+f32 snorm16_to_f32(i16 value)
+{
+    f32 f = (f32)value / 32767.0f;
+    return f < -1.0f ? -1.0f : f;
+}
+
+void oct_decode(const i16 encoded[2], f32 normal[3])
+{
+    f32 x = snorm16_to_f32(encoded[0]);
+    f32 y = snorm16_to_f32(encoded[1]);
+    f32 z = 1.0f - fabsf(x) - fabsf(y);
+    f32 t = z < 0.0f ? -z : 0.0f;
+    x += x >= 0.0f ? -t : t;
+    y += y >= 0.0f ? -t : t;
+    f32 length = sqrtf(x * x + y * y + z * z);
+    normal[0] = x / length;
+    normal[1] = y / length;
+    normal[2] = z / length;
+}
+
+// Octahedral encoding: project on the octahedron, fold the lower half over the upper one. Of the four snorm16
+// roundings around the exact point, keep the one that decodes closest to the normal
+void oct_encode(const f32 normal[3], i16 encoded[2])
+{
+    f32 l1 = fabsf(normal[0]) + fabsf(normal[1]) + fabsf(normal[2]);
+    f32 x = l1 > 0.0f ? normal[0] / l1 : 0.0f;
+    f32 y = l1 > 0.0f ? normal[1] / l1 : 0.0f;
+    if (normal[2] < 0.0f) {
+        f32 folded_x = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        f32 folded_y = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = folded_x;
+        y = folded_y;
+    }
+
+    f32 best_dot = -2.0f;
+    for (u32 i = 0; i < 4; i += 1) {
+        f32 qx = (i & 1u) ? ceilf(x * 32767.0f) : floorf(x * 32767.0f);
+        f32 qy = (i & 2u) ? ceilf(y * 32767.0f) : floorf(y * 32767.0f);
+        i16 candidate[2] = {f32_to_snorm16(qx / 32767.0f), f32_to_snorm16(qy / 32767.0f)};
+        f32 decoded[3];
+        oct_decode(candidate, decoded);
+        f32 dot = decoded[0] * normal[0] + decoded[1] * normal[1] + decoded[2] * normal[2];
+        if (dot > best_dot) {
+            best_dot = dot;
+            encoded[0] = candidate[0];
+            encoded[1] = candidate[1];
+        }
+    }
+}
+
+u8 f32_to_unorm8(f32 value)
+{
+    value = value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+    return (u8)lrintf(value * 255.0f);
+}
+
+const char* vertex_format_name(MeshVertexFormat format)
+{
+    switch (format) {
+    case MESH_VERTEX_FORMAT_F32:
+        return "f32";
+    case MESH_VERTEX_FORMAT_SNORM16:
+        return "snorm16";
+    case MESH_VERTEX_FORMAT_HALF:
+        return "half";
+    }
+    return "unknown";
+}
+
+// Packs the vertices and prints how far they land from the fp32 ones, decoded the way the vertex fetch does it
+MeshVertexPacked* quantize_vertices(const MeshData* mesh, MeshVertexFormat format, const f32 offset[3],
+                                    const f32 scale[3])
+{
+    MeshVertexPacked* packed = checked_malloc(mesh->vertex_count * sizeof(MeshVertexPacked));
+
+    f64 position_max_error = 0.0;
+    f64 position_sum_squared = 0.0;
+    f64 normal_max_degrees = 0.0;
+    f64 normal_sum_degrees = 0.0;
+    f64 color_max_error = 0.0;
+    for (u32 v = 0; v < mesh->vertex_count; v += 1) {
+        const MeshVertexF32* vertex = &mesh->vertices[v];
+        MeshVertexPacked* out = &packed[v];
+
+        f64 squared_error = 0.0;
+        for (u32 k = 0; k < 3; k += 1) {
+            f32 normalized = (vertex->position[k] - offset[k]) / scale[k];
+            f32 decoded;
+            if (format == MESH_VERTEX_FORMAT_SNORM16) {
+                i16 q = f32_to_snorm16(normalized);
+                memcpy(&out->position[k], &q, sizeof(q));
+                decoded = snorm16_to_f32(q);
+            } else {
+                out->position[k] = f32_to_half(normalized);
+                decoded = half_to_f32(out->position[k]);
+            }
+            f64 error = (f64)(offset[k] + decoded * scale[k]) - (f64)vertex->position[k];
+            squared_error += error * error;
+        }
+        out->position[3] = 0;
+        f64 position_error = sqrt(squared_error);
+        position_max_error = position_error > position_max_error ? position_error : position_max_error;
+        position_sum_squared += squared_error;
+
+        oct_encode(vertex->normal, out->normal);
+        f32 normal[3];
+        oct_decode(out->normal, normal);
+        // atan2 of the cross and dot products: acos of a dot product near 1 is all rounding noise
+        const f32* n = vertex->normal;
+        f64 cross[3] = {
+            (f64)normal[1] * n[2] - (f64)normal[2] * n[1],
+            (f64)normal[2] * n[0] - (f64)normal[0] * n[2],
+            (f64)normal[0] * n[1] - (f64)normal[1] * n[0],
+        };
+        f64 dot = (f64)normal[0] * n[0] + (f64)normal[1] * n[1] + (f64)normal[2] * n[2];
+        f64 sine = sqrt(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]);
+        f64 degrees = atan2(sine, dot) * 180.0 / 3.14159265358979323846;
+        normal_max_degrees = degrees > normal_max_degrees ? degrees : normal_max_degrees;
+        normal_sum_degrees += degrees;
+
+        for (u32 k = 0; k < 3; k += 1) {
+            out->color[k] = f32_to_unorm8(vertex->color[k]);
+            f64 error = fabs((f64)out->color[k] / 255.0 - (f64)vertex->color[k]);
+            color_max_error = error > color_max_error ? error : color_max_error;
+        }
+        out->color[3] = 255;
+    }
+
+    f64 diagonal = sqrt((f64)(scale[0] * scale[0] + scale[1] * scale[1] + scale[2] * scale[2])) * 2.0;
+    f64 count = mesh->vertex_count > 0 ? (f64)mesh->vertex_count : 1.0;
+    printf("Quantized to %s: %u -> %u bytes per vertex (%.1f%%)\n", vertex_format_name(format),
+           (u32)sizeof(MeshVertexF32), (u32)sizeof(MeshVertexPacked),
+           100.0 * (f64)sizeof(MeshVertexPacked) / (f64)sizeof(MeshVertexF32));
+    printf("  position error: max %.3g, rms %.3g (%.3g%% of the bounds diagonal)\n", position_max_error,
+           sqrt(position_sum_squared / count), diagonal > 0.0 ? 100.0 * position_max_error / diagonal : 0.0);
+    printf("  normal error: max %.4f deg, mean %.4f deg\n", normal_max_degrees, normal_sum_degrees / count);
+    printf("  color error: max %.4f\n", color_max_error);
+    return packed;
+}
+
+// WRITING
+
+u64 align_offset(u64 offset) { return (offset + MESH_SECTION_ALIGNMENT - 1) & ~(u64)(MESH_SECTION_ALIGNMENT - 1); }
+
+void write_section(FILE* file, u64* offset, u64 section_offset, const void* data, u64 size)
+{
+    static const u8 zeros[MESH_SECTION_ALIGNMENT] = {0};
+    fwrite(zeros, 1, section_offset - *offset, file);
+    fwrite(data, 1, size, file);
+    *offset = section_offset + size;
+}
+
+void write_mesh(const char* filename, const MeshData* mesh, MeshVertexFormat vertex_format)
+{
+    MeshFileHeader header = {
+        .magic = MESH_MAGIC,
+        .version = MESH_VERSION,
+        .vertex_format = vertex_format,
+        .vertex_stride = vertex_format == MESH_VERTEX_FORMAT_F32 ? sizeof(MeshVertexF32) : sizeof(MeshVertexPacked),
+        .vertex_count = mesh->vertex_count,
+        .index_count = mesh->index_count,
+        .index_size = mesh->vertex_count <= 65536 ? 2 : 4, // halve the index bandwidth when we can
+        .meshlet_count = mesh->meshlet_count,
+        .meshlet_vertex_count = mesh->meshlet_vertex_count,
+        .meshlet_triangle_count = mesh->meshlet_triangle_count,
+        .bounds_min = {INFINITY, INFINITY, INFINITY},
+        .bounds_max = {-INFINITY, -INFINITY, -INFINITY},
+        .position_offset = {0.0f, 0.0f, 0.0f},
+        .position_scale = {1.0f, 1.0f, 1.0f},
+    };
+    for (u32 v = 0; v < mesh->vertex_count; v += 1) {
+        for (u32 k = 0; k < 3; k += 1) {
+            f32 p = mesh->vertices[v].position[k];
+            header.bounds_min[k] = p < header.bounds_min[k] ? p : header.bounds_min[k];
+            header.bounds_max[k] = p > header.bounds_max[k] ? p : header.bounds_max[k];
+        }
+    }
+
+    const void* vertices = mesh->vertices;
+    MeshVertexPacked* packed = NULL;
+    if (vertex_format != MESH_VERTEX_FORMAT_F32 && mesh->vertex_count > 0) {
+        // each axis gets the whole [-1, 1] range
+        for (u32 k = 0; k < 3; k += 1) {
+            f32 half_extent = (header.bounds_max[k] - header.bounds_min[k]) * 0.5f;
+            header.position_offset[k] = (header.bounds_max[k] + header.bounds_min[k]) * 0.5f;
+            header.position_scale[k] = half_extent > 0.0f ? half_extent : 1.0f;
+        }
+        packed = quantize_vertices(mesh, vertex_format, header.position_offset, header.position_scale);
+        vertices = packed;
+    }
+
+    u64 vertices_size = (u64)mesh->vertex_count * header.vertex_stride;
+    u64 indices_size = (u64)mesh->index_count * header.index_size;
+    u64 meshlets_size = (u64)mesh->meshlet_count * sizeof(MeshMeshlet);
+    u64 meshlet_vertices_size = (u64)mesh->meshlet_vertex_count * sizeof(u32);
+    u64 meshlet_triangles_size = (u64)mesh->meshlet_triangle_count * 3;
+
+    header.vertices_offset = align_offset(sizeof(MeshFileHeader));
+    header.indices_offset = align_offset(header.vertices_offset + vertices_size);
+    header.meshlets_offset = align_offset(header.indices_offset + indices_size);
+    header.meshlet_vertices_offset = align_offset(header.meshlets_offset + meshlets_size);
+    header.meshlet_triangles_offset = align_offset(header.meshlet_vertices_offset + meshlet_vertices_size);
+    header.file_size = header.meshlet_triangles_offset + meshlet_triangles_size;
+
+    void* indices = mesh->indices;
+    u16* indices16 = NULL;
+    if (header.index_size == 2) {
+        indices16 = checked_malloc(mesh->index_count * sizeof(u16));
+        for (u32 i = 0; i < mesh->index_count; i += 1) {
+            indices16[i] = (u16)mesh->indices[i];
+        }
+        indices = indices16;
+    }
+
+    FILE* file = fopen(filename, "wb");
+    if (file == NULL) {
+        printf("The file %s couldn't be opened for writing!\n", filename);
+        exit(1);
+    }
+    u64 offset = 0;
+    write_section(file, &offset, 0, &header, sizeof(header));
+    write_section(file, &offset, header.vertices_offset, vertices, vertices_size);
+    write_section(file, &offset, header.indices_offset, indices, indices_size);
+    write_section(file, &offset, header.meshlets_offset, mesh->meshlets, meshlets_size);
+    write_section(file, &offset, header.meshlet_vertices_offset, mesh->meshlet_vertices, meshlet_vertices_size);
+    write_section(file, &offset, header.meshlet_triangles_offset, mesh->meshlet_triangles, meshlet_triangles_size);
+    if (ferror(file)) {
+        printf("Failed writing %s!\n", filename);
+        exit(1);
+    }
+    fclose(file);
+    free(indices16);
+    free(packed);
+
+    printf("Wrote %s: %u vertices (%u bytes each), %u indices (%u bytes each), %llu bytes\n", filename,
+           header.vertex_count, header.vertex_stride, header.index_count, header.index_size,
+           (unsigned long long)header.file_size);
+}
+
+int main(int argc, char** argv)
+{
+    const char* input = NULL;
+    const char* output = NULL;
+    bool meshlets = false;
+    bool optimize = true;
+    MeshVertexFormat vertex_format = MESH_VERTEX_FORMAT_F32;
+
+    for (i32 i = 1; i < argc; i += 1) {
+        if (strcmp(argv[i], "--meshlets") == 0) {
+            meshlets = true;
+        } else if (strcmp(argv[i], "--no-optimize") == 0) {
+            optimize = false;
+        } else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            i += 1;
+            if (strcmp(argv[i], "f32") == 0) {
+                vertex_format = MESH_VERTEX_FORMAT_F32;
+            } else if (strcmp(argv[i], "snorm16") == 0) {
+                vertex_format = MESH_VERTEX_FORMAT_SNORM16;
+            } else if (strcmp(argv[i], "half") == 0) {
+                vertex_format = MESH_VERTEX_FORMAT_HALF;
+            } else {
+                input = NULL;
+                break;
+            }
+        } else if (input == NULL) {
+            input = argv[i];
+        } else if (output == NULL) {
+            output = argv[i];
+        } else {
+            input = NULL;
+            break;
+        }
+    }
+    if (input == NULL || output == NULL) {
+        printf("usage: %s input.obj output.mesh [--meshlets] [--no-optimize] [--format f32|snorm16|half]\n", argv[0]);
+        return 1;
+    }
+
+    MeshData mesh = load_obj(input);
+
+    f64 acmr, atvr;
+    analyze_vertex_cache(mesh.indices, mesh.index_count, mesh.vertex_count, CACHE_SIZE, &acmr, &atvr);
+    printf("Before: ACMR %.3f, ATVR %.3f (cache of %u)\n", acmr, atvr, CACHE_SIZE);
+
+    if (optimize) {
+        optimize_vertex_cache(mesh.indices, mesh.index_count, mesh.vertex_count);
+        analyze_vertex_cache(mesh.indices, mesh.index_count, mesh.vertex_count, CACHE_SIZE, &acmr, &atvr);
+        printf("Vertex cache: ACMR %.3f, ATVR %.3f\n", acmr, atvr);
+
+        optimize_overdraw(mesh.indices, mesh.index_count, mesh.vertices, mesh.vertex_count);
+        analyze_vertex_cache(mesh.indices, mesh.index_count, mesh.vertex_count, CACHE_SIZE, &acmr, &atvr);
+        printf("After overdraw: ACMR %.3f, ATVR %.3f\n", acmr, atvr);
+    }
+    optimize_vertex_fetch(&mesh);
+
+    if (meshlets) {
+        build_meshlets(&mesh);
+    }
+
+    write_mesh(output, &mesh, vertex_format);
+
+    free(mesh.vertices);
+    free(mesh.indices);
+    free(mesh.meshlets);
+    free(mesh.meshlet_vertices);
+    free(mesh.meshlet_triangles);
+    return 0;
+}
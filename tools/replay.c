@@ -0,0 +1,207 @@
+#include "engine.h"
+#include "capture.h"
+
+// Plays a command stream captured by the engine back, headless and as fast as the GPU takes it: no window, no
+// present, no scene of its own. Every frame is timed on the CPU (recording and submission) and on the GPU
+// (timestamps), and the results are written as JSON that build/bench --compare reads:
+//
+//     build/engine file.mesh --capture scene.vcap [--capture-frames 300]
+//     build/replay scene.vcap --out base.json [--loops 10]
+//     build/replay scene.vcap --out new.json [--loops 10]
+//     build/bench --compare base.json new.json --threshold 5
+
+#define REPLAY_WARMUP_FRAMES 16
+
+// what the replay measured, per frame of the capture (averaged over the loops) and over all of them
+typedef struct ReplayTimes ReplayTimes;
+struct ReplayTimes {
+    f64* cpu_ms; // every replayed frame
+    u32 cpu_count;
+    f64* gpu_ms;
+    u32 gpu_count;
+    f64* frame_cpu_ms; // per frame of the capture, summed over the loops
+    f64* frame_gpu_ms;
+    u32* frame_gpu_samples;
+};
+
+// The GPU time of a frame is read when its frame slot comes around again, so it belongs to the frame submitted
+// MAX_FRAMES_IN_FLIGHT draws ago
+void add_gpu_time(App* pApp, ReplayTimes* times, i64 submitted_frame)
+{
+    if (submitted_frame < 0 || pApp->frame_gpu_ms < 0.0) {
+        return;
+    }
+    u32 frame = (u32)(submitted_frame % pApp->replay->frame_count);
+    times->gpu_ms[times->gpu_count++] = pApp->frame_gpu_ms;
+    times->frame_gpu_ms[frame] += pApp->frame_gpu_ms;
+    times->frame_gpu_samples[frame] += 1;
+}
+
+void write_replay_results(const char* filename, App* pApp, const char* capture_filename, u32 loops, f64 setup_ms,
+                          f64 total_ms, ReplayTimes* times)
+{
+    FILE* file = fopen(filename, "w");
+    if (file == NULL) {
+        printf("Could not open %s to write the results!\n", filename);
+        exit(1);
+    }
+    Replay* replay = pApp->replay;
+    VkPhysicalDeviceProperties device_properties;
+    vkGetPhysicalDeviceProperties(pApp->vk_physical_device, &device_properties);
+
+    f64 cpu_total_ms = 0.0;
+    for (u32 i = 0; i < times->cpu_count; i += 1) {
+        cpu_total_ms += times->cpu_ms[i];
+    }
+    f64 gpu_total_ms = 0.0;
+    for (u32 i = 0; i < times->gpu_count; i += 1) {
+        gpu_total_ms += times->gpu_ms[i];
+    }
+    qsort(times->cpu_ms, times->cpu_count, sizeof(f64), compare_f64);
+    qsort(times->gpu_ms, times->gpu_count, sizeof(f64), compare_f64);
+
+    // the summary first: compare reads a limited number of values, the per frame ones can be cut
+    fprintf(file, "{\n");
+    fprintf(file, "  \"device\": \"%s\",\n", device_properties.deviceName);
+    fprintf(file, "  \"capture\": \"%s\",\n", capture_filename);
+    fprintf(file, "  \"frames\": %u,\n", replay->frame_count);
+    fprintf(file, "  \"loops\": %u,\n", loops);
+    fprintf(file, "  \"msaa_samples\": %u,\n", pApp->vk_msaa_samples);
+    fprintf(file, "  \"post\": %s,\n", pApp->post != NULL ? "true" : "false");
+    fprintf(file, "  \"replay\": {\n");
+    fprintf(file, "    \"setup_ms\": %.4f,\n", setup_ms);
+    fprintf(file, "    \"fps\": %.4f,\n", (f64)times->cpu_count / (total_ms / 1000.0));
+    fprintf(file, "    \"cpu_ms\": %.4f,\n", cpu_total_ms / (f64)times->cpu_count);
+    fprintf(file, "    \"cpu_p50_ms\": %.4f,\n", percentile(times->cpu_ms, times->cpu_count, 50.0));
+    fprintf(file, "    \"cpu_p99_ms\": %.4f", percentile(times->cpu_ms, times->cpu_count, 99.0));
+    if (times->gpu_count > 0) {
+        fprintf(file, ",\n");
+        fprintf(file, "    \"gpu_ms\": %.4f,\n", gpu_total_ms / (f64)times->gpu_count);
+        fprintf(file, "    \"gpu_p50_ms\": %.4f,\n", percentile(times->gpu_ms, times->gpu_count, 50.0));
+        fprintf(file, "    \"gpu_p99_ms\": %.4f", percentile(times->gpu_ms, times->gpu_count, 99.0));
+    }
+    fprintf(file, "\n  },\n");
+    fprintf(file, "  \"per_frame\": {\n");
+    fprintf(file, "    \"cpu\": [");
+    for (u32 i = 0; i < replay->frame_count; i += 1) {
+        fprintf(file, "%s%.4f", i > 0 ? ", " : "", times->frame_cpu_ms[i] / (f64)loops);
+    }
+    fprintf(file, "],\n");
+    fprintf(file, "    \"gpu\": [");
+    for (u32 i = 0; i < replay->frame_count; i += 1) {
+        u32 samples = times->frame_gpu_samples[i];
+        fprintf(file, "%s%.4f", i > 0 ? ", " : "", samples > 0 ? times->frame_gpu_ms[i] / (f64)samples : 0.0);
+    }
+    fprintf(file, "]\n");
+    fprintf(file, "  }\n");
+    fprintf(file, "}\n");
+    fclose(file);
+}
+
+int main(int argc, char** argv)
+{
+    const char* capture_filename = NULL;
+    const char* out_filename = "replay_results.json";
+    u32 loops = 1;
+
+    for (i32 i = 1; i < argc; i += 1) {
+        if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            out_filename = argv[++i];
+        } else if (strcmp(argv[i], "--loops") == 0 && i + 1 < argc) {
+            loops = (u32)atoi(argv[++i]);
+        } else if (argv[i][0] != '-' && capture_filename == NULL) {
+            capture_filename = argv[i];
+        } else {
+            capture_filename = NULL;
+            break;
+        }
+    }
+    if (capture_filename == NULL) {
+        printf("usage: %s capture.vcap [--out file.json] [--loops N]\n", argv[0]);
+        return 1;
+    }
+    if (loops == 0) {
+        loops = 1;
+    }
+
+    // the MSAA samples are part of the pipelines, the replay needs the ones of the capture. So is the HDR target of
+    // the post chain, and the chain is a good part of the frame
+    Replay* replay = read_replay(capture_filename);
+    bool post = (replay->header.flags & CAPTURE_FLAG_POST) != 0;
+    App app = {0};
+    app.headless = true;
+    app.requested_msaa_samples = replay->header.msaa_samples;
+    app.post_processing = post;
+    init_vulkan(&app);
+    if (post && app.post == NULL) {
+        printf("The capture ran the post processing chain, this device can not: the frames would not be the same\n");
+        return 1;
+    }
+    if (app.vk_extent.width != replay->header.width || app.vk_extent.height != replay->header.height) {
+        printf("The capture was %ux%u, it is replayed at %ux%u: the fragment work differs\n", replay->header.width,
+               replay->header.height, app.vk_extent.width, app.vk_extent.height);
+    }
+
+    f64 setup_start = now_ms();
+    create_replay_objects(&app, replay);
+    f64 setup_ms = now_ms() - setup_start;
+    app.replay = replay;
+
+    // a few frames to warm the caches and the clocks, not measured
+    u32 warmup_frames = replay->frame_count < REPLAY_WARMUP_FRAMES ? replay->frame_count : REPLAY_WARMUP_FRAMES;
+    for (u32 i = 0; i < warmup_frames; i += 1) {
+        draw_frame(&app);
+    }
+    vkDeviceWaitIdle(app.vk_device);
+    replay->current_frame = 0;
+
+    u32 total_frames = loops * replay->frame_count;
+    ReplayTimes times = {
+        .cpu_ms = (f64*)malloc(total_frames * sizeof(f64)),
+        .gpu_ms = (f64*)malloc(total_frames * sizeof(f64)),
+        .frame_cpu_ms = (f64*)calloc(replay->frame_count, sizeof(f64)),
+        .frame_gpu_ms = (f64*)calloc(replay->frame_count, sizeof(f64)),
+        .frame_gpu_samples = (u32*)calloc(replay->frame_count, sizeof(u32)),
+    };
+    i64 slot_frames[MAX_FRAMES_IN_FLIGHT]; // what each frame slot had submitted, -1 for the warmup
+    for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; i += 1) {
+        slot_frames[i] = -1;
+    }
+
+    f64 start_ms = now_ms();
+    for (u32 i = 0; i < total_frames; i += 1) {
+        u32 slot = app.current_frame;
+        f64 frame_start = now_ms();
+        draw_frame(&app);
+        // the wait for the frame slot is the GPU's time, not the replay's
+        f64 cpu_ms = now_ms() - frame_start - app.frame_wait_ms;
+        times.cpu_ms[times.cpu_count++] = cpu_ms;
+        times.frame_cpu_ms[i % replay->frame_count] += cpu_ms;
+        add_gpu_time(&app, &times, slot_frames[slot]);
+        slot_frames[slot] = i;
+    }
+    vkDeviceWaitIdle(app.vk_device);
+    f64 total_ms = now_ms() - start_ms;
+
+    // the last frames in flight
+    for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; i += 1) {
+        u32 slot = (app.current_frame + i) % MAX_FRAMES_IN_FLIGHT;
+        read_frame_timestamps(&app, slot);
+        add_gpu_time(&app, &times, slot_frames[slot]);
+    }
+
+    printf("Replayed %u frames (%u loops of %u) in %.2f ms: %.2f fps\n", total_frames, loops, replay->frame_count,
+           total_ms, (f64)total_frames / (total_ms / 1000.0));
+    write_replay_results(out_filename, &app, capture_filename, loops, setup_ms, total_ms, &times);
+    printf("Results written to %s\n", out_filename);
+
+    free(times.cpu_ms);
+    free(times.gpu_ms);
+    free(times.frame_cpu_ms);
+    free(times.frame_gpu_ms);
+    free(times.frame_gpu_samples);
+    app.replay = NULL;
+    destroy_replay(&app, replay);
+    cleanup(&app);
+    return 0;
+}